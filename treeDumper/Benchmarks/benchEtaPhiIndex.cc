@@ -0,0 +1,256 @@
+/**
+ *\Function benchEtaPhiIndex:
+ *
+ * Time per event of the EtaPhiIndex queries of DMAnalysisTreeMaker against
+ * the nested Delta R loops they replaced, at the object multiplicities of
+ * the analysis, and whether the two give the same answers. The index is
+ * filled and built in every event, as in the module.
+ *
+ *  - electron cleaning: minimum Delta R of 1-3 electrons to 0-4 loose muons;
+ *  - jet-lepton overlap: 10-40 jet candidates to 1-3 tight electrons and
+ *    1-3 tight muons;
+ *  - subjet-fat jet matching: 2-8 subjets to the nearest of 1-4 fat jets
+ *    within 0.8;
+ *  - AK8-AK4 top: nearest of 5-20 AK4 jets with 0.8 < Delta R <= 2.5 of each
+ *    of 1-4 AK8 jets;
+ *  - within / allPairsWithin: the jet-lepton pairs within 0.4.
+ *
+ * The "loops" column gets the eta and phi already stored, as the subjet and
+ * the AK8-AK4 loops did. The "TLorentzVector" column computes them from the
+ * momentum for every pair, as the cleaning and overlap loops did with
+ * TLorentzVector::DeltaR and PtEtaPhiELorentzVector(v.Pt(), v.Eta(), ...).
+ * The last line repeats within with 80-160 jets, where the index is sorted
+ * in phi: with a few queries per event the sort does not pay back.
+ *
+ * Against loops on stored eta and phi the index is not faster at these
+ * multiplicities, the per query overhead is about that of the few Delta R
+ * it saves; the gain of the module is computing eta and phi once per object.
+ *
+ * Build: g++ -O2 -I../src benchEtaPhiIndex.cc -o benchEtaPhiIndex
+ * Run:   ./benchEtaPhiIndex [nEvents]
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<utility>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<algorithm>
+
+#include "EtaPhiIndex.h"
+
+static unsigned long long seed = 12345;
+double uniform(){ seed = seed * 6364136223846793005ULL + 1442695040888963407ULL; return ((seed >> 11) + 0.5) / 9007199254740992.; }
+int between(int lo, int hi){ return lo + int(uniform() * (hi - lo + 1)); }
+
+struct Object {
+  double eta, phi, px, py, pz;
+  //As TLorentzVector::Eta() and Phi(), from the momentum
+  double momentumEta() const { double pt = sqrt(px * px + py * py); return asinh(pz / pt); }
+  double momentumPhi() const { return atan2(py, px); }
+};
+
+std::vector<Object> objects(int n, double etaMax){
+  std::vector<Object> v(n);
+  for(int i = 0; i < n; ++i){
+    Object & o = v[i];
+    double pt = 20. + 100. * uniform();
+    o.eta = etaMax * (2. * uniform() - 1.);
+    o.phi = M_PI * (2. * uniform() - 1.);
+    o.px = pt * cos(o.phi);
+    o.py = pt * sin(o.phi);
+    o.pz = pt * sinh(o.eta);
+  }
+  return v;
+}
+
+//Objects near others, so that the matchings find something
+std::vector<Object> near(const std::vector<Object> & seeds, int n, double spread){
+  std::vector<Object> v = objects(n, 2.4);
+  for(int i = 0; i < n && !seeds.empty(); ++i){
+    const Object & s = seeds[i % seeds.size()];
+    v[i].eta = s.eta + spread * (2. * uniform() - 1.);
+    v[i].phi = EtaPhiIndex::deltaPhi(s.phi + spread * (2. * uniform() - 1.), 0.);
+    double pt = sqrt(v[i].px * v[i].px + v[i].py * v[i].py);
+    v[i].px = pt * cos(v[i].phi);
+    v[i].py = pt * sin(v[i].phi);
+    v[i].pz = pt * sinh(v[i].eta);
+  }
+  return v;
+}
+
+struct Event { std::vector<Object> electrons, looseMuons, muons, jets, fatJets, subjets, ak4; };
+
+Event event(int jetsLo, int jetsHi){
+  Event ev;
+  ev.electrons = objects(between(1, 3), 2.5);
+  ev.looseMuons = objects(between(0, 4), 2.4);
+  ev.muons = objects(between(1, 3), 2.4);
+  std::vector<Object> leptons(ev.electrons);
+  leptons.insert(leptons.end(), ev.muons.begin(), ev.muons.end());
+  int nJets = between(jetsLo, jetsHi), nNear = std::min(nJets, 2);
+  ev.jets = near(leptons, nNear, 0.3);
+  std::vector<Object> others = objects(nJets - nNear, 4.7);
+  ev.jets.insert(ev.jets.end(), others.begin(), others.end());
+  ev.fatJets = objects(between(1, 4), 2.4);
+  ev.subjets = near(ev.fatJets, between(2, 8), 0.6);
+  ev.ak4 = near(ev.fatJets, between(5, 20), 2.);
+  return ev;
+}
+
+inline double loopDR2(const Object & a, const Object & b){ return EtaPhiIndex::deltaR2(a.eta, a.phi, b.eta, b.phi); }
+inline double momentumDR(const Object & a, const Object & b){ return sqrt(EtaPhiIndex::deltaR2(a.momentumEta(), a.momentumPhi(), b.momentumEta(), b.momentumPhi())); }
+
+void fill(EtaPhiIndex & index, const std::vector<Object> & v){
+  index.clear();
+  for(size_t i = 0; i < v.size(); ++i) index.add(v[i].eta, v[i].phi);
+  index.build();
+}
+
+//The queries of the module, by the index (mode 0), by the loops on eta and phi (1) or on the momentum (2).
+//The indices and result vectors are reused across events, as the members of the module
+double cleaning(const Event & ev, int mode){
+  double sum = 0.;
+  static EtaPhiIndex index;
+  if(mode == 0) fill(index, ev.looseMuons);
+  for(size_t e = 0; e < ev.electrons.size(); ++e){
+    const Object & ele = ev.electrons[e];
+    double minDR = 999.;
+    if(mode == 0) minDR = ev.looseMuons.size() ? sqrt(index.minDR2(ele.eta, ele.phi)) : 999.;
+    else for(size_t m = 0; m < ev.looseMuons.size(); ++m) minDR = std::min(minDR, mode == 1 ? sqrt(loopDR2(ele, ev.looseMuons[m])) : momentumDR(ele, ev.looseMuons[m]));
+    sum += minDR;
+  }
+  return sum;
+}
+
+double overlap(const Event & ev, int mode){
+  double sum = 0.;
+  static EtaPhiIndex electronIndex, muonIndex;
+  if(mode == 0){ fill(electronIndex, ev.electrons); fill(muonIndex, ev.muons); }
+  for(size_t j = 0; j < ev.jets.size(); ++j){
+    const Object & jet = ev.jets[j];
+    double minDR = 9999.;
+    if(mode == 0) minDR = std::min(sqrt(electronIndex.minDR2(jet.eta, jet.phi, 9999. * 9999.)), sqrt(muonIndex.minDR2(jet.eta, jet.phi, 9999. * 9999.)));
+    else{
+      for(size_t e = 0; e < ev.electrons.size(); ++e) minDR = std::min(minDR, mode == 1 ? sqrt(loopDR2(jet, ev.electrons[e])) : momentumDR(jet, ev.electrons[e]));
+      for(size_t m = 0; m < ev.muons.size(); ++m) minDR = std::min(minDR, mode == 1 ? sqrt(loopDR2(jet, ev.muons[m])) : momentumDR(jet, ev.muons[m]));
+    }
+    sum += minDR;
+  }
+  return sum;
+}
+
+double subjets(const Event & ev, int mode){
+  double sum = 0.;
+  static EtaPhiIndex index;
+  if(mode == 0) fill(index, ev.fatJets);
+  for(size_t s = 0; s < ev.subjets.size(); ++s){
+    int nearest = -1;
+    if(mode == 0) nearest = index.nearest(ev.subjets[s].eta, ev.subjets[s].phi, 0.8);
+    else{
+      double minDR2 = 0.8 * 0.8;
+      for(size_t t = 0; t < ev.fatJets.size(); ++t){
+	double dR2 = mode == 1 ? loopDR2(ev.subjets[s], ev.fatJets[t]) : pow(momentumDR(ev.subjets[s], ev.fatJets[t]), 2);
+	if(dR2 < minDR2){ minDR2 = dR2; nearest = t; }
+      }
+    }
+    sum += nearest;
+  }
+  return sum;
+}
+
+double tops(const Event & ev, int mode){
+  double sum = 0.;
+  static EtaPhiIndex index;
+  if(mode == 0) fill(index, ev.ak4);
+  for(size_t f = 0; f < ev.fatJets.size(); ++f){
+    const Object & ak8 = ev.fatJets[f];
+    int best = -1;
+    if(mode == 0) best = index.nearest(ak8.eta, ak8.phi, 2.5, 0.8);
+    else{
+      double dRmin = 2.6;
+      for(size_t i = 0; i < ev.ak4.size(); ++i){
+	double dR = mode == 1 ? sqrt(loopDR2(ak8, ev.ak4[i])) : momentumDR(ak8, ev.ak4[i]);
+	if(dR <= 0.8 || dR > 2.5) continue;
+	if(dR < dRmin){ dRmin = dR; best = i; }
+      }
+    }
+    sum += best;
+  }
+  return sum;
+}
+
+//Jet-lepton pairs within 0.4: the index of the jet times 64 plus that of the lepton, summed
+double pairs(const Event & ev, int mode){
+  double sum = 0.;
+  static std::vector< std::pair<int,int> > found;
+  found.clear();
+  if(mode == 0){
+    static EtaPhiIndex jetIndex, electronIndex;
+    fill(jetIndex, ev.jets);
+    fill(electronIndex, ev.electrons);
+    jetIndex.allPairsWithin(electronIndex, 0.4, found);
+  }
+  else{
+    for(size_t j = 0; j < ev.jets.size(); ++j)
+      for(size_t e = 0; e < ev.electrons.size(); ++e){
+	double dR = mode == 1 ? sqrt(loopDR2(ev.jets[j], ev.electrons[e])) : momentumDR(ev.jets[j], ev.electrons[e]);
+	if(dR <= 0.4) found.push_back(std::make_pair(int(j), int(e)));
+      }
+  }
+  for(size_t k = 0; k < found.size(); ++k) sum += 64 * found[k].first + found[k].second;
+  return sum;
+}
+
+double withinMuons(const Event & ev, int mode){
+  double sum = 0.;
+  static std::vector<int> found;
+  static EtaPhiIndex index;
+  if(mode == 0) fill(index, ev.jets);
+  for(size_t m = 0; m < ev.muons.size(); ++m){
+    if(mode == 0) index.within(ev.muons[m].eta, ev.muons[m].phi, 0.4, found);
+    else{
+      found.clear();
+      for(size_t j = 0; j < ev.jets.size(); ++j){
+	double dR = mode == 1 ? sqrt(loopDR2(ev.muons[m], ev.jets[j])) : momentumDR(ev.muons[m], ev.jets[j]);
+	if(dR <= 0.4) found.push_back(j);
+      }
+    }
+    for(size_t k = 0; k < found.size(); ++k) sum += found[k] + 1;
+  }
+  return sum;
+}
+
+typedef double (*Query)(const Event &, int);
+
+int main(int argc, char ** argv){
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  const char * names[7] = { "electron cleaning", "jet-lepton overlap", "subjet-fat jet", "AK8-AK4 top", "allPairsWithin", "within", "within, 80-160 jets" };
+  Query queries[7] = { cleaning, overlap, subjets, tops, pairs, withinMuons, withinMuons };
+  std::vector<Event> events(n), crowded(n / 10);
+  for(int i = 0; i < n; ++i) events[i] = event(10, 40);
+  for(size_t i = 0; i < crowded.size(); ++i) crowded[i] = event(80, 160);
+  bool failed = false;
+
+  printf("%-22s %12s %12s %16s %10s\n", "ns/event", "index", "loops", "TLorentzVector", "same");
+  for(int q = 0; q < 7; ++q){
+    const std::vector<Event> & sample = q == 6 ? crowded : events;
+    double ns[3], sums[3];
+    for(int mode = 0; mode < 3; ++mode){
+      sums[mode] = 0.;
+      auto t0 = std::chrono::steady_clock::now();
+      for(size_t i = 0; i < sample.size(); ++i) sums[mode] += queries[q](sample[i], mode);
+      ns[mode] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / sample.size();
+    }
+    //the Delta R from the momentum differs in the last bits
+    bool same = fabs(sums[0] - sums[1]) <= 1.e-9 * fabs(sums[1]) && fabs(sums[0] - sums[2]) <= 1.e-6 * fabs(sums[2]);
+    failed |= !same;
+    printf("%-22s %12.1f %12.1f %16.1f %10s\n", names[q], ns[0], ns[1], ns[2], same ? "yes" : "NO");
+  }
+  return failed ? 1 : 0;
+}
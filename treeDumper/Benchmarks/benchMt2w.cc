@@ -0,0 +1,169 @@
+/**
+ *\Function benchMt2w:
+ *
+ * Speed and accuracy of mt2w_bisect against the solver as it was before the
+ * analytic lower bound, the regula falsi refinement, the hoisted teco
+ * coefficients and the ellipse separation test (mt2wReference.h).
+ *
+ * Three samples of semileptonic ttbar toy events (tops with a pt spectrum,
+ * isotropic decays, 12% b jet and 15 GeV MET resolution, every second event
+ * with extra MET from a DM pair): the right b pairing, the swapped pairing
+ * and uncorrelated objects. Most swapped and random events have no
+ * compatible top mass below the upper bound (error value 7999) and dominate
+ * the time of the scan.
+ *
+ * For each sample: time per call of both solvers, the speedup, the largest
+ * deviation between them, the events off by more than the precision of the
+ * reference, and the events where only one of them returns the error value.
+ * The optional relative step is passed to set_scan_relative_step.
+ *
+ * In the default mode the results are identical up to the precision except
+ * for a few events per 10^4, where the Sturm count of the reference finds a
+ * real root of the quartic whose intersection point is not real (sampling
+ * ellipse 1 gives no point inside the 2nd ellipse) and the separation test
+ * of teco correctly rejects that top mass: a higher mt2w, or the error value.
+ *
+ * Build: g++ -O2 -I../src benchMt2w.cc ../src/mt2w_bisect.cc -o benchMt2w
+ * Run:   ./benchMt2w [nEvents] [scanRelativeStep]
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+
+#include "mt2w_bisect.h"
+#include "mt2wReference.h"
+
+struct P4 { double e, x, y, z; };
+
+static unsigned long long seed = 12345;
+double uniform(){ seed = seed * 6364136223846793005ULL + 1442695040888963407ULL; return ((seed >> 11) + 0.5) / 9007199254740992.; }
+double gaus(){ return sqrt(-2. * log(uniform())) * cos(2. * M_PI * uniform()); }
+
+P4 boost(const P4 & p, const P4 & frame){
+  double bx = frame.x / frame.e, by = frame.y / frame.e, bz = frame.z / frame.e;
+  double b2 = bx * bx + by * by + bz * bz;
+  if(b2 < 1.e-12) return p;
+  double g = 1. / sqrt(1. - b2), bp = bx * p.x + by * p.y + bz * p.z, g2 = (g - 1.) / b2;
+  P4 r = { g * (p.e + bp), p.x + (g2 * bp + g * p.e) * bx, p.y + (g2 * bp + g * p.e) * by, p.z + (g2 * bp + g * p.e) * bz };
+  return r;
+}
+
+//Isotropic two body decay of a particle of mass m
+void decay(const P4 & mother, double m, double m1, double m2, P4 & d1, P4 & d2){
+  double p = sqrt((m * m - (m1 + m2) * (m1 + m2)) * (m * m - (m1 - m2) * (m1 - m2))) / (2. * m);
+  double ct = 2. * uniform() - 1., st = sqrt(1. - ct * ct), phi = 2. * M_PI * uniform();
+  P4 a = { sqrt(p * p + m1 * m1), p * st * cos(phi), p * st * sin(phi), p * ct };
+  P4 b = { sqrt(p * p + m2 * m2), -a.x, -a.y, -a.z };
+  d1 = boost(a, mother);
+  d2 = boost(b, mother);
+}
+
+P4 smear(const P4 & p, double resolution){
+  double f = 1. + resolution * gaus();
+  P4 r = { p.e * f, p.x * f, p.y * f, p.z * f };
+  return r;
+}
+
+//{E, px, py, pz} of the lepton, the two b jets, and {0, MET x, MET y}
+struct Event { double l[4], b1[4], b2[4], met[3]; };
+
+void fill(double * v, const P4 & p){ v[0] = p.e; v[1] = p.x; v[2] = p.y; v[3] = p.z; }
+
+Event ttbar(bool dm, bool swapped){
+  double mtop = 172.5 + 1.4 * gaus(), mw1 = 80.4 + 2. * gaus(), mw2 = 80.4 + 2. * gaus();
+  double mtt = 2. * mtop + 100. * sqrt(-log(uniform()));
+  double pt = 30. * sqrt(-log(uniform())), phi = 2. * M_PI * uniform(), y = gaus();
+  P4 tt = { 0., pt * cos(phi), pt * sin(phi), mtt * sinh(y) };
+  tt.e = sqrt(mtt * mtt + tt.x * tt.x + tt.y * tt.y + tt.z * tt.z);
+  P4 t1, t2, w1, w2, b1, b2, l, nu;
+  decay(tt, mtt, mtop, mtop, t1, t2);
+  decay(t1, mtop, mw1, 4.8, w1, b1);
+  decay(t2, mtop, mw2, 4.8, w2, b2);
+  decay(w1, mw1, 0.1057, 0., l, nu);
+  P4 jet1 = smear(b1, 0.12), jet2 = smear(b2, 0.12);
+  double mx = nu.x - (jet1.x - b1.x) - (jet2.x - b2.x) + 15. * gaus();
+  double my = nu.y - (jet1.y - b1.y) - (jet2.y - b2.y) + 15. * gaus();
+  if(dm){
+    double ptchi = 200. * sqrt(-log(uniform())), phichi = 2. * M_PI * uniform();
+    mx += ptchi * cos(phichi);
+    my += ptchi * sin(phichi);
+  }
+  Event ev;
+  fill(ev.l, l);
+  fill(swapped ? ev.b2 : ev.b1, jet1);
+  fill(swapped ? ev.b1 : ev.b2, jet2);
+  ev.met[0] = 0.; ev.met[1] = mx; ev.met[2] = my;
+  return ev;
+}
+
+Event uncorrelated(){
+  Event ev;
+  double * objects[3] = { ev.l, ev.b1, ev.b2 };
+  for(int k = 0; k < 3; ++k){
+    double pt = 20. + 200. * uniform(), eta = 4. * uniform() - 2., phi = 2. * M_PI * uniform(), m = k ? 4.8 : 0.1057;
+    P4 p = { 0., pt * cos(phi), pt * sin(phi), pt * sinh(eta) };
+    p.e = sqrt(p.x * p.x + p.y * p.y + p.z * p.z + m * m);
+    fill(objects[k], p);
+  }
+  double met = 30. + 300. * uniform(), phi = 2. * M_PI * uniform();
+  ev.met[0] = 0.; ev.met[1] = met * cos(phi); ev.met[2] = met * sin(phi);
+  return ev;
+}
+
+template<class Solver> double solve(Solver & solver, Event & ev){
+  solver.set_momenta(ev.l, ev.b1, ev.b2, ev.met);
+  return solver.get_mt2w();
+}
+
+int main(int argc, char ** argv){
+  int n = argc > 1 ? atoi(argv[1]) : 20000;
+  double relativeStep = argc > 2 ? atof(argv[2]) : 0.;
+  const char * names[3] = { "ttbar", "swapped b", "random" };
+  const double errorValue = 7999.;
+
+  printf("%-10s %12s %12s %8s %12s %8s %14s\n", "sample", "ref us/call", "new us/call", "speedup", "max |diff|", "> prec", "7999 ref/new");
+  for(int sample = 0; sample < 3; ++sample){
+    std::vector<Event> events(n);
+    for(int i = 0; i < n; ++i) events[i] = sample == 2 ? uncorrelated() : ttbar(i % 2, sample == 1);
+
+    std::vector<double> reference(n), result(n), precision(n);
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i = 0; i < n; ++i){
+      mt2w_reference::mt2w solver;
+      reference[i] = solve(solver, events[i]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(int i = 0; i < n; ++i){
+      mt2w_bisect::mt2w solver;
+      if(relativeStep > 0) solver.set_scan_relative_step(relativeStep);
+      result[i] = solve(solver, events[i]);
+      precision[i] = solver.get_precision();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double maxDiff = 0.;
+    int beyond = 0, onlyReference = 0, onlyNew = 0;
+    for(int i = 0; i < n; ++i){
+      bool errReference = reference[i] == errorValue, errNew = result[i] == errorValue;
+      if(errReference != errNew){
+	if(errReference) ++onlyReference;
+	else ++onlyNew;
+	continue;
+      }
+      double diff = fabs(result[i] - reference[i]);
+      if(diff > maxDiff) maxDiff = diff;
+      if(diff > precision[i]) ++beyond;
+    }
+    double usReference = std::chrono::duration<double, std::micro>(t1 - t0).count() / n;
+    double usNew = std::chrono::duration<double, std::micro>(t2 - t1).count() / n;
+    printf("%-10s %12.2f %12.2f %8.2f %12.3g %8d %8d/%d\n", names[sample], usReference, usNew, usReference / usNew, maxDiff, beyond, onlyReference, onlyNew);
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ *\Function benchPolynomialRoots:
+ *
+ * Accuracy and speed of PolynomialRoots.h against the code it replaced
+ * (polynomialReference.h): EquationSolve with complex Cardano for the cubics
+ * of the neutrino reconstruction, and the Sturm count of the MT2 teco
+ * functions for quartics.
+ *
+ * The polynomials are built from known roots at scales from 10^-2 to 10^3:
+ * cubics with three real roots or one real root and a complex pair, quartics
+ * with 0, 2 or 4 real roots, all roots at least 10^-3 of the scale apart.
+ * Checked against the known roots:
+ *  - cubicRoots and EquationSolve: wrong number of roots, largest error
+ *    relative to the scale;
+ *  - quarticRoots: the same;
+ *  - quarticRealRootCount and the reference Sturm count: wrong counts, and
+ *    whether the two agree;
+ *  - sturmRootCount: roots in random intervals whose ends are away from the
+ *    roots.
+ * Then the time per call of each. Exits with 1 if a check of the new code
+ * fails: a wrong count, or an error above 10^-9 of the scale.
+ *
+ * Build: g++ -O2 -I../src benchPolynomialRoots.cc -o benchPolynomialRoots
+ * Run:   ./benchPolynomialRoots [nPolynomials]
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<chrono>
+#include<algorithm>
+
+#include "PolynomialRoots.h"
+#include "polynomialReference.h"
+
+static unsigned long long seed = 12345;
+double uniform(){ seed = seed * 6364136223846793005ULL + 1442695040888963407ULL; return ((seed >> 11) + 0.5) / 9007199254740992.; }
+
+//Polynomial with known roots: the real ones in ascending order, coeffs highest power first
+struct Polynomial { int degree, nReal; double coeffs[5], roots[4], scale; };
+
+//Real roots uniform in [-scale, scale], complex pairs with an imaginary part of at least 10^-2 of the scale
+Polynomial make(int degree, int nReal){
+  Polynomial p;
+  p.degree = degree;
+  p.nReal = nReal;
+  p.scale = pow(10., 5. * uniform() - 2.);
+  bool separated = false;
+  while(!separated){
+    for(int i = 0; i < nReal; ++i) p.roots[i] = p.scale * (2. * uniform() - 1.);
+    std::sort(p.roots, p.roots + nReal);
+    separated = true;
+    for(int i = 1; i < nReal; ++i) if(p.roots[i] - p.roots[i - 1] < 1.e-3 * p.scale) separated = false;
+  }
+  //multiply a (x^2 + ...) out, factor by factor
+  double c[5] = { 2. * uniform() + 0.5, 0., 0., 0., 0. };
+  int n = 0;
+  for(int i = 0; i < nReal; ++i, ++n){
+    for(int j = n + 1; j > 0; --j) c[j] -= p.roots[i] * c[j - 1];
+  }
+  for(int i = nReal; i < degree; i += 2, n += 2){
+    double re = p.scale * (2. * uniform() - 1.), im = p.scale * (0.01 + uniform());
+    double b = -2. * re, q = re * re + im * im;
+    for(int j = n + 2; j > 0; --j) c[j] += b * c[j - 1] + (j > 1 ? q * c[j - 2] : 0.);
+  }
+  for(int i = 0; i <= degree; ++i) p.coeffs[i] = c[i];
+  return p;
+}
+
+//Wrong counts and the largest error relative to the scale of a set of found roots
+struct Accuracy {
+  int wrong;
+  double maxError;
+  Accuracy() : wrong(0), maxError(0.) {}
+  void add(const Polynomial & p, const double * found, int n){
+    if(n != p.nReal){ ++wrong; return; }
+    std::vector<double> sorted(found, found + n);
+    std::sort(sorted.begin(), sorted.end());
+    for(int i = 0; i < n; ++i) maxError = std::max(maxError, fabs(sorted[i] - p.roots[i]) / p.scale);
+  }
+};
+
+template<class F> double nsPerCall(F f, int n){
+  auto t0 = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+
+int main(int argc, char ** argv){
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  bool failed = false;
+
+  std::vector<Polynomial> cubics(n), quartics(n);
+  for(int i = 0; i < n; ++i){
+    cubics[i] = make(3, i % 2 ? 3 : 1);
+    quartics[i] = make(4, 2 * (i % 3));
+  }
+
+  //cubics
+  Accuracy cubicNew, cubicReference;
+  for(int i = 0; i < n; ++i){
+    const double * c = cubics[i].coeffs;
+    double roots[3];
+    cubicNew.add(cubics[i], roots, polyroots::cubicRoots(c[0], c[1], c[2], c[3], roots));
+    std::vector<double> reference = polyreference::EquationSolve(c[0], c[1], c[2], c[3]);
+    cubicReference.add(cubics[i], reference.data(), reference.size());
+  }
+  printf("%-28s %10s %12s\n", "", "wrong n", "max error");
+  printf("%-28s %10d %12.3g\n", "cubicRoots", cubicNew.wrong, cubicNew.maxError);
+  printf("%-28s %10d %12.3g\n", "reference EquationSolve", cubicReference.wrong, cubicReference.maxError);
+  failed |= cubicNew.wrong > 0 || cubicNew.maxError > 1.e-9;
+
+  //quartics
+  Accuracy quartic;
+  int wrongCount = 0, wrongReference = 0, disagree = 0, wrongInterval = 0;
+  for(int i = 0; i < n; ++i){
+    const Polynomial & p = quartics[i];
+    const double * c = p.coeffs;
+    double roots[4];
+    quartic.add(p, roots, polyroots::quarticRoots(c[0], c[1], c[2], c[3], c[4], roots));
+    int count = polyroots::quarticRealRootCount<long double>(c[0], c[1], c[2], c[3], c[4]);
+    int reference = polyreference::sturmSolutions(c[0], c[1], c[2], c[3], c[4]);
+    wrongCount += count != p.nReal;
+    wrongReference += reference != p.nReal;
+    disagree += count != reference;
+    //interval with ends at least 10^-4 of the scale from the roots
+    double lo = 0., hi = 0.;
+    bool clear = false;
+    while(!clear){
+      lo = p.scale * (2.4 * uniform() - 1.2);
+      hi = lo + p.scale * 2.4 * uniform();
+      clear = true;
+      for(int k = 0; k < p.nReal; ++k) if(fabs(lo - p.roots[k]) < 1.e-4 * p.scale || fabs(hi - p.roots[k]) < 1.e-4 * p.scale) clear = false;
+    }
+    int inside = 0;
+    for(int k = 0; k < p.nReal; ++k) inside += p.roots[k] > lo && p.roots[k] <= hi;
+    wrongInterval += polyroots::sturmRootCount(c, 4, lo, hi) != inside;
+  }
+  printf("%-28s %10d %12.3g\n", "quarticRoots", quartic.wrong, quartic.maxError);
+  printf("%-28s %10d\n", "quarticRealRootCount", wrongCount);
+  printf("%-28s %10d\n", "reference Sturm count", wrongReference);
+  printf("%-28s %10d\n", "sturmRootCount in (lo, hi]", wrongInterval);
+  printf("quarticRealRootCount and the reference differ on %d of %d quartics\n\n", disagree, n);
+  failed |= quartic.wrong > 0 || quartic.maxError > 1.e-9 || wrongCount > 0 || wrongInterval > 0;
+
+  //speed
+  double sum = 0.;
+  double roots[4];
+  double nsCubic = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const double * c = cubics[i].coeffs; sum += polyroots::cubicRoots(c[0], c[1], c[2], c[3], roots); } }, n);
+  double nsCubicReference = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const double * c = cubics[i].coeffs; sum += polyreference::EquationSolve(c[0], c[1], c[2], c[3]).size(); } }, n);
+  double nsCount = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const double * c = quartics[i].coeffs; sum += polyroots::quarticRealRootCount<long double>(c[0], c[1], c[2], c[3], c[4]); } }, n);
+  double nsCountReference = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const double * c = quartics[i].coeffs; sum += polyreference::sturmSolutions(c[0], c[1], c[2], c[3], c[4]); } }, n);
+  double nsQuartic = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const double * c = quartics[i].coeffs; sum += polyroots::quarticRoots(c[0], c[1], c[2], c[3], c[4], roots); } }, n);
+  double nsInterval = nsPerCall([&](){
+      for(int i = 0; i < n; ++i){ const Polynomial & p = quartics[i]; sum += polyroots::sturmRootCount(p.coeffs, 4, -p.scale, p.scale); } }, n);
+  printf("%-28s %10s %12s\n", "", "ns/call", "reference");
+  printf("%-28s %10.1f %12.1f\n", "cubicRoots", nsCubic, nsCubicReference);
+  printf("%-28s %10.1f %12.1f\n", "quarticRealRootCount", nsCount, nsCountReference);
+  printf("%-28s %10.1f\n", "quarticRoots", nsQuartic);
+  printf("%-28s %10.1f\n", "sturmRootCount", nsInterval);
+  printf("(checksum %g)\n%s\n", sum, failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
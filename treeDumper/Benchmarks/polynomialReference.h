@@ -0,0 +1,145 @@
+#ifndef _Polynomial_Reference_h_
+#define _Polynomial_Reference_h_
+
+#include<cmath>
+#include<vector>
+#include<complex>
+
+/**
+ *\Function polynomialReference:
+ *
+ * The root finding of the tree before PolynomialRoots.h, in namespace
+ * polyreference: EquationSolve as it was in EquationSolver.h (complex
+ * Cardano) and the Sturm sequence count of the mt2w, mt2bl and MT2 teco
+ * functions (signchange_n - signchange_p). Reference for benchPolynomialRoots
+ * only.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+namespace polyreference {
+
+template <class T>
+std::vector< T > const EquationSolve(const T & a, const T & b,const T & c,const T & d){
+
+
+  std::vector<T> result;
+
+
+  std::complex<T> x1;
+  std::complex<T> x2;
+  std::complex<T> x3;
+
+  if (a != 0) {
+    
+    T q = (3*a*c-b*b)/(9*a*a);
+    T r = (9*a*b*c - 27*a*a*d - 2*b*b*b)/(54*a*a*a);
+    T Delta = q*q*q + r*r;
+
+    std::complex<T> s;
+    std::complex<T> t;
+
+    T rho=0;
+    T theta=0;
+    
+    if( Delta<=0){
+      rho = sqrt(-(q*q*q));
+
+      theta = acos(r/rho);
+
+      s = std::polar<T>(sqrt(-q),theta/3.0); 
+      t = std::polar<T>(sqrt(-q),-theta/3.0); 
+    }
+    
+    if(Delta>0){ 
+      s = std::complex<T>(cbrt(r+sqrt(Delta)),0);
+      t = std::complex<T>(cbrt(r-sqrt(Delta)),0);
+    }
+  
+    std::complex<T> i(0,1.0); 
+    
+    
+     x1 = s+t+std::complex<T>(-b/(3.0*a),0);
+     x2 = (s+t)*std::complex<T>(-0.5,0)-std::complex<T>(b/(3.0*a),0)+(s-t)*i*std::complex<T>(sqrt(3)/2.0,0);
+     x3 = (s+t)*std::complex<T>(-0.5,0)-std::complex<T>(b/(3.0*a),0)-(s-t)*i*std::complex<T>(sqrt(3)/2.0,0);
+
+    if(fabs(x1.imag())<0.0001)result.push_back(x1.real());
+    if(fabs(x2.imag())<0.0001)result.push_back(x2.real());
+    if(fabs(x3.imag())<0.0001)result.push_back(x3.real());
+
+    return result;
+  }
+  else{return result;}
+
+
+  return result;
+}
+
+inline int signchange_n( long double t1, long double t2, long double t3, long double t4, long double t5)
+{
+   int nsc;
+   nsc=0;
+   if(t1*t2>0) nsc++;
+   if(t2*t3>0) nsc++;
+   if(t3*t4>0) nsc++;
+   if(t4*t5>0) nsc++;
+   return nsc;
+}
+inline int signchange_p( long double t1, long double t2, long double t3, long double t4, long double t5)
+{
+   int nsc;
+   nsc=0;
+   if(t1*t2<0) nsc++;
+   if(t2*t3<0) nsc++;
+   if(t3*t4<0) nsc++;
+   if(t4*t5<0) nsc++;
+   return nsc;
+}
+
+//Number of real roots of A4 x^4 + A3 x^3 + A2 x^2 + A1 x + A0 from the leading coefficients of its Sturm sequence
+inline int sturmSolutions(long double A4, long double A3, long double A2, long double A1, long double A0)
+{
+   long double A3sq;
+   A3sq = A3*A3;
+   
+   long double B3, B2, B1, B0;
+   B3 = 4*A4;
+   B2 = 3*A3;
+   B1 = 2*A2;
+   B0 = A1;
+   
+   long double C2, C1, C0;
+   C2 = -(A2/2 - 3*A3sq/(16*A4));
+   C1 = -(3*A1/4. -A2*A3/(8*A4));
+   C0 = -A0 + A1*A3/(16*A4);
+   
+   long double D1, D0;
+   D1 = -B1 - (B3*C1*C1/C2 - B3*C0 -B2*C1)/C2;
+   D0 = -B0 - B3 *C0 *C1/(C2*C2)+ B2*C0/C2;
+   
+   long double E0;
+   E0 = -C0 - C2*D0*D0/(D1*D1) + C1*D0/D1;
+   
+   long  double t1,t2,t3,t4,t5;
+//find the coefficients for the leading term in the Sturm sequence  
+   t1 = A4;
+   t2 = A4;
+   t3 = C2;
+   t4 = D1;
+   t5 = E0;
+ 
+
+//The number of solutions depends on diffence of number of sign changes for x->Inf and x->-Inf
+   int nsol;
+   nsol = signchange_n(t1,t2,t3,t4,t5) - signchange_p(t1,t2,t3,t4,t5);
+
+//Cannot have negative number of solutions, must be roundoff effect
+   if (nsol < 0) nsol = 0;
+   return nsol;
+}
+
+}
+
+#endif
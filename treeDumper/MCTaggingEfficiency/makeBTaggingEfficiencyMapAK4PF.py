@@ -209,7 +209,11 @@ def produceEfficiencyMaps(dataset, inputPath, subdirectory, suffix):
 
   for partonFlavor in ['b', 'c', 'udsg']:
 
-    inputFile.cd(subdirectory)
+    # single-pass analyzer output: one directory per collection and working point
+    if inputFile.GetDirectory(subdirectory + '/' + dataset[2]):
+      inputFile.cd(subdirectory + '/' + dataset[2])
+    else:
+      inputFile.cd(subdirectory)
 
     denominatorHisto = 'h2_bTaggingEff_Denom_' + partonFlavor
     numeratorHisto = 'h2_bTaggingEff_Num_' + partonFlavor
@@ -0,0 +1,268 @@
+/**
+ *\Function makeBTaggingEfficiencyMaps:
+ *
+ * Cross section weighted b-tagging efficiency maps from the per-sample
+ * outputs of bTaggingEffAnalyzer (one directory per collection and working
+ * point, h1_nEvents for the processed events). Replaces the unweighted hadd
+ * of addMaps.sh followed by makeBTaggingEfficiencyMapAK4PF.py.
+ *
+ * Each sample gets the weight xsec/nEvents. The samples are read in
+ * parallel, the fine analyzer bins are folded in |eta| and summed into the
+ * configured bins, and the efficiency error is the binomial one for weighted
+ * events. For every map a ROOT file (efficiency_, numerator_, denominator_
+ * <flavour>, as the python script) and a binary table readable by
+ * BTagEfficiencyMap are written.
+ *
+ * Build: g++ -O2 -std=c++11 -pthread makeBTaggingEfficiencyMaps.cc -o makeBTaggingEfficiencyMaps `root-config --cflags --libs`
+ * Run:   ./makeBTaggingEfficiencyMaps bTaggingEfficiencyMaps.txt [nThreads]
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<sstream>
+#include<iostream>
+#include<cmath>
+#include<cstdlib>
+#include<stdint.h>
+#include<thread>
+#include<atomic>
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TH2D.h"
+
+enum Flavour { b = 0, c, udsg, nFlavours };
+const char * flavours[nFlavours] = {"b", "c", "udsg"};
+
+struct Sample {
+  std::string file;
+  double xsec;
+  double nEvents;// <= 0: read h1_nEvents
+};
+
+struct Binning {
+  std::vector<double> ptEdges, etaEdges;// |eta|
+  int nPt() const { return ptEdges.size() - 1; }
+  int nEta() const { return etaEdges.size() - 1; }
+};
+
+struct Map {
+  std::string tag;// analyzer directory <collection>_<working point>
+  std::string output;// output file name without extension
+};
+
+//Weighted sums per output bin: [(map*nFlavours+flavour)][bin*4+{sumW, sumW2, sumWPass, sumW2Pass}]
+typedef std::vector< std::vector<double> > Sums;
+
+struct Config {
+  std::string directory;
+  std::vector<Sample> samples;
+  Binning binning[nFlavours];
+  std::vector<Map> maps;
+};
+
+static void fail(const std::string & message){
+  std::cerr << "makeBTaggingEfficiencyMaps: " << message << std::endl;
+  exit(1);
+}
+
+//Configuration, one entry per line:
+//  directory <analyzer directory>
+//  sample <file> <cross section> [<events>]
+//  bins <flavour> <pt edges> | <|eta| edges>
+//  map <collection_workingpoint> <output file without extension>
+static Config readConfig(const std::string & fileName){
+  std::ifstream in(fileName.c_str());
+  if(!in) fail("cannot open " + fileName);
+  Config cfg;
+  std::string line;
+  while(std::getline(in, line)){
+    if(line.find('#') != std::string::npos) line = line.substr(0, line.find('#'));
+    std::istringstream ss(line);
+    std::string key;
+    if(!(ss >> key)) continue;
+    if(key == "directory") ss >> cfg.directory;
+    else if(key == "sample"){
+      Sample s;
+      s.nEvents = -1.;
+      if(!(ss >> s.file >> s.xsec)) fail("bad sample line: " + line);
+      ss >> s.nEvents;
+      cfg.samples.push_back(s);
+    }
+    else if(key == "bins"){
+      std::string fl, tok;
+      ss >> fl;
+      int f = fl == "b" ? b : (fl == "c" ? c : (fl == "udsg" ? udsg : -1));
+      if(f < 0) fail("unknown flavour in: " + line);
+      std::vector<double> * edges = &cfg.binning[f].ptEdges;
+      while(ss >> tok){
+        if(tok == "|"){ edges = &cfg.binning[f].etaEdges; continue; }
+        edges->push_back(atof(tok.c_str()));
+      }
+    }
+    else if(key == "map"){
+      Map m;
+      if(!(ss >> m.tag >> m.output)) fail("bad map line: " + line);
+      cfg.maps.push_back(m);
+    }
+    else fail("unknown key in: " + line);
+  }
+  for(int f = 0; f < nFlavours; ++f)
+    if(cfg.binning[f].nPt() < 1 || cfg.binning[f].nEta() < 1) fail(std::string("no bins for flavour ") + flavours[f]);
+  if(cfg.samples.empty() || cfg.maps.empty()) fail("no samples or no maps in " + fileName);
+  return cfg;
+}
+
+//Output bin of a value, -1 outside
+static int findBin(const std::vector<double> & edges, double x){
+  if(x < edges.front() || x >= edges.back()) return -1;
+  int i = 0;
+  for(size_t k = 1; k + 1 < edges.size(); ++k) i += (x >= edges[k]);
+  return i;
+}
+
+//Fine bins are assigned by their centre, as the bin-centre lookups of the python script
+static void accumulate(TH2 * denom, TH2 * num, const Binning & binning, double w, std::vector<double> & sums){
+  for(int i = 1; i <= denom->GetNbinsX(); ++i){
+    int ipt = findBin(binning.ptEdges, denom->GetXaxis()->GetBinCenter(i));
+    if(ipt < 0) continue;
+    for(int j = 1; j <= denom->GetNbinsY(); ++j){
+      int ieta = findBin(binning.etaEdges, fabs(denom->GetYaxis()->GetBinCenter(j)));
+      if(ieta < 0) continue;
+      double nAll = denom->GetBinContent(i, j), nPass = num->GetBinContent(i, j);
+      double * s = &sums[(ipt * binning.nEta() + ieta) * 4];
+      s[0] += w * nAll;
+      s[1] += w * w * nAll;
+      s[2] += w * nPass;
+      s[3] += w * w * nPass;
+    }
+  }
+}
+
+static void processSample(const Config & cfg, const Sample & sample, Sums & sums){
+  TFile * f = TFile::Open(sample.file.c_str());
+  if(!f || f->IsZombie()) fail("cannot open " + sample.file);
+  double nEvents = sample.nEvents;
+  if(nEvents <= 0.){
+    TH1 * h = dynamic_cast<TH1 *>(f->Get((cfg.directory + "/h1_nEvents").c_str()));
+    if(!h) fail("no h1_nEvents in " + sample.file + ", give the number of events in the sample line");
+    nEvents = h->GetBinContent(1);
+  }
+  if(nEvents <= 0.) fail("no events in " + sample.file);
+  double w = sample.xsec / nEvents;
+  for(size_t m = 0; m < cfg.maps.size(); ++m){
+    for(int fl = 0; fl < nFlavours; ++fl){
+      std::string dir = cfg.directory + "/" + cfg.maps[m].tag + "/";
+      TH2 * denom = dynamic_cast<TH2 *>(f->Get((dir + "h2_bTaggingEff_Denom_" + flavours[fl]).c_str()));
+      TH2 * num = dynamic_cast<TH2 *>(f->Get((dir + "h2_bTaggingEff_Num_" + flavours[fl]).c_str()));
+      if(!denom || !num) fail("no " + dir + "h2_bTaggingEff_*_" + flavours[fl] + " in " + sample.file);
+      accumulate(denom, num, cfg.binning[fl], w, sums[m * nFlavours + fl]);
+    }
+  }
+  f->Close();
+  delete f;
+}
+
+static void writeTable(std::ofstream & out, const std::vector<double> & v){
+  out.write(reinterpret_cast<const char *>(&v[0]), v.size() * sizeof(double));
+}
+
+//Binary table, native byte order: "BTEM", uint32 version, then per flavour (b, c, udsg)
+//uint32 nPt, uint32 nEta, pt edges, |eta| edges, efficiencies [ipt*nEta+ieta] as doubles
+static void writeMap(const Config & cfg, size_t m, const Sums & sums){
+  std::string rootName = cfg.maps[m].output + ".root", binName = cfg.maps[m].output + ".bin";
+  TFile * out = TFile::Open(rootName.c_str(), "RECREATE");
+  if(!out || out->IsZombie()) fail("cannot create " + rootName);
+  std::ofstream table(binName.c_str(), std::ios::binary);
+  if(!table) fail("cannot create " + binName);
+  const uint32_t version = 1;
+  table.write("BTEM", 4);
+  table.write(reinterpret_cast<const char *>(&version), sizeof(version));
+
+  for(int fl = 0; fl < nFlavours; ++fl){
+    const Binning & bins = cfg.binning[fl];
+    const std::vector<double> & s = sums[m * nFlavours + fl];
+    std::string name = flavours[fl];
+    TH2D * denominator = new TH2D(("denominator_" + name).c_str(), "", bins.nPt(), &bins.ptEdges[0], bins.nEta(), &bins.etaEdges[0]);
+    TH2D * numerator = new TH2D(("numerator_" + name).c_str(), "", bins.nPt(), &bins.ptEdges[0], bins.nEta(), &bins.etaEdges[0]);
+    TH2D * efficiency = new TH2D(("efficiency_" + name).c_str(), "", bins.nPt(), &bins.ptEdges[0], bins.nEta(), &bins.etaEdges[0]);
+    std::vector<double> values(bins.nPt() * bins.nEta(), 0.);
+    for(int i = 0; i < bins.nPt(); ++i){
+      for(int j = 0; j < bins.nEta(); ++j){
+        const double * v = &s[(i * bins.nEta() + j) * 4];
+        denominator->SetBinContent(i + 1, j + 1, v[0]);
+        denominator->SetBinError(i + 1, j + 1, sqrt(v[1]));
+        numerator->SetBinContent(i + 1, j + 1, v[2]);
+        numerator->SetBinError(i + 1, j + 1, sqrt(v[3]));
+        if(v[0] <= 0.) continue;
+        double eff = v[2] / v[0];
+        double var = ((1. - 2. * eff) * v[3] + eff * eff * v[1]) / (v[0] * v[0]);
+        efficiency->SetBinContent(i + 1, j + 1, eff);
+        efficiency->SetBinError(i + 1, j + 1, sqrt(var > 0. ? var : 0.));
+        values[i * bins.nEta() + j] = eff;
+        if(eff == 0. || eff == 1.) std::cout << "Warning! Bin(" << i + 1 << "," << j + 1 << ") for " << name << " jets of " << cfg.maps[m].tag << " has a b-tagging efficiency of " << eff << std::endl;
+      }
+    }
+    //overflow bins as the last bins
+    for(int i = 1; i <= bins.nPt(); ++i) efficiency->SetBinContent(i, bins.nEta() + 1, efficiency->GetBinContent(i, bins.nEta()));
+    for(int j = 1; j <= bins.nEta() + 1; ++j) efficiency->SetBinContent(bins.nPt() + 1, j, efficiency->GetBinContent(bins.nPt(), j));
+    out->cd();
+    denominator->Write();
+    numerator->Write();
+    efficiency->Write();
+    delete denominator;
+    delete numerator;
+    delete efficiency;
+
+    uint32_t nPt = bins.nPt(), nEta = bins.nEta();
+    table.write(reinterpret_cast<const char *>(&nPt), sizeof(nPt));
+    table.write(reinterpret_cast<const char *>(&nEta), sizeof(nEta));
+    writeTable(table, bins.ptEdges);
+    writeTable(table, bins.etaEdges);
+    writeTable(table, values);
+  }
+  out->Close();
+  delete out;
+  std::cout << "b-tagging efficiency map for " << cfg.maps[m].tag << " stored in " << rootName << " and " << binName << std::endl;
+}
+
+int main(int argc, char ** argv){
+  if(argc < 2) fail("usage: makeBTaggingEfficiencyMaps <config> [nThreads]");
+  Config cfg = readConfig(argv[1]);
+  unsigned nThreads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+  if(nThreads < 1) nThreads = 1;
+  if(nThreads > cfg.samples.size()) nThreads = cfg.samples.size();
+
+  TH1::AddDirectory(false);
+  ROOT::EnableThreadSafety();
+
+  //one set of sums per sample, added in the configuration order so that the result does not depend on the scheduling
+  std::vector<Sums> perSample(cfg.samples.size());
+  for(size_t s = 0; s < cfg.samples.size(); ++s){
+    perSample[s].resize(cfg.maps.size() * nFlavours);
+    for(size_t m = 0; m < cfg.maps.size(); ++m)
+      for(int fl = 0; fl < nFlavours; ++fl) perSample[s][m * nFlavours + fl].assign(cfg.binning[fl].nPt() * cfg.binning[fl].nEta() * 4, 0.);
+  }
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for(unsigned t = 0; t < nThreads; ++t){
+    workers.push_back(std::thread([&](){
+      for(size_t s = next++; s < cfg.samples.size(); s = next++) processSample(cfg, cfg.samples[s], perSample[s]);
+    }));
+  }
+  for(size_t t = 0; t < workers.size(); ++t) workers[t].join();
+
+  Sums total = perSample[0];
+  for(size_t s = 1; s < perSample.size(); ++s)
+    for(size_t k = 0; k < total.size(); ++k)
+      for(size_t i = 0; i < total[k].size(); ++i) total[k][i] += perSample[s][k][i];
+
+  for(size_t m = 0; m < cfg.maps.size(); ++m) writeMap(cfg, m, total);
+  return 0;
+}
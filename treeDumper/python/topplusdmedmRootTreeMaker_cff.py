@@ -65,6 +65,15 @@ DMTreesDumper = cms.EDAnalyzer(
     eventLabel = eventlabel,
     #resolutionsFile = cms.string('Spring16_25nsV10_MC_PtResolution_AK8PFchs.txt'),
     #scaleFactorsFile = cms.string('Spring16_25nsV10_MC_SF_AK8PFchs.txt'),
+    #Jet pt resolutions of the hybrid JER smearing. No AK4 file is shipped: by default AK4 jets without a
+    #generator match are not smeared (matched ones still are); set e.g. 'Spring16_25nsV10_MC_PtResolution_AK4PFchs.txt'
+    resolutionsFileAK4 = cms.untracked.string(''),
+    #'' for AK8 likewise leaves unmatched AK8 jets and the AK8 jet mass unsmeared
+    resolutionsFileAK8 = cms.untracked.string('Spring16_25nsV10_MC_PtResolution_AK8PFchs.txt'),
+    #Jet energy correction algorithm of the jetsLabel and boostedTopsLabel collections, e.g. 'AK8PFPuppi' for PUPPI
+    #fat jets. One algorithm per collection and job: CHS and PUPPI of the same jet size need two jobs
+    jecAlgoAK4 = cms.untracked.string('AK4PFchs'),
+    jecAlgoAK8 = cms.untracked.string('AK8PFchs'),
     physicsObjects = cms.VPSet(
         cms.PSet(
             label = metlabel,
@@ -126,8 +135,45 @@ DMTreesDumper = cms.EDAnalyzer(
     #resolved top part:
     doResolvedTopHad=cms.untracked.bool(False),
     doResolvedTopSemiLep=cms.untracked.bool(False),
+    #W and top mass windows {min, max} in GeV pruning the hadronic triplets, empty: no pruning
+    resolvedTopHadWMassWindow=cms.untracked.vdouble(),
+    resolvedTopHadTopMassWindow=cms.untracked.vdouble(),
+    #best candidates saved per event (0: all, arrays sized Binomial(maxLeadingJetsForTop,4)), ranked by "massChi2" or "jetOrder"
+    resolvedTopHadMaxCandidates=cms.untracked.int32(10),
+    resolvedTopHadRanking=cms.untracked.string("massChi2"),
+    #{mW, sigmaW, mTop, sigmaTop} in GeV for the massChi2 ranking
+    resolvedTopHadMassHypotheses=cms.untracked.vdouble(80.4, 10., 172.5, 15.),
+    #TMVA BDT weights (xml) scoring the triplets into resolvedTopHad_MVA, needed by the "mva" ranking; its variables are
+    #named as the resolvedTopHad branches (Pt, Mass, WMass, massDrop, DRJet1b, ...) or BPt, J1Pt, J2Pt, BCSV, J1CSV, J2CSV
+    resolvedTopHadMVAWeights=cms.untracked.string(""),
+    #events on which the BDT is compared with TMVA::Reader
+    resolvedTopHadMVACheckEvents=cms.untracked.int32(0),
+    #W and top mass fit of the saved candidates into the *PostFit, FitChi2 and FitProb branches, needs resolutionsFileAK4
+    resolvedTopHadKinFit=cms.untracked.bool(False),
+    resolvedTopHadKinFitIterations=cms.untracked.int32(5),
+    #{mW, widthW, mTop, widthTop} in GeV
+    resolvedTopHadKinFitMasses=cms.untracked.vdouble(80.4, 2.1, 172.5, 1.5),
     #cuts for the jet scan
     jetScanCuts=cms.vdouble(30), #Note: the order is important, as the jet collection with the first cut is used for the definition of mt2w.
+    #absolute precision of Event_Mt2w in GeV, 0: the 0.001 GeV default of mt2w_bisect
+    mt2wPrecision=cms.untracked.double(0.),
+    #opt-in: the mt2w scan goes up in steps of max(0.5 GeV, mt2wScanRelativeStep*mtop). Faster, but a compatible
+    #window narrower than the step can be missed and give the 7999 error value; 0 keeps the fixed step
+    mt2wScanRelativeStep=cms.untracked.double(0.),
+    #b-tag categories over the CSVL/M/T working points, each one adds Event_bWeight<name> and its variations. Example, 1 CSVM and no extra CSVL:
+    #cms.PSet(name = cms.untracked.string("1CSVM0xCSVL"), minMedium = cms.untracked.int32(1), maxMedium = cms.untracked.int32(1), maxLoose = cms.untracked.int32(1))
+    bTagCategories = cms.untracked.VPSet(),
+    #MC b-tagging efficiency maps (CSVL, CSVM, CSVT), read at startup: an empty name skips that working point.
+    #makeBTaggingEfficiencyMaps writes these names; its .bin table next to a .root file is read in its place
+    bTagEfficiencyMapsAK4 = cms.untracked.vstring("Maps/bTaggingEfficiency_AK4CHS_CSVv2l_AK4CHS_CSVL_bTaggingEfficiencyMap.root",
+                                                  "Maps/bTaggingEfficiency_AK4CHS_CSVv2m_AK4CHS_CSVM_bTaggingEfficiencyMap.root",
+                                                  "Maps/bTaggingEfficiency_AK4CHS_CSVv2t_AK4CHS_CSVT_bTaggingEfficiencyMap.root"),
+    bTagEfficiencyMapsSubj = cms.untracked.vstring("Maps/bTaggingEfficiency_AK8SoftDropSubj_CSVv2l_AK8Subj_CSVL_bTaggingEfficiencyMap.root",
+                                                   "Maps/bTaggingEfficiency_AK8SoftDropSubj_CSVv2m_AK8Subj_CSVM_bTaggingEfficiencyMap.root",
+                                                   ""),
+    #b-tagging scale factors in the BTagCalibration csv format
+    bTagSFFileAK4 = cms.untracked.string("CSVv2_AK4_bTagSF.csv"),
+    bTagSFFileSubj = cms.untracked.string("CSVv2_AK8Subjets_bTagSF.csv"),
     
     #Systematics trees to produce. Include:  
     systematics = cms.vstring(systsToSave), 
@@ -0,0 +1,215 @@
+#ifndef _BDT_Forest_h_
+#define _BDT_Forest_h_
+
+/**
+ *\Function BDTForest:
+ *
+ * Boosted decision trees read from the weights xml of a TMVA BDT and stored
+ * as one flat array of nodes, for scoring many inputs per event (resolved top
+ * triplets, boosted tops, taggers) without a TMVA::Reader per candidate.
+ * evaluate() takes all the inputs of the event in one call and loops over the
+ * trees in the outer loop, so each tree is read once per batch. The output is
+ * the one of TMVA::Reader::EvaluateMVA: boost-weighted average of the leaf
+ * purity (or of +-1 with UseYesNoLeaf) for AdaBoost, 2/(1+exp(-2 sum))-1 of
+ * the leaf responses for Grad. Cuts are compared in single precision as TMVA
+ * does. Input transformations and Fisher cuts are not supported.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<string>
+#include<vector>
+#include<map>
+#include<cmath>
+#include<cstdlib>
+#include<fstream>
+#include<sstream>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+class BDTForest {
+
+public:
+  BDTForest(std::string fileName);
+  ~BDTForest(){;}
+
+  //Input expressions of the training, in the order of the input columns
+  const std::vector<std::string> & variables() const { return variables_; }
+  size_t nVariables() const { return variables_.size(); }
+  //Spectators of the training, needed only to book the same weights in a TMVA::Reader
+  const std::vector<std::string> & spectators() const { return spectators_; }
+  size_t nTrees() const { return roots_.size(); }
+  std::string fileName() const { return fileName_; }
+
+  //inputs[i*nVariables()+v] for the n rows, scores written to out[i]
+  void evaluate(const float * inputs, size_t n, float * out) const;
+  float evaluate(const float * inputs) const { float out; evaluate(inputs, 1, &out); return out; }
+
+private:
+  struct Node {
+    int var;//-1 for the leaves
+    float cut;//leaf value for the leaves
+    int pass, fail;//children for x >= cut and x < cut
+  };
+
+  std::string fileName_;
+  std::vector<std::string> variables_, spectators_;
+  std::vector<Node> nodes_;
+  std::vector<int> roots_;
+  std::vector<double> weights_;
+  double norm_;
+  bool grad_;
+
+  //Minimal reader of the TMVA xml tags: name, attributes, text up to the next tag
+  struct Tag {
+    std::string name, text;
+    std::map<std::string, std::string> attributes;
+    bool closing, empty;
+    std::string get(const std::string & a, const std::string & file) const;
+  };
+  static bool nextTag(const std::string & xml, size_t & pos, Tag & tag);
+};
+
+inline std::string BDTForest::Tag::get(const std::string & a, const std::string & file) const {
+  std::map<std::string, std::string>::const_iterator it = attributes.find(a);
+  if(it == attributes.end()) throw cms::Exception("BDTForest") << "no attribute " << a << " in <" << name << "> of " << file << "\n";
+  return it->second;
+}
+
+inline bool BDTForest::nextTag(const std::string & xml, size_t & pos, Tag & tag){
+  while(true){
+    pos = xml.find('<', pos);
+    if(pos == std::string::npos) return false;
+    if(xml.compare(pos, 4, "<!--") == 0){ pos = xml.find("-->", pos); if(pos == std::string::npos) return false; continue; }
+    if(xml.compare(pos, 2, "<?") == 0){ pos = xml.find("?>", pos); if(pos == std::string::npos) return false; continue; }
+    break;
+  }
+  size_t end = xml.find('>', pos);
+  if(end == std::string::npos) return false;
+  std::string body = xml.substr(pos + 1, end - pos - 1);
+  tag.closing = !body.empty() && body[0] == '/';
+  tag.empty = !body.empty() && body[body.size() - 1] == '/';
+  if(tag.closing) body.erase(0, 1);
+  if(tag.empty) body.erase(body.size() - 1);
+  tag.attributes.clear();
+  size_t i = body.find_first_of(" \t\r\n");
+  tag.name = body.substr(0, i);
+  while(i != std::string::npos){
+    size_t eq = body.find('=', i);
+    if(eq == std::string::npos) break;
+    size_t q1 = body.find('"', eq), q2 = q1 == std::string::npos ? q1 : body.find('"', q1 + 1);
+    if(q2 == std::string::npos) break;
+    size_t k = body.find_first_not_of(" \t\r\n", i);
+    tag.attributes[body.substr(k, body.find_last_not_of(" \t\r\n=", eq) + 1 - k)] = body.substr(q1 + 1, q2 - q1 - 1);
+    i = q2 + 1;
+  }
+  pos = end + 1;
+  size_t next = xml.find('<', pos);
+  tag.text = xml.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+  size_t t0 = tag.text.find_first_not_of(" \t\r\n"), t1 = tag.text.find_last_not_of(" \t\r\n");
+  tag.text = t0 == std::string::npos ? "" : tag.text.substr(t0, t1 + 1 - t0);
+  return true;
+}
+
+inline BDTForest::BDTForest(std::string fileName): fileName_(fileName), norm_(0.), grad_(false){
+  std::ifstream in(fileName.c_str());
+  if(!in) throw cms::Exception("BDTForest") << "cannot open " << fileName << "\n";
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  std::string xml = buffer.str();
+
+  bool yesNoLeaf = true;
+  std::vector<float> res, purity, nType;//leaf values, chosen once the options are known
+  std::vector<int> open;//nodes of the current branch
+  std::vector<int> cutType;
+  size_t pos = 0;
+  Tag tag;
+  while(nextTag(xml, pos, tag)){
+    if(tag.name == "Node"){
+      if(tag.closing){ if(!open.empty()) open.pop_back(); continue; }
+      if(roots_.empty()) throw cms::Exception("BDTForest") << "<Node> outside of a tree in " << fileName << "\n";
+      if(tag.attributes.count("NCoef") && atoi(tag.get("NCoef", fileName).c_str()) != 0) throw cms::Exception("BDTForest") << "Fisher cuts are not supported, " << fileName << "\n";
+      Node node;
+      node.var = atoi(tag.get("IVar", fileName).c_str());
+      node.cut = atof(tag.get("Cut", fileName).c_str());
+      node.pass = node.fail = -1;
+      int index = nodes_.size();
+      nodes_.push_back(node);
+      cutType.push_back(atoi(tag.get("cType", fileName).c_str()));
+      res.push_back(atof(tag.get("res", fileName).c_str()));
+      purity.push_back(atof(tag.get("purity", fileName).c_str()));
+      nType.push_back(atof(tag.get("nType", fileName).c_str()));
+      if(node.var >= 0 && node.var >= (int)variables_.size()) throw cms::Exception("BDTForest") << "cut on variable " << node.var << " of " << variables_.size() << " in " << fileName << "\n";
+      if(open.empty()){
+        if(roots_.back() != -1) throw cms::Exception("BDTForest") << "two roots in tree " << roots_.size() - 1 << " of " << fileName << "\n";
+        roots_.back() = index;
+      }
+      else{
+        //TMVA goes right for (x >= cut) == cType
+        int parent = open.back();
+        bool right = tag.get("pos", fileName) == "r";
+        if(right == (cutType[parent] == 1)) nodes_[parent].pass = index;
+        else nodes_[parent].fail = index;
+      }
+      if(!tag.empty) open.push_back(index);
+    }
+    else if(tag.closing) continue;
+    else if(tag.name == "BinaryTree"){
+      roots_.push_back(-1);
+      weights_.push_back(atof(tag.get("boostWeight", fileName).c_str()));
+      open.clear();
+    }
+    else if(tag.name == "Option"){
+      std::string name = tag.get("name", fileName);
+      if(name == "BoostType") grad_ = tag.text == "Grad";
+      if(name == "UseYesNoLeaf") yesNoLeaf = tag.text == "True" || tag.text == "1";
+    }
+    else if(tag.name == "Transformations"){
+      if(atoi(tag.get("NTransformations", fileName).c_str()) != 0) throw cms::Exception("BDTForest") << "input transformations are not supported, " << fileName << "\n";
+    }
+    else if(tag.name == "Variable"){
+      size_t index = atoi(tag.get("VarIndex", fileName).c_str());
+      if(variables_.size() <= index) variables_.resize(index + 1);
+      variables_[index] = tag.get("Expression", fileName);
+    }
+    else if(tag.name == "Spectator"){
+      size_t index = atoi(tag.get("SpecIndex", fileName).c_str());
+      if(spectators_.size() <= index) spectators_.resize(index + 1);
+      spectators_[index] = tag.get("Expression", fileName);
+    }
+  }
+  if(roots_.empty()) throw cms::Exception("BDTForest") << "no trees in " << fileName << "\n";
+  for(size_t n = 0; n < nodes_.size(); ++n){
+    Node & node = nodes_[n];
+    if(node.var < 0) node.cut = grad_ ? res[n] : (yesNoLeaf ? nType[n] : purity[n]);
+    else if(node.pass < 0 || node.fail < 0) throw cms::Exception("BDTForest") << "node with one child in " << fileName << "\n";
+  }
+  for(size_t t = 0; t < roots_.size(); ++t){
+    if(roots_[t] < 0) throw cms::Exception("BDTForest") << "empty tree " << t << " in " << fileName << "\n";
+    if(grad_) weights_[t] = 1.;
+    norm_ += weights_[t];
+  }
+}
+
+inline void BDTForest::evaluate(const float * inputs, size_t n, float * out) const {
+  size_t nVar = variables_.size();
+  std::vector<double> sums(n, 0.);
+  const Node * nodes = &nodes_[0];
+  for(size_t t = 0; t < roots_.size(); ++t){
+    double w = weights_[t];
+    for(size_t i = 0; i < n; ++i){
+      const float * x = inputs + i * nVar;
+      const Node * node = nodes + roots_[t];
+      while(node->var >= 0) node = nodes + (x[node->var] >= node->cut ? node->pass : node->fail);
+      sums[i] += w * node->cut;
+    }
+  }
+  for(size_t i = 0; i < n; ++i){
+    if(grad_) out[i] = 2. / (1. + exp(-2. * sums[i])) - 1.;
+    else out[i] = norm_ > 1.e-15 ? sums[i] / norm_ : 0.;
+  }
+}
+
+#endif
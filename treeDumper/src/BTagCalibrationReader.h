@@ -0,0 +1,314 @@
+#ifndef _BTag_Calibration_Reader_h_
+#define _BTag_Calibration_Reader_h_
+
+/**
+ *\Function BTagCalibrationReader:
+ *
+ * Data/MC b-tagging scale factors from a file in the BTagCalibration CSV format:
+ *
+ *   OperatingPoint, measurementType, sysType, jetFlavor, etaMin, etaMax, ptMin, ptMax, discrMin, discrMax, formula
+ *
+ * with OperatingPoint 0/1/2 = loose/medium/tight and jetFlavor 0/1/2 = b/c/udsg.
+ * Each formula is compiled once into a small stack program in x = pt, and the
+ * entries of every (working point, flavour, eta range) are merged into one
+ * pt-binned table, so that a single lookup returns all the requested sysTypes
+ * (e.g. central, up and down) of a jet. A negative etaMin means signed eta, |eta| otherwise.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+#include<cctype>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+class BTagSFFormula {
+
+public:
+  BTagSFFormula(){;}
+  BTagSFFormula(std::string formula);
+  double eval(double x) const;
+
+private:
+  enum Op { pushConst, pushX, add, sub, mul, div, neg, log_, exp_, sqrt_, pow_, max_, min_ };
+  //Size of the evaluation stack; deeper formulas are rejected when compiled
+  enum { maxDepth = 32 };
+  std::vector<int> ops_;
+  std::vector<double> consts_;
+  std::string text_;
+  size_t pos_;
+  int depth_;
+
+  void expression();
+  void term();
+  void unary();
+  void primary();
+  void skipSpaces();
+  void emit(int op);
+  void fail(std::string what) const;
+};
+
+class BTagCalibrationReader {
+
+public:
+  //sysTypes are returned by eval in the given order; the first is usually "central"
+  BTagCalibrationReader(std::string fileName, std::vector<std::string> sysTypes);
+  ~BTagCalibrationReader(){;}
+
+  //out[s] for each sysType, 1.0 where no entry of the file covers the jet
+  void eval(int operatingPoint, int flavor, double pt, double eta, double * out) const;
+  size_t nSysTypes() const { return sysTypes_.size(); }
+
+private:
+  enum { nOperatingPoints = 3, nFlavours = 3 };
+  struct Entry {
+    int sys;
+    double etaMin, etaMax, ptMin, ptMax;
+    int formula;
+  };
+  //All entries of one eta range, on the union of their pt edges: formulas_[bin*nSysTypes+s], -1 if none
+  struct EtaBand {
+    double etaMin, etaMax;
+    std::vector<double> ptEdges;
+    std::vector<int> formulas;
+  };
+
+  std::vector<std::string> sysTypes_;
+  std::vector<BTagSFFormula> formulas_;
+  std::vector<EtaBand> bands_[nOperatingPoints][nFlavours];
+
+  void build(const std::vector<Entry> & entries, std::vector<EtaBand> & bands);
+};
+
+inline BTagSFFormula::BTagSFFormula(std::string formula): text_(formula), pos_(0), depth_(0){
+  expression();
+  skipSpaces();
+  if(pos_ != text_.size()) fail("unexpected character");
+}
+
+inline void BTagSFFormula::fail(std::string what) const {
+  throw cms::Exception("BTagCalibrationReader") << what << " at position " << pos_ << " of formula " << text_ << "\n";
+}
+
+//Appends op and follows the stack depth it leaves at run time
+inline void BTagSFFormula::emit(int op){
+  ops_.push_back(op);
+  if(op == pushConst || op == pushX){
+    if(++depth_ > maxDepth) fail("stack deeper than the maximum");
+  }
+  else if(op != neg && op != log_ && op != exp_ && op != sqrt_) --depth_;
+}
+
+inline void BTagSFFormula::skipSpaces(){
+  while(pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r')) ++pos_;
+}
+
+inline void BTagSFFormula::expression(){
+  term();
+  for(skipSpaces(); pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-'); skipSpaces()){
+    char c = text_[pos_++];
+    term();
+    emit(c == '+' ? add : sub);
+  }
+}
+
+inline void BTagSFFormula::term(){
+  unary();
+  for(skipSpaces(); pos_ < text_.size() && (text_[pos_] == '*' || text_[pos_] == '/'); skipSpaces()){
+    char c = text_[pos_++];
+    unary();
+    emit(c == '*' ? mul : div);
+  }
+}
+
+inline void BTagSFFormula::unary(){
+  skipSpaces();
+  if(pos_ < text_.size() && (text_[pos_] == '-' || text_[pos_] == '+')){
+    char c = text_[pos_++];
+    unary();
+    if(c == '-') emit(neg);
+    return;
+  }
+  primary();
+}
+
+inline void BTagSFFormula::primary(){
+  skipSpaces();
+  if(pos_ >= text_.size()) fail("unexpected end");
+  char c = text_[pos_];
+  if(c == '('){
+    ++pos_;
+    expression();
+    skipSpaces();
+    if(pos_ >= text_.size() || text_[pos_] != ')') fail("missing )");
+    ++pos_;
+    return;
+  }
+  if(isdigit(c) || c == '.'){
+    const char * begin = text_.c_str() + pos_;
+    char * end = 0;
+    double v = strtod(begin, &end);
+    pos_ += end - begin;
+    emit(pushConst);
+    ops_.push_back(consts_.size());
+    consts_.push_back(v);
+    return;
+  }
+  size_t start = pos_;
+  while(pos_ < text_.size() && (isalnum(text_[pos_]) || text_[pos_] == '_' || text_[pos_] == ':')) ++pos_;
+  std::string name = text_.substr(start, pos_ - start);
+  if(name == "x"){ emit(pushX); return; }
+  //TMath::Log, TMath::Exp, ... as in some of the official files
+  if(name.find("TMath::") == 0) name = name.substr(7);
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  int op = -1, nargs = 1;
+  if(name == "log") op = log_;
+  else if(name == "exp") op = exp_;
+  else if(name == "sqrt") op = sqrt_;
+  else if(name == "pow" || name == "power"){ op = pow_; nargs = 2; }
+  else if(name == "max"){ op = max_; nargs = 2; }
+  else if(name == "min"){ op = min_; nargs = 2; }
+  if(op < 0) fail("unknown name "+name);
+  skipSpaces();
+  if(pos_ >= text_.size() || text_[pos_] != '(') fail("missing (");
+  ++pos_;
+  for(int a = 0; a < nargs; ++a){
+    if(a > 0){
+      skipSpaces();
+      if(pos_ >= text_.size() || text_[pos_] != ',') fail("missing ,");
+      ++pos_;
+    }
+    expression();
+  }
+  skipSpaces();
+  if(pos_ >= text_.size() || text_[pos_] != ')') fail("missing )");
+  ++pos_;
+  emit(op);
+}
+
+inline double BTagSFFormula::eval(double x) const {
+  double stack[maxDepth];
+  int top = -1;
+  for(size_t i = 0; i < ops_.size(); ++i){
+    switch(ops_[i]){
+    case pushConst: stack[++top] = consts_[ops_[++i]]; break;
+    case pushX: stack[++top] = x; break;
+    case add: --top; stack[top] += stack[top + 1]; break;
+    case sub: --top; stack[top] -= stack[top + 1]; break;
+    case mul: --top; stack[top] *= stack[top + 1]; break;
+    case div: --top; stack[top] /= stack[top + 1]; break;
+    case neg: stack[top] = -stack[top]; break;
+    case log_: stack[top] = log(stack[top]); break;
+    case exp_: stack[top] = exp(stack[top]); break;
+    case sqrt_: stack[top] = sqrt(stack[top]); break;
+    case pow_: --top; stack[top] = pow(stack[top], stack[top + 1]); break;
+    case max_: --top; stack[top] = std::max(stack[top], stack[top + 1]); break;
+    case min_: --top; stack[top] = std::min(stack[top], stack[top + 1]); break;
+    }
+  }
+  return stack[0];
+}
+
+inline BTagCalibrationReader::BTagCalibrationReader(std::string fileName, std::vector<std::string> sysTypes): sysTypes_(sysTypes){
+  std::ifstream in(fileName.c_str());
+  if(!in) throw cms::Exception("BTagCalibrationReader") << "cannot open " << fileName << "\n";
+
+  std::vector<Entry> entries[nOperatingPoints][nFlavours];
+  std::string line;
+  while(std::getline(in, line)){
+    size_t first = line.find_first_not_of(" \t");
+    if(first == std::string::npos || !isdigit(line[first])) continue;//header or empty line
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for(int f = 0; f < 10; ++f){
+      size_t comma = line.find(',', start);
+      if(comma == std::string::npos) throw cms::Exception("BTagCalibrationReader") << "bad line in " << fileName << ": " << line << "\n";
+      fields.push_back(line.substr(start, comma - start));
+      start = comma + 1;
+    }
+    //the formula may contain commas, e.g. max(a,b)
+    std::string formula = line.substr(start);
+    formula.erase(std::remove(formula.begin(), formula.end(), '"'), formula.end());
+    for(size_t f = 0; f < fields.size(); ++f){
+      fields[f].erase(0, fields[f].find_first_not_of(" \t"));
+      fields[f].erase(fields[f].find_last_not_of(" \t") + 1);
+    }
+
+    int op = atoi(fields[0].c_str());
+    int flav = atoi(fields[3].c_str());
+    std::vector<std::string>::const_iterator sys = std::find(sysTypes_.begin(), sysTypes_.end(), fields[2]);
+    if(sys == sysTypes_.end() || op < 0 || op >= nOperatingPoints || flav < 0 || flav >= nFlavours) continue;
+
+    Entry e;
+    e.sys = sys - sysTypes_.begin();
+    e.etaMin = atof(fields[4].c_str());
+    e.etaMax = atof(fields[5].c_str());
+    e.ptMin = atof(fields[6].c_str());
+    e.ptMax = atof(fields[7].c_str());
+    e.formula = formulas_.size();
+    formulas_.push_back(BTagSFFormula(formula));
+    entries[op][flav].push_back(e);
+  }
+
+  for(int op = 0; op < nOperatingPoints; ++op)
+    for(int flav = 0; flav < nFlavours; ++flav) build(entries[op][flav], bands_[op][flav]);
+}
+
+inline void BTagCalibrationReader::build(const std::vector<Entry> & entries, std::vector<EtaBand> & bands){
+  size_t nsys = sysTypes_.size();
+  for(size_t i = 0; i < entries.size(); ++i){
+    size_t b = 0;
+    while(b < bands.size() && !(bands[b].etaMin == entries[i].etaMin && bands[b].etaMax == entries[i].etaMax)) ++b;
+    if(b == bands.size()){
+      EtaBand band;
+      band.etaMin = entries[i].etaMin;
+      band.etaMax = entries[i].etaMax;
+      bands.push_back(band);
+    }
+    bands[b].ptEdges.push_back(entries[i].ptMin);
+    bands[b].ptEdges.push_back(entries[i].ptMax);
+  }
+  for(size_t b = 0; b < bands.size(); ++b){
+    EtaBand & band = bands[b];
+    std::sort(band.ptEdges.begin(), band.ptEdges.end());
+    band.ptEdges.erase(std::unique(band.ptEdges.begin(), band.ptEdges.end()), band.ptEdges.end());
+    band.formulas.assign((band.ptEdges.size() - 1) * nsys, -1);
+    for(size_t i = 0; i < entries.size(); ++i){
+      if(entries[i].etaMin != band.etaMin || entries[i].etaMax != band.etaMax) continue;
+      for(size_t p = 0; p + 1 < band.ptEdges.size(); ++p){
+        int & f = band.formulas[p * nsys + entries[i].sys];
+        //the first entry covering a bin wins
+        if(f < 0 && band.ptEdges[p] >= entries[i].ptMin && band.ptEdges[p + 1] <= entries[i].ptMax) f = entries[i].formula;
+      }
+    }
+  }
+}
+
+inline void BTagCalibrationReader::eval(int operatingPoint, int flavor, double pt, double eta, double * out) const {
+  size_t nsys = sysTypes_.size();
+  for(size_t s = 0; s < nsys; ++s) out[s] = 1.0;
+  if(operatingPoint < 0 || operatingPoint >= nOperatingPoints) return;
+  int flav = abs(flavor) == 5 ? 0 : (abs(flavor) == 4 ? 1 : 2);
+  const std::vector<EtaBand> & bands = bands_[operatingPoint][flav];
+  for(size_t b = 0; b < bands.size(); ++b){
+    const EtaBand & band = bands[b];
+    double e = band.etaMin < 0 ? eta : fabs(eta);
+    if(e < band.etaMin || e >= band.etaMax) continue;
+    if(pt < band.ptEdges.front() || pt >= band.ptEdges.back()) return;
+    size_t p = std::upper_bound(band.ptEdges.begin(), band.ptEdges.end(), pt) - band.ptEdges.begin() - 1;
+    for(size_t s = 0; s < nsys; ++s){
+      int f = band.formulas[p * nsys + s];
+      if(f >= 0) out[s] = formulas_[f].eval(pt);
+    }
+    return;
+  }
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef _BTag_Efficiency_Map_h_
+#define _BTag_Efficiency_Map_h_
+
+/**
+ *\Function BTagEfficiencyMap:
+ *
+ * MC b-tagging efficiency for one working point, read at startup from the
+ * *_bTaggingEfficiencyMap.root files of MCTaggingEfficiency (TH2 efficiency_b,
+ * efficiency_c, efficiency_udsg with pt on x and |eta| on y). Each histogram is
+ * copied into a flat table with its bin edges, so changing the maps only
+ * needs a new file. The .bin tables of makeBTaggingEfficiencyMaps hold the
+ * same flat tables and are read directly.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<string>
+#include<vector>
+#include<cmath>
+#include<cstdlib>
+#include<fstream>
+#include<stdint.h>
+
+#include "TFile.h"
+#include "TH2.h"
+#include "FWCore/Utilities/interface/Exception.h"
+
+class BTagEfficiencyMap {
+
+public:
+  BTagEfficiencyMap(std::string fileName);
+  ~BTagEfficiencyMap(){;}
+
+  //Efficiency for the parton flavour, 1.0 outside of the map as for the former tables
+  double efficiency(int flavor, double pt, double eta) const;
+  std::string fileName() const { return fileName_; }
+
+private:
+  enum Flavour { b = 0, c, udsg, nFlavours };
+  struct Table {
+    std::vector<double> ptEdges, etaEdges;
+    std::vector<double> values;//[ipt*nEta+ieta]
+  };
+
+  std::string fileName_;
+  Table tables_[nFlavours];
+
+  static void fill(TH2 * h, Table & t);
+  void readTable(std::string fileName);
+  //Branchless: number of inner edges below x, the range is checked by the caller
+  static int bin(const std::vector<double> & edges, double x);
+};
+
+inline BTagEfficiencyMap::BTagEfficiencyMap(std::string fileName): fileName_(fileName){
+  if(fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".bin") == 0){
+    readTable(fileName);
+    return;
+  }
+  TFile * f = TFile::Open(fileName.c_str());
+  if(!f || f->IsZombie()) throw cms::Exception("BTagEfficiencyMap") << "cannot open " << fileName << "\n";
+  const char * names[nFlavours] = {"efficiency_b", "efficiency_c", "efficiency_udsg"};
+  for(int fl = 0; fl < nFlavours; ++fl){
+    TH2 * h = dynamic_cast<TH2 *>(f->Get(names[fl]));
+    if(!h) throw cms::Exception("BTagEfficiencyMap") << "no " << names[fl] << " in " << fileName << "\n";
+    fill(h, tables_[fl]);
+  }
+  f->Close();
+  delete f;
+}
+
+inline void BTagEfficiencyMap::fill(TH2 * h, Table & t){
+  int nPt = h->GetNbinsX(), nEta = h->GetNbinsY();
+  for(int i = 1; i <= nPt + 1; ++i) t.ptEdges.push_back(h->GetXaxis()->GetBinLowEdge(i));
+  for(int j = 1; j <= nEta + 1; ++j) t.etaEdges.push_back(h->GetYaxis()->GetBinLowEdge(j));
+  t.values.resize(nPt * nEta);
+  for(int i = 0; i < nPt; ++i)
+    for(int j = 0; j < nEta; ++j) t.values[i * nEta + j] = h->GetBinContent(i + 1, j + 1);
+}
+
+//"BTEM", uint32 version, then per flavour uint32 nPt, uint32 nEta, edges and values as doubles
+inline void BTagEfficiencyMap::readTable(std::string fileName){
+  std::ifstream in(fileName.c_str(), std::ios::binary);
+  char magic[4] = {0, 0, 0, 0};
+  uint32_t version = 0;
+  in.read(magic, 4);
+  in.read(reinterpret_cast<char *>(&version), sizeof(version));
+  if(!in || std::string(magic, 4) != "BTEM" || version != 1) throw cms::Exception("BTagEfficiencyMap") << "cannot read the efficiency table " << fileName << "\n";
+  for(int fl = 0; fl < nFlavours; ++fl){
+    uint32_t nPt = 0, nEta = 0;
+    in.read(reinterpret_cast<char *>(&nPt), sizeof(nPt));
+    in.read(reinterpret_cast<char *>(&nEta), sizeof(nEta));
+    if(!in || nPt == 0 || nEta == 0) throw cms::Exception("BTagEfficiencyMap") << "truncated efficiency table " << fileName << "\n";
+    Table & t = tables_[fl];
+    t.ptEdges.resize(nPt + 1);
+    t.etaEdges.resize(nEta + 1);
+    t.values.resize(nPt * nEta);
+    in.read(reinterpret_cast<char *>(&t.ptEdges[0]), t.ptEdges.size() * sizeof(double));
+    in.read(reinterpret_cast<char *>(&t.etaEdges[0]), t.etaEdges.size() * sizeof(double));
+    in.read(reinterpret_cast<char *>(&t.values[0]), t.values.size() * sizeof(double));
+    if(!in) throw cms::Exception("BTagEfficiencyMap") << "truncated efficiency table " << fileName << "\n";
+  }
+}
+
+inline int BTagEfficiencyMap::bin(const std::vector<double> & edges, double x){
+  int i = 0;
+  for(size_t k = 1; k + 1 < edges.size(); ++k) i += (x >= edges[k]);
+  return i;
+}
+
+inline double BTagEfficiencyMap::efficiency(int flavor, double pt, double eta) const {
+  int fl = abs(flavor) == 5 ? b : (abs(flavor) == 4 ? c : udsg);
+  const Table & t = tables_[fl];
+  double aeta = fabs(eta);
+  if(pt < t.ptEdges.front() || pt >= t.ptEdges.back() || aeta < t.etaEdges.front() || aeta >= t.etaEdges.back()) return 1.0;
+  return t.values[bin(t.ptEdges, pt) * (t.etaEdges.size() - 1) + bin(t.etaEdges, aeta)];
+}
+
+#endif
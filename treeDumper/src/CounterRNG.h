@@ -0,0 +1,99 @@
+#ifndef _Counter_RNG_h_
+#define _Counter_RNG_h_
+
+/**
+ *\Function CounterRNG:
+ *
+ * Counter based random numbers (Philox4x32-10) for the stochastic smearings.
+ * Each draw is a pure function of (run, lumi, event) and of the
+ * (object, systematic, stream) counter, so reprocessing the same events
+ * gives bitwise identical results, independently of the event order.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<cmath>
+#include<stdint.h>
+
+class CounterRNG {
+
+public:
+  CounterRNG(){ key0 = 0; key1 = 0; }
+  ~CounterRNG(){;}
+
+  void setEvent(uint32_t run, uint32_t lumi, uint64_t event);
+  //Uniform in (0,1)
+  double uniform(uint32_t object, uint32_t syst, uint32_t stream = 0);
+  //Gaussian with mean 0 and width sigma
+  double gaus(uint32_t object, uint32_t syst, uint32_t stream = 0, double sigma = 1.0);
+
+private:
+  uint32_t key0, key1;
+
+  static uint64_t mix64(uint64_t x);
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t & hi, uint32_t & lo);
+  void philox(const uint32_t ctr[4], uint32_t out[4]) const;
+  static double toUnit(uint32_t hi, uint32_t lo);
+};
+
+//splitmix64 finalizer, used to fold run/lumi/event into the 64 bit key
+inline uint64_t CounterRNG::mix64(uint64_t x){
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+inline void CounterRNG::setEvent(uint32_t run, uint32_t lumi, uint64_t event){
+  uint64_t k = mix64(mix64(((uint64_t)run << 32) | lumi) ^ event);
+  key0 = (uint32_t)k;
+  key1 = (uint32_t)(k >> 32);
+}
+
+inline void CounterRNG::mulhilo(uint32_t a, uint32_t b, uint32_t & hi, uint32_t & lo){
+  uint64_t p = (uint64_t)a * b;
+  hi = (uint32_t)(p >> 32);
+  lo = (uint32_t)p;
+}
+
+inline void CounterRNG::philox(const uint32_t ctr[4], uint32_t out[4]) const {
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key0, k1 = key1;
+  for(int r = 0; r < 10; ++r){
+    uint32_t hi0, lo0, hi1, lo1;
+    mulhilo(0xD2511F53u, c0, hi0, lo0);
+    mulhilo(0xCD9E8D57u, c2, hi1, lo1);
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+//53 bit mantissa, shifted by half a step so that 0 and 1 are never returned
+inline double CounterRNG::toUnit(uint32_t hi, uint32_t lo){
+  uint64_t u = (((uint64_t)hi << 32) | lo) >> 11;
+  return (u + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+inline double CounterRNG::uniform(uint32_t object, uint32_t syst, uint32_t stream){
+  uint32_t ctr[4] = {object, syst, stream, 0}, out[4];
+  philox(ctr, out);
+  return toUnit(out[0], out[1]);
+}
+
+//Box-Muller on the two uniforms of a single Philox block
+inline double CounterRNG::gaus(uint32_t object, uint32_t syst, uint32_t stream, double sigma){
+  uint32_t ctr[4] = {object, syst, stream, 1}, out[4];
+  philox(ctr, out);
+  double u1 = toUnit(out[0], out[1]);
+  double u2 = toUnit(out[2], out[3]);
+  return sigma * sqrt(-2. * log(u1)) * cos(2. * M_PI * u2);
+}
+
+#endif
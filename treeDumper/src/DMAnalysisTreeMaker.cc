@@ -36,20 +36,29 @@
 #include "./mt2w_bisect.h"
 #include "./mt2bl_bisect.h"
 #include "./Mt2Com_bisect.h"
+#include "./CounterRNG.h"
+#include "./JetCorrectionChain.h"
+#include "./BTagEfficiencyMap.h"
+#include "./BTagCalibrationReader.h"
 #include "./DMTopVariables.h"
+#include "./EtaPhiIndex.h"
+#include "./ResolvedTopTriplets.h"
+#include "./BDTForest.h"
+#include "./TopKinematicFit.h"
 #include "DataFormats/HepMCCandidate/interface/GenParticle.h"
 #include "JetMETCorrections/Modules/interface/JetResolution.h"
 
 #include "TFile.h"
 #include "TTree.h"
 #include "TMath.h"
+#include "TStopwatch.h"
 #include <vector>
 #include <algorithm>
 #include <TLorentzVector.h>
 #include <TMVA/Reader.h>
 #include <string>
+#include <sstream>
 #include <iostream>
-#include <random>
 
 //using namespace reco;
 using namespace edm;
@@ -111,11 +120,10 @@ private:
   int isSig, b_mis, w_mis, wb_mis;
   float mtop;
 
-  double jetUncertainty(double pt, double eta, string syst);
-  double jetUncertainty8(double pt, double eta, string syst);
   double massUncertainty8(double mass, string syst);
-  double smear(double pt, double genpt, double eta, string syst);
-  double MassSmear(double pt, double eta, double rho,  int fac);
+  double smear(int coll, int obj, double pt, double eta, double phi, double genpt, double geneta, double genphi, string syst);
+  double jetResolution8(double pt, double eta, double rho);
+  double MassSmear(double sigma, int fac, int obj, int syst);
   double getEffectiveArea(string particle, double eta);
   double resolSF(double eta, string syst);
   double getScaleFactor(double pt, double eta, double partonFlavour, string syst);
@@ -197,7 +205,7 @@ private:
 
   map< string , bool > got_label; 
   map< string , int > max_instances; 
-  map< int, int > subj_jet_map;
+  vector< int > subj_jet_map;//fat jet of each subjet, -1 if none, refilled every event
 
   map<string, edm::Handle<std::vector<float> > > h_floats;
   map<string, edm::Handle<std::vector<int> > > h_ints;
@@ -223,6 +231,31 @@ private:
   //Do resolved top measurement:
   bool doResolvedTopHad,doResolvedTopSemiLep;
   int max_leading_jets_for_top;
+  int max_top_candidates;
+  ResolvedTopTriplets topTriplets;
+  vector<ResolvedTopTriplets::Candidate> topCandidates;
+  //BDT on the triplets, its variables are named as the resolvedTopHad branches or the jet ones below
+  enum ResolvedTopMVAInput { tmvaPt = 0, tmvaEta, tmvaMass, tmvaWMass, tmvaMassDrop, tmvaMassChi2, tmvaWBPhi,
+			     tmvaDPhiJet1b, tmvaDPhiJet2b, tmvaDRJet1b, tmvaDRJet2b,
+			     tmvaBPt, tmvaJ1Pt, tmvaJ2Pt, tmvaBCSV, tmvaJ1CSV, tmvaJ2CSV, nResolvedTopMVAInputs };
+  BDTForest * topMVA;
+  vector<int> topMVAInputs;
+  vector<float> topMVARows, topMVAScores;
+  int resolvedTopMVAInput(string name);
+  void fillResolvedTopMVAInputs(const ResolvedTopTriplets::Candidate & cand, const float * jetPt, const float * jetCSV, float * row);
+  //W and top mass fit of the kept candidates
+  bool doTopKinFit;
+  TopKinematicFit topKinFit;
+  vector<TopKinematicFit::Result> topKinFitResults;
+  vector<TLorentzVector> topJetP4s;
+  //MT2 solvers, with the results cached across the systematics of the event
+  Mt2Com_bisect mt2Com;
+  //Cross-check of topMVA with TMVA::Reader on the first events
+  TMVA::Reader * topMVAReader;
+  vector<float> topMVAReaderInputs, topMVAReaderSpectators;
+  int topMVACheckEvents, topMVAChecked;
+  size_t topMVACheckedCandidates;
+  double topMVAMaxDifference;
   int max_bjets_for_top;
   int max_genparticles;
   int n0;
@@ -243,7 +276,25 @@ private:
 
   edm::Handle<std::vector<std::vector<int>>> jetKeys;
   edm::Handle<std::vector<std::vector<int>>> muKeys;
-  
+
+  //Open addressing table PF candidate key -> muon index, built once per event from muKeys
+  class PFKeyIndex
+  {
+  private:
+    vector<int> keys;
+    vector<int> values;
+    size_t mask;
+    size_t slot(int key) const { return ((unsigned int)key * 2654435761u) & mask; }
+  public:
+    PFKeyIndex(): mask(0) {}
+    void build(const vector<vector<int> > & objKeys);
+    int find(int key) const;
+  };
+  PFKeyIndex muKeyIndex;
+  //Sum of the global/standalone muons four vectors clustered in each jet, shared by all systematics
+  vector<TLorentzVector> jetMuP4Sums;
+  void fillJetMuonSums();
+
   //Trigger info
   edm::Handle<std::vector<float> > triggerBits;
   edm::Handle<std::vector<string> > triggerNames;
@@ -281,15 +332,38 @@ private:
   
   //edm::Handle<double> Rho;
   std::vector<double> jetScanCuts;
-  std::vector<JetCorrectorParameters> jecPars, jecParsL1_vect;
-  JetCorrectorParameters *jecParsL1, *jecParsL1RC, *jecParsL2, *jecParsL3, *jecParsL2L3Residuals;
-  JetCorrectionUncertainty *jecUnc;
-  FactorizedJetCorrector *jecCorr, *jecCorr_L1;
-
-  std::vector<JetCorrectorParameters> jecPars8,  jecParsL1_vect8, jecParsNoL1_vect8;
-  JetCorrectorParameters *jecParsL18, *jecParsL1RC8, *jecParsL28, *jecParsL38, *jecParsL2L3Residuals8;
-  JetCorrectionUncertainty *jecUnc8;
-  FactorizedJetCorrector *jecCorr8,  *jecCorr_L18, *jecCorr_NoL18 ;
+  //Correction payloads are registered in the constructor and only read on first use
+  struct JetCorrectionConfig
+  {
+    string algo, payloadPrefix, uncPrefix;
+  };
+  map<string, JetCorrectionConfig> jecConfigs;//collection label -> payloads
+  map<string, JetCorrectionChain *> jecChains;//algorithm -> corrections
+  map<string, JetCorrectionChain *> jetCorrections;//collection label -> corrections
+  void addJetCorrections(string label, string algo, string payloadPrefix, string uncPrefix);
+  JetCorrectionChain * getJetCorrections(string label);
+  JME::JetResolution * getResolution(string label);
+  //what was loaded and how long it took, printed at endJob
+  vector<string> loadReport;
+  void reportLoad(string what, double seconds);
+
+  //Jet resolutions for the JER/JMR smearing, read once per job
+  JME::JetResolution *resolution4, *resolution8;
+  string resolFile4, resolFile8;
+  //Hybrid JER factors: nominal, jer__up and jer__down are computed together once per jet and event
+  struct JERFactors
+  {
+    JERFactors(): done(false), nominal(1.), up(1.), down(1.) {}
+    bool done;
+    float nominal, up, down;
+  };
+  //one cache per smeared collection, indexed by jet
+  enum JERCollection { jerAK4 = 0, jerAK8, nJERCollections };
+  vector<JERFactors> jerCache[nJERCollections];
+  void jerFactors(double pt, double eta, double phi, double genpt, double geneta, double genphi, double rcone, JME::JetResolution * res, int obj, int stream, JERFactors & f);
+  double massResolSF8, massResolSFUnc8;
+  //Reproducible random numbers for the stochastic smearings, keyed on run/lumi/event
+  CounterRNG rng;
 
   bool isFirstEvent;
   //Do preselection
@@ -297,186 +371,74 @@ private:
   
   class BTagWeight
   {
-  private:
-    int minTags;
-    int maxTags;
   public:
-    struct JetInfo
+    enum WorkingPoint { CSVL = 0, CSVM, CSVT, nWPs };
+    enum Variation { central = 0, mistagUp, mistagDown, bTagUp, bTagDown, nVariations };
+    //Category over the loose/medium/tight working points, e.g. "2 CSVM and no extra CSVL": ranges on the number of jets passing each WP
+    struct Category
     {
-      JetInfo(float mceff, float datasf) : eff(mceff), sf(datasf) {}
-      float eff;
-      float sf;
+      Category() : name("") { setRange(0, 99, 0, 99, 0, 99); }
+      //Single working point category, e.g. Category("1CSVT", CSVT, 1, 10)
+      Category(string n, int wp, int jmin, int jmax) : name(n)
+      {
+        setRange(0, 99, 0, 99, 0, 99);
+        minTags[wp] = jmin;
+        maxTags[wp] = jmax;
+      }
+      void setRange(int minL, int maxL, int minM, int maxM, int minT, int maxT)
+      {
+        minTags[CSVL] = minL; maxTags[CSVL] = maxL;
+        minTags[CSVM] = minM; maxTags[CSVM] = maxM;
+        minTags[CSVT] = minT; maxTags[CSVT] = maxT;
+      }
+      string name;
+      int minTags[nWPs];
+      int maxTags[nWPs];
+      bool filter(const int ntags[nWPs]) const;
+      //A range other than [0, 99] on the WP
+      bool constrains(int wp) const { return minTags[wp] > 0 || maxTags[wp] < 99; }
+      //WP of a category constraining at most one of them, -1 otherwise
+      int singleWP() const;
     };
-    BTagWeight():
-      minTags(0), maxTags(0)
+    //Per-jet record stored as columns: MC efficiency for each WP, data/MC SF for each WP and variation.
+    //clear() keeps the capacity, so after the first events filling it does not allocate.
+    struct JetTable
     {
-      ;
-    }
-    BTagWeight(int jmin, int jmax) :
-      minTags(jmin) , maxTags(jmax) {}
-    bool filter(int t);
-    float weight(vector<JetInfo> jets, int tags);
-    float weightWithVeto(vector<JetInfo> jetsTags, int tags, vector<JetInfo> jetsVetoes, int vetoes);
+      vector<float> eff[nWPs];
+      vector<float> sf[nWPs][nVariations];
+      size_t size() const { return eff[CSVL].size(); }
+      void clear();
+      void push_back(const double effs[nWPs], const double sfs[nWPs][nVariations]);
+    };
+    //All categories and variations in one call: result[v*cats.size()+c]. Single WP categories use the
+    //distribution of the number of tags at their WP, O(N^2), with the data efficiency eff*sf as in the
+    //historical weights. For the others each jet is in one of the states fails L / passes L only / passes
+    //M only / passes T; the joint distribution of the counts of the WPs they constrain is propagated once
+    //for MC and once per variation for data, then summed over the bins of each category. There the data
+    //efficiencies are clamped to 1 and kept nested (T <= M <= L) so that the state probabilities are >= 0.
+    void weights(const JetTable & jets, const vector<Category> & cats, const int ntags[nWPs], vector<double> & result);
+  private:
+    void propagate(const JetTable & jets, int var, vector<double> & p);//var < 0: MC
+    //P(n tags at wp), n = 0..N
+    static void tagMultiplicity(const JetTable & jets, int wp, int var, vector<double> & p);//var < 0: MC
+    int nbins[nWPs];
+    vector<double> pMC, pData, next;
+    vector<double> pMC1D[nWPs], pData1D[nWPs];
   };
-  vector<BTagWeight::JetInfo> jsfscsvt, 
-    jsfscsvt_b_tag_up, 
-    jsfscsvt_b_tag_down, 
-    jsfscsvt_mistag_up, 
-    jsfscsvt_mistag_down;
-
-  vector<BTagWeight::JetInfo> jsfscsvm, 
-    jsfscsvm_b_tag_up, 
-    jsfscsvm_b_tag_down, 
-    jsfscsvm_mistag_up, 
-    jsfscsvm_mistag_down;
-  
-  vector<BTagWeight::JetInfo> jsfscsvl, 
-    jsfscsvl_b_tag_up, 
-    jsfscsvl_b_tag_down, 
-    jsfscsvl_mistag_up, 
-    jsfscsvl_mistag_down;
-  
-  vector<BTagWeight::JetInfo> jsfscsvt_subj, 
-    jsfscsvt_subj_b_tag_up, 
-    jsfscsvt_subj_b_tag_down, 
-    jsfscsvt_subj_mistag_up, 
-    jsfscsvt_subj_mistag_down;
-
-  vector<BTagWeight::JetInfo> jsfscsvm_subj, 
-    jsfscsvm_subj_b_tag_up, 
-    jsfscsvm_subj_b_tag_down, 
-    jsfscsvm_subj_mistag_up, 
-    jsfscsvm_subj_mistag_down;
-  
-  vector<BTagWeight::JetInfo> jsfscsvl_subj, 
-    jsfscsvl_subj_b_tag_up, 
-    jsfscsvl_subj_b_tag_down, 
-    jsfscsvl_subj_mistag_up, 
-    jsfscsvl_subj_mistag_down;
-
-  //tight AK4 b-tagging weights
-  
-  BTagWeight b_csvt_0_tags= BTagWeight(0,0),
-    b_csvt_1_tag= BTagWeight(1,10),
-    b_csvt_2_tag= BTagWeight(2,10);
-  double b_weight_csvt_0_tags,
-    b_weight_csvt_1_tag,
-    b_weight_csvt_2_tag;
-  double b_weight_csvt_0_tags_mistag_up,
-    b_weight_csvt_1_tag_mistag_up,
-    b_weight_csvt_2_tag_mistag_up;
-  double b_weight_csvt_0_tags_mistag_down,
-    b_weight_csvt_1_tag_mistag_down,
-    b_weight_csvt_2_tag_mistag_down;
-  double b_weight_csvt_0_tags_b_tag_down,
-    b_weight_csvt_1_tag_b_tag_down,
-    b_weight_csvt_2_tag_b_tag_down;
-  double b_weight_csvt_0_tags_b_tag_up,
-    b_weight_csvt_1_tag_b_tag_up,
-    b_weight_csvt_2_tag_b_tag_up;
-
-  //medium AK4 b-tagging weights
-    
-  BTagWeight b_csvm_0_tags= BTagWeight(0,0),
-    b_csvm_1_tag= BTagWeight(1,10),
-    b_csvm_2_tag= BTagWeight(2,10);
-  double b_weight_csvm_0_tags,
-    b_weight_csvm_1_tag,
-    b_weight_csvm_2_tag;
-  double b_weight_csvm_0_tags_mistag_up,
-    b_weight_csvm_1_tag_mistag_up,
-    b_weight_csvm_2_tag_mistag_up;
-  double b_weight_csvm_0_tags_mistag_down,
-    b_weight_csvm_1_tag_mistag_down,
-    b_weight_csvm_2_tag_mistag_down;
-  double b_weight_csvm_0_tags_b_tag_down,
-    b_weight_csvm_1_tag_b_tag_down,
-    b_weight_csvm_2_tag_b_tag_down;
-  double b_weight_csvm_0_tags_b_tag_up,
-    b_weight_csvm_1_tag_b_tag_up,
-    b_weight_csvm_2_tag_b_tag_up;
-  //medium subjets b-tagging weights
-    
-  BTagWeight b_subj_csvm_0_tags= BTagWeight(0,0),
-    b_subj_csvm_1_tag= BTagWeight(1,10),
-    b_subj_csvm_0_1_tags= BTagWeight(0,10),
-    b_subj_csvm_2_tags= BTagWeight(2,10);
-
-  double b_weight_subj_csvm_0_tags,
-    b_weight_subj_csvm_1_tag,
-    b_weight_subj_csvm_0_1_tags,
-    b_weight_subj_csvm_2_tags;
-  double b_weight_subj_csvm_0_tags_mistag_up,
-    b_weight_subj_csvm_1_tag_mistag_up,
-    b_weight_subj_csvm_0_1_tags_mistag_up,
-    b_weight_subj_csvm_2_tags_mistag_up;
-  double b_weight_subj_csvm_0_tags_mistag_down,
-    b_weight_subj_csvm_1_tag_mistag_down,
-    b_weight_subj_csvm_0_1_tags_mistag_down,
-    b_weight_subj_csvm_2_tags_mistag_down;
-  double b_weight_subj_csvm_0_tags_b_tag_down,
-    b_weight_subj_csvm_1_tag_b_tag_down,
-    b_weight_subj_csvm_0_1_tags_b_tag_down,
-    b_weight_subj_csvm_2_tags_b_tag_down;
-  double b_weight_subj_csvm_0_tags_b_tag_up,
-    b_weight_subj_csvm_1_tag_b_tag_up,
-    b_weight_subj_csvm_0_1_tags_b_tag_up,
-    b_weight_subj_csvm_2_tags_b_tag_up;
-
-  //loose AK4 b-tagging weights
-  
-  BTagWeight b_csvl_0_tags= BTagWeight(0,0),
-    b_csvl_1_tag= BTagWeight(1,10),
-    b_csvl_2_tag= BTagWeight(2,10);
-  
-  double b_weight_csvl_0_tags_mistag_up,
-    b_weight_csvl_1_tag_mistag_up,
-    b_weight_csvl_2_tag_mistag_up;
-  double b_weight_csvl_0_tags_mistag_down,
-    b_weight_csvl_1_tag_mistag_down,
-    b_weight_csvl_2_tag_mistag_down;
-  double b_weight_csvl_0_tags_b_tag_down,
-    b_weight_csvl_1_tag_b_tag_down,
-    b_weight_csvl_2_tag_b_tag_down;
-  double b_weight_csvl_0_tags_b_tag_up,
-    b_weight_csvl_1_tag_b_tag_up,
-    b_weight_csvl_2_tag_b_tag_up;
-  double b_weight_csvl_0_tags,
-    b_weight_csvl_1_tag,
-    b_weight_csvl_2_tag;
-
-  //loose subjets b-tagging weights
-
-  BTagWeight b_subj_csvl_0_tags= BTagWeight(0,0),
-    b_subj_csvl_1_tag= BTagWeight(1,10),
-    b_subj_csvl_0_1_tags= BTagWeight(0,10),
-    b_subj_csvl_2_tags= BTagWeight(2,10);
-  
-  double b_weight_subj_csvl_0_tags_mistag_up,
-    b_weight_subj_csvl_1_tag_mistag_up,
-    b_weight_subj_csvl_0_1_tags_mistag_up,
-    b_weight_subj_csvl_2_tags_mistag_up;
-  double b_weight_subj_csvl_0_tags_mistag_down,
-    b_weight_subj_csvl_1_tag_mistag_down,
-    b_weight_subj_csvl_0_1_tags_mistag_down,
-    b_weight_subj_csvl_2_tags_mistag_down;
-  double b_weight_subj_csvl_0_tags_b_tag_down,
-    b_weight_subj_csvl_1_tag_b_tag_down,
-    b_weight_subj_csvl_0_1_tags_b_tag_down,
-    b_weight_subj_csvl_2_tags_b_tag_down;
-  double b_weight_subj_csvl_0_tags_b_tag_up,
-    b_weight_subj_csvl_1_tag_b_tag_up,
-    b_weight_subj_csvl_0_1_tags_b_tag_up,
-    b_weight_subj_csvl_2_tags_b_tag_up;
-  double b_weight_subj_csvl_0_tags,
-    b_weight_subj_csvl_1_tag,
-    b_weight_subj_csvl_0_1_tags,
-    b_weight_subj_csvl_2_tags;
-  
-  double MCTagEfficiency(string algo, int flavor, double pt, double eta);
-  double MCTagEfficiencySubjet(string algo, int flavor, double pt, double eta); 
-  double TagScaleFactor(string algo, int flavor, string syst,double pt);
-  double TagScaleFactorSubjet(string algo, int flavor, string syst,double pt);
+  //Built-in single WP categories and the ones from "bTagCategories", for AK4 jets and AK8 subjets
+  vector<BTagWeight::Category> bTagCategoriesAK4, bTagCategoriesSubj;
+  //Event_bWeight<variation><category> names, aligned with the engine output
+  vector<string> bTagBranchesAK4, bTagBranchesSubj;
+  BTagWeight::JetTable bJetsAK4, bJetsSubj;
+  BTagWeight bTagEngine;
+  vector<double> bTagWeightsAK4, bTagWeightsSubj;
+  void bookBTagCategories(const vector<BTagWeight::Category> & cats, vector<string> & branches);
+  
+  //MC tagging efficiencies per working point, loaded at startup from the *_bTaggingEfficiencyMap.root files
+  BTagEfficiencyMap * bTagEffMapsAK4[BTagWeight::nWPs], * bTagEffMapsSubj[BTagWeight::nWPs];
+  void loadBTagEfficiencyMaps(const edm::ParameterSet & iConfig, string param, vector<string> defaults, BTagEfficiencyMap * maps[BTagWeight::nWPs]);
+  //Data/MC scale factors, all the BTagWeight variations of a jet in one call
+  BTagCalibrationReader * bTagSFsAK4, * bTagSFsSubj;
   
   //
   bool doBTagSF;
@@ -512,6 +474,35 @@ DMAnalysisTreeMaker::DMAnalysisTreeMaker(const edm::ParameterSet& iConfig){
   originalEvents = channelInfo.getParameter<double>("originalEvents");
 
   doPreselection = iConfig.getUntrackedParameter<bool>("doPreselection",true);
+
+  //b-tag categories: the historical single WP ones, then the ones over several working points from "bTagCategories"
+  //Each fills Event_bWeight<name> and its mistag/b-tag variations
+  string wpNames[BTagWeight::nWPs] = {"CSVL","CSVM","CSVT"};
+  for(int wp = BTagWeight::CSVT; wp >= BTagWeight::CSVL; --wp){
+    bTagCategoriesAK4.push_back(BTagWeight::Category("0"+wpNames[wp], wp, 0, 0));
+    bTagCategoriesAK4.push_back(BTagWeight::Category("1"+wpNames[wp], wp, 1, 10));
+    bTagCategoriesAK4.push_back(BTagWeight::Category("2"+wpNames[wp], wp, 2, 10));
+  }
+  for(int wp = BTagWeight::CSVM; wp >= BTagWeight::CSVL; --wp){
+    bTagCategoriesSubj.push_back(BTagWeight::Category("0"+wpNames[wp]+"_subj", wp, 0, 0));
+    bTagCategoriesSubj.push_back(BTagWeight::Category("1"+wpNames[wp]+"_subj", wp, 1, 10));
+    bTagCategoriesSubj.push_back(BTagWeight::Category("2"+wpNames[wp]+"_subj", wp, 2, 10));
+    bTagCategoriesSubj.push_back(BTagWeight::Category("0_1"+wpNames[wp]+"_subj", wp, 0, 10));
+  }
+  std::vector<edm::ParameterSet> bTagCategoriesPSet = iConfig.getUntrackedParameter<std::vector<edm::ParameterSet> >("bTagCategories",std::vector<edm::ParameterSet>());
+  for(size_t c = 0; c < bTagCategoriesPSet.size(); ++c){
+    const edm::ParameterSet & catPSet = bTagCategoriesPSet.at(c);
+    BTagWeight::Category cat;
+    cat.name = catPSet.getUntrackedParameter<std::string>("name");
+    cat.setRange(catPSet.getUntrackedParameter<int>("minLoose",0), catPSet.getUntrackedParameter<int>("maxLoose",99),
+		 catPSet.getUntrackedParameter<int>("minMedium",0), catPSet.getUntrackedParameter<int>("maxMedium",99),
+		 catPSet.getUntrackedParameter<int>("minTight",0), catPSet.getUntrackedParameter<int>("maxTight",99));
+    if(catPSet.getUntrackedParameter<bool>("subjets",false)) bTagCategoriesSubj.push_back(cat);
+    else bTagCategoriesAK4.push_back(cat);
+  }
+  bookBTagCategories(bTagCategoriesAK4, bTagBranchesAK4);
+  bookBTagCategories(bTagCategoriesSubj, bTagBranchesSubj);
+
   doPU = iConfig.getUntrackedParameter<bool>("doPU",true);
 
   useLHEWeights = channelInfo.getUntrackedParameter<bool>("useLHEWeights",false);
@@ -614,11 +605,59 @@ DMAnalysisTreeMaker::DMAnalysisTreeMaker(const edm::ParameterSet& iConfig){
   if(addLHAPDFWeights){
     centralPdfSet = channelInfo.getUntrackedParameter<string>("pdfSet","NNPDF");
     variationPdfSet = channelInfo.getUntrackedParameter<string>("pdfSet","NNPDF");
+    TStopwatch pdfTimer;
+    pdfTimer.Start();
     initializePdf(centralPdfSet,variationPdfSet);
+    pdfTimer.Stop();
+    reportLoad("LHAPDF "+centralPdfSet+"/"+variationPdfSet, pdfTimer.RealTime());
 
   }
+  max_top_candidates = 0;
+  topMVA = 0;
+  topMVAReader = 0;
+  topMVACheckEvents = topMVAChecked = 0;
+  topMVACheckedCandidates = 0;
+  topMVAMaxDifference = 0.;
+  doTopKinFit = false;
   if(doResolvedTopHad){
     max_leading_jets_for_top  = iConfig.getUntrackedParameter<int>("maxLeadingJetsForTop",8);//Take the 8 leading jets for the top permutations
+    //Optional W and top mass windows, applied before the candidate variables are computed
+    std::vector<double> wWindow = iConfig.getUntrackedParameter<std::vector<double> >("resolvedTopHadWMassWindow",std::vector<double>());
+    std::vector<double> topWindow = iConfig.getUntrackedParameter<std::vector<double> >("resolvedTopHadTopMassWindow",std::vector<double>());
+    if((!wWindow.empty() && wWindow.size()!=2) || (!topWindow.empty() && topWindow.size()!=2)) throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadWMassWindow/resolvedTopHadTopMassWindow need {min, max}\n";
+    topTriplets.setMassWindows(wWindow.empty() ? -1.e9 : wWindow[0], wWindow.empty() ? 1.e9 : wWindow[1],
+			       topWindow.empty() ? -1.e9 : topWindow[0], topWindow.empty() ? 1.e9 : topWindow[1]);
+    //Only the best maxCandidates (0: all) by the ranking are saved, best first
+    max_top_candidates = iConfig.getUntrackedParameter<int>("resolvedTopHadMaxCandidates",10);
+    if(max_top_candidates > 100) throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadMaxCandidates above the 100 slots of the arrays\n";
+    std::vector<double> massHyp = iConfig.getUntrackedParameter<std::vector<double> >("resolvedTopHadMassHypotheses",std::vector<double>());
+    if(!massHyp.empty() && massHyp.size()!=4) throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadMassHypotheses needs {mW, sigmaW, mTop, sigmaTop}\n";
+    if(massHyp.size()==4) topTriplets.setMassHypotheses(massHyp[0],massHyp[1],massHyp[2],massHyp[3]);
+    topTriplets.setRanking(ResolvedTopTriplets::ranking(iConfig.getUntrackedParameter<string>("resolvedTopHadRanking","massChi2")), max_top_candidates);
+    string mvaWeights = iConfig.getUntrackedParameter<string>("resolvedTopHadMVAWeights","");
+    if(!mvaWeights.empty()){
+      topMVA = new BDTForest(mvaWeights);
+      for(size_t v = 0; v < topMVA->nVariables(); ++v) topMVAInputs.push_back(resolvedTopMVAInput(topMVA->variables().at(v)));
+      topMVACheckEvents = iConfig.getUntrackedParameter<int>("resolvedTopHadMVACheckEvents",0);
+      if(topMVACheckEvents > 0){
+	topMVAReaderInputs.resize(topMVA->nVariables());
+	topMVAReaderSpectators.resize(topMVA->spectators().size());
+	topMVAReader = new TMVA::Reader("!Color:Silent");
+	for(size_t v = 0; v < topMVA->nVariables(); ++v) topMVAReader->AddVariable(topMVA->variables().at(v).c_str(), &topMVAReaderInputs[v]);
+	for(size_t v = 0; v < topMVA->spectators().size(); ++v) topMVAReader->AddSpectator(topMVA->spectators().at(v).c_str(), &topMVAReaderSpectators[v]);
+	topMVAReader->BookMVA("BDT", mvaWeights.c_str());
+      }
+      ostringstream what;
+      what << "resolvedTopHad BDT " << mvaWeights << " (" << topMVA->nTrees() << " trees)";
+      reportLoad(what.str(), 0.);
+    }
+    //Jet scales fitted to {mW, widthW, mTop, widthTop} with a fixed number of Gauss-Newton steps
+    doTopKinFit = iConfig.getUntrackedParameter<bool>("resolvedTopHadKinFit",false);
+    topKinFit.setIterations(iConfig.getUntrackedParameter<int>("resolvedTopHadKinFitIterations",5));
+    std::vector<double> fitMasses = iConfig.getUntrackedParameter<std::vector<double> >("resolvedTopHadKinFitMasses",std::vector<double>());
+    if(!fitMasses.empty() && fitMasses.size()!=4) throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadKinFitMasses needs {mW, widthW, mTop, widthTop}\n";
+    if(fitMasses.size()==4) topKinFit.setMasses(fitMasses[0],fitMasses[1],fitMasses[2],fitMasses[3]);
+    if(topTriplets.ranking()==ResolvedTopTriplets::byMVA && !topMVA) throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadRanking mva needs resolvedTopHadMVAWeights\n";
   }
   if(doResolvedTopSemiLep){
     max_bjets_for_top  = iConfig.getUntrackedParameter<int>("maxBJetsForTop",2);//Take the 8 leading jets for the top permutations
@@ -629,6 +668,10 @@ DMAnalysisTreeMaker::DMAnalysisTreeMaker(const edm::ParameterSet& iConfig){
   systematics = iConfig.getParameter<std::vector<std::string> >("systematics");
 
   jetScanCuts = iConfig.getParameter<std::vector<double> >("jetScanCuts");
+  //Absolute precision of Event_Mt2w in GeV, 0 for the default of mt2w_bisect
+  mt2Com.set_precision(iConfig.getUntrackedParameter<double>("mt2wPrecision",0.));
+  //Opt-in growing step of the mt2w scan, faster but it can miss narrow compatible windows: 0 for the fixed step
+  mt2Com.set_scan_relative_step(iConfig.getUntrackedParameter<double>("mt2wScanRelativeStep",0.));
 
   std::vector<edm::ParameterSet >::const_iterator itPsets = physObjects.begin();
 
@@ -824,7 +867,7 @@ DMAnalysisTreeMaker::DMAnalysisTreeMaker(const edm::ParameterSet& iConfig){
   if(doResolvedTopHad){
     string nameshortv= "resolvedTopHad";
     vector<string> extravarstop = additionalVariables(nameshortv);
-    double max_instances_top = TMath::Binomial(min((int)(max_instances[jets_label]),max_leading_jets_for_top),4);
+    double max_instances_top = max_top_candidates > 0 ? max_top_candidates : TMath::Binomial(min((int)(max_instances[jets_label]),max_leading_jets_for_top),4);
     max_instances[nameshortv]=max_instances_top;
     stringstream mtop;
     mtop << max_instances_top;
@@ -882,84 +925,53 @@ DMAnalysisTreeMaker::DMAnalysisTreeMaker(const edm::ParameterSet& iConfig){
 
   initTreeWeightHistory(useLHEWeights);
 
-  string L1Name ="Summer16_23Sep2016V4_MC_L1FastJet_AK4PFchs.txt"; 
-  string L1RCName = "Summer16_23Sep2016V4_MC_L1RC_AK4PFchs.txt"; 
-  string L2Name = "Summer16_23Sep2016V4_MC_L2Relative_AK4PFchs.txt";
-  string L3Name = "Summer16_23Sep2016V4_MC_L3Absolute_AK4PFchs.txt";
-  string L2L3ResName = "Summer16_23Sep2016V4_MC_L2L3Residual_AK4PFchs.txt";
-
-  if(isData){
-    L1Name   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L1FastJet_AK4PFchs.txt").c_str() ;
-    L1RCName = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L1RC_AK4PFchs.txt").c_str() ;  
-    L2Name   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L2Relative_AK4PFchs.txt").c_str() ;
-    L3Name   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L3Absolute_AK4PFchs.txt").c_str() ;
-    L2L3ResName = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L2L3Residual_AK4PFchs.txt").c_str() ;
-  }
-
-  if(isV2){
-    L1Name = "Summer16_23Sep2016V4_MC_L1FastJet_AK4PFchs.txt";
-    L2Name = "Summer16_23Sep2016V4_MC_L2Relative_AK4PFchs.txt";
-    L3Name = "Summer16_23Sep2016V4_MC_L3Absolute_AK4PFchs.txt";
-    L2L3ResName = "Summer16_23Sep2016V4_MC_L2L3Residual_AK4PFchs.txt"; 
-  }
-
-  jecParsL1  = new JetCorrectorParameters(L1Name);
-  jecParsL2  = new JetCorrectorParameters(L2Name);
-  jecParsL3  = new JetCorrectorParameters(L3Name);
-  jecParsL2L3Residuals  = new JetCorrectorParameters(L2L3ResName);
-  jecPars.push_back(*jecParsL1);
-  jecPars.push_back(*jecParsL2);
-  jecPars.push_back(*jecParsL3);
-  if(isData)jecPars.push_back(*jecParsL2L3Residuals);
-
-  jecParsL1_vect.push_back(*jecParsL1);
-  
-  jecCorr = new FactorizedJetCorrector(jecPars);
-  jecCorr_L1 = new FactorizedJetCorrector(jecParsL1_vect);
-  jecUnc  = new JetCorrectionUncertainty(*(new JetCorrectorParameters(("Summer16_23Sep2016"+EraLabel+"V4_DATA_UncertaintySources_AK4PFchs.txt").c_str() , "Total")));
-
-  //corrections on AK8
-  //  string PtResol = "Spring16_25nsV10_MC_PtResolution_AK8PFchs.txt";
-
-  string L1Name8 = "Summer16_23Sep2016V4_MC_L1FastJet_AK8PFchs.txt"; 
-  string L1RCName8 = "Summer16_23Sep2016V4_MC_L1RC_AK8PFchs.txt"; 
-  string L2Name8 = "Summer16_23Sep2016V4_MC_L2Relative_AK8PFchs.txt";
-  string L3Name8 = "Summer16_23Sep2016V4_MC_L3Absolute_AK8PFchs.txt";
-  string L2L3ResName8 = "Summer16_23Sep2016V4_MC_L2L3Residual_AK8PFchs.txt";
-
-  if(isData){
-    L1Name8   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L1FastJet_AK8PFchs.txt").c_str() ;
-    L1RCName8 = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L1RC_AK8PFchs.txt").c_str() ;  
-    L2Name8   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L2Relative_AK8PFchs.txt").c_str() ;
-    L3Name8   = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L3Absolute_AK8PFchs.txt").c_str() ;
-    L2L3ResName8 = ("Summer16_23Sep2016"+EraLabel+"V4_DATA_L2L3Residual_AK8PFchs.txt").c_str() ;
-  }
-
-  if(isV2){
-    L1Name8 = "Summer16_23Sep2016V4_MC_L1FastJet_AK8PFchs.txt";
-    L2Name8 = "Summer16_23Sep2016V4_MC_L2Relative_AK8PFchs.txt";
-    L3Name8 = "Summer16_23Sep2016V4_MC_L3Absolute_AK8PFchs.txt";
-    L2L3ResName8 = "Summer16_23Sep2016V4_MC_L2L3Residual_AK8PFchs.txt"; 
-  }
-
-  jecParsL18  = new JetCorrectorParameters(L1Name8);
-  jecParsL28  = new JetCorrectorParameters(L2Name8);
-  jecParsL38  = new JetCorrectorParameters(L3Name8);
-  jecParsL2L3Residuals8  = new JetCorrectorParameters(L2L3ResName8);
-  jecPars8.push_back(*jecParsL18);
-  jecPars8.push_back(*jecParsL28);
-  jecPars8.push_back(*jecParsL38);
-  if(isData)jecPars8.push_back(*jecParsL2L3Residuals8);
-
-  jecParsL1_vect8.push_back(*jecParsL18);
-  jecParsNoL1_vect8.push_back(*jecParsL28);
-  jecParsNoL1_vect8.push_back(*jecParsL38);
-  if(isData)jecParsNoL1_vect8.push_back(*jecParsL2L3Residuals8);
-    
-  jecCorr8 = new FactorizedJetCorrector(jecPars8);
-  jecCorr_L18 = new FactorizedJetCorrector(jecParsL1_vect8);
-  jecCorr_NoL18 = new FactorizedJetCorrector(jecParsNoL1_vect8);
-  jecUnc8  = new JetCorrectionUncertainty(*(new JetCorrectorParameters(("Summer16_23Sep2016"+EraLabel+"V4_DATA_UncertaintySources_AK8PFchs.txt").c_str() , "Total")));
+  //Jet energy corrections: one chain per jet algorithm, shared by the collections using it.
+  //PUPPI jets only need e.g. jecAlgoAK8 = "AK8PFPuppi". Only the jets_label and boosted_tops_label
+  //collections are corrected, each by its own loop below, so CHS and PUPPI jets of the same size
+  //cannot be run in the same job.
+  string jecPrefix = "Summer16_23Sep2016V4_MC_";
+  if(isData && !isV2) jecPrefix = "Summer16_23Sep2016"+EraLabel+"V4_DATA_";
+  string jecUncPrefix = "Summer16_23Sep2016"+EraLabel+"V4_DATA_";
+  addJetCorrections(jets_label, iConfig.getUntrackedParameter<string>("jecAlgoAK4","AK4PFchs"), jecPrefix, jecUncPrefix);
+  addJetCorrections(boosted_tops_label, iConfig.getUntrackedParameter<string>("jecAlgoAK8","AK8PFchs"), jecPrefix, jecUncPrefix);
+
+  //b-tagging efficiencies, loose/medium/tight; an empty file name means the working point is not used (efficiency 0)
+  vector<string> effMapsAK4, effMapsSubj;
+  effMapsAK4.push_back("Maps/bTaggingEfficiency_AK4CHS_CSVv2l_AK4CHS_CSVL_bTaggingEfficiencyMap.root");
+  effMapsAK4.push_back("Maps/bTaggingEfficiency_AK4CHS_CSVv2m_AK4CHS_CSVM_bTaggingEfficiencyMap.root");
+  effMapsAK4.push_back("Maps/bTaggingEfficiency_AK4CHS_CSVv2t_AK4CHS_CSVT_bTaggingEfficiencyMap.root");
+  effMapsSubj.push_back("Maps/bTaggingEfficiency_AK8SoftDropSubj_CSVv2l_AK8Subj_CSVL_bTaggingEfficiencyMap.root");
+  effMapsSubj.push_back("Maps/bTaggingEfficiency_AK8SoftDropSubj_CSVv2m_AK8Subj_CSVM_bTaggingEfficiencyMap.root");
+  effMapsSubj.push_back("");
+  loadBTagEfficiencyMaps(iConfig, "bTagEfficiencyMapsAK4", effMapsAK4, bTagEffMapsAK4);
+  loadBTagEfficiencyMaps(iConfig, "bTagEfficiencyMapsSubj", effMapsSubj, bTagEffMapsSubj);
+
+  //b-tagging scale factors in the BTagCalibration csv format, sysTypes in the order of BTagWeight::Variation
+  vector<string> sfSysTypes;
+  sfSysTypes.push_back("central");
+  sfSysTypes.push_back("up_mistag");
+  sfSysTypes.push_back("down_mistag");
+  sfSysTypes.push_back("up");
+  sfSysTypes.push_back("down");
+  string sfFileAK4 = iConfig.getUntrackedParameter<string>("bTagSFFileAK4","CSVv2_AK4_bTagSF.csv");
+  string sfFileSubj = iConfig.getUntrackedParameter<string>("bTagSFFileSubj","CSVv2_AK8Subjets_bTagSF.csv");
+  TStopwatch sfTimer;
+  sfTimer.Start();
+  bTagSFsAK4 = new BTagCalibrationReader(sfFileAK4, sfSysTypes);
+  bTagSFsSubj = new BTagCalibrationReader(sfFileSubj, sfSysTypes);
+  sfTimer.Stop();
+  reportLoad("b-tag scale factors "+sfFileAK4+", "+sfFileSubj, sfTimer.RealTime());
+
+  //resolutions
+  resolFile4 = iConfig.getUntrackedParameter<string>("resolutionsFileAK4","");//without an AK4 resolution file unmatched AK4 jets are not smeared
+  if(doTopKinFit && resolFile4=="") throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHadKinFit needs the AK4 jet resolutions, resolutionsFileAK4\n";
+  resolFile8 = iConfig.getUntrackedParameter<string>("resolutionsFileAK8","Spring16_25nsV10_MC_PtResolution_AK8PFchs.txt");//as AK4, and no mass smearing
+  resolution4 = 0;
+  resolution8 = 0;
+  massResolSF8 = 1.23;
+  massResolSFUnc8 = 0.18;
+
+  cout << "DMAnalysisTreeMaker: JEC for "<< jets_label << " ("<< jecConfigs[jets_label].algo << "), "<< boosted_tops_label << " ("<< jecConfigs[boosted_tops_label].algo << ") and resolutions ("<< (resolFile4=="" ? "none" : resolFile4) << ", "<< resolFile8 << ") will be loaded on first use"<<endl;
 
   isFirstEvent = true;
   doBTagSF= true;
@@ -992,6 +1004,10 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
   iEvent.getByToken(t_lumiBlock_,lumiBlock );
   iEvent.getByToken(t_runNumber_,runNumber );
   iEvent.getByToken(t_eventNumber_,eventNumber );
+  rng.setEvent(*runNumber, *lumiBlock, *eventNumber);
+  for(int c = 0; c < nJERCollections; ++c){
+    jerCache[c].assign(jerCache[c].size(), JERFactors());
+  }
 
   if(useLHE){
     iEvent.getByToken(t_lhes_, lhes);
@@ -1422,6 +1438,9 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 
   //  std::cout << " checkpoint part 1"<<endl;
 
+  //Muon subtraction for the type-1 MET does not depend on the systematics: do it once per event
+  if(changeJECs) fillJetMuonSums();
+
   //Part 2: selection and analysis-level changes
   //This might change for each particular systematics, 
   //e.g. for each jet energy scale variation, for MET or even lepton energy scale variations
@@ -1441,6 +1460,9 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
   vector<TLorentzVector> type2topjets;
   vector<TLorentzVector> resolvedtops;
 
+  //eta-phi indices for the Delta R searches across collections
+  EtaPhiIndex looseMuonIndex, tightElectronIndex, tightMuonIndex, ak4JetIndex, fatJetIndex;
+
   vector<float> leptonsCharge;
 
   vector<int> flavors;
@@ -1468,35 +1490,8 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
     string syst = systematics.at(s);
     nTightJets=0;
 
-    jsfscsvt.clear();
-    jsfscsvt_b_tag_up.clear(); 
-    jsfscsvt_b_tag_down.clear(); 
-    jsfscsvt_mistag_up.clear(); 
-    jsfscsvt_mistag_down.clear();
-
-    jsfscsvm.clear(); 
-    jsfscsvm_b_tag_up.clear(); 
-    jsfscsvm_b_tag_down.clear(); 
-    jsfscsvm_mistag_up.clear(); 
-    jsfscsvm_mistag_down.clear();
-    
-    jsfscsvl.clear(); 
-    jsfscsvl_b_tag_up.clear(); 
-    jsfscsvl_b_tag_down.clear(); 
-    jsfscsvl_mistag_up.clear();
-    jsfscsvl_mistag_down.clear();
-
-    jsfscsvm_subj.clear(); 
-    jsfscsvm_subj_b_tag_up.clear(); 
-    jsfscsvm_subj_b_tag_down.clear(); 
-    jsfscsvm_subj_mistag_up.clear(); 
-    jsfscsvm_subj_mistag_down.clear();
-    
-    jsfscsvl_subj.clear(); 
-    jsfscsvl_subj_b_tag_up.clear(); 
-    jsfscsvl_subj_b_tag_down.clear(); 
-    jsfscsvl_subj_mistag_up.clear();
-    jsfscsvl_subj_mistag_down.clear();
+    bJetsAK4.clear();
+    bJetsSubj.clear();
 
 
     //---------------- Soureek Adding PU Info ------------------------------
@@ -1633,6 +1628,10 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       }
     }
 
+    looseMuonIndex.clear();
+    for(size_t m = 0; m < loosemuons.size(); ++m) looseMuonIndex.add(loosemuons[m].Eta(), loosemuons[m].Phi());
+    looseMuonIndex.build();
+
     //Electrons:
     for(int el = 0;el < max_instances[ele_label] ;++el){
       string pref = obj_to_pref[ele_label];
@@ -1666,13 +1665,7 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       if(pt> 30 && fabs(eta) < 2.1 && passesTightCuts){
 	TLorentzVector ele;
 	ele.SetPtEtaPhiE(pt, eta, phi, energy);	
-	double minDR=999;
-	double deltaR = 999;
-	for (size_t m = 0; m < (size_t)loosemuons.size(); ++m){
-	  deltaR = ele.DeltaR(loosemuons[m]);
-	  minDR = min(minDR, deltaR);
-	}
-	if(!loosemuons.size()) minDR=999;
+	double minDR = loosemuons.size() ? sqrt(looseMuonIndex.minDR2(ele.Eta(), ele.Phi())) : 999;
 	if(minDR>0.1){ 
 	  electrons.push_back(ele); 
 	  flavors.push_back(11);
@@ -1773,12 +1766,23 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
     float metZeroCorrY = metZeroCorrPt*sin(metZeroCorrPhi);
     float metZeroCorrX = metZeroCorrPt*cos(metZeroCorrPhi);
 
+    tightElectronIndex.clear();
+    for(size_t e = 0; e < electrons.size(); ++e) tightElectronIndex.add(electrons[e].Eta(), electrons[e].Phi());
+    tightElectronIndex.build();
+    tightMuonIndex.clear();
+    for(size_t m = 0; m < muons.size(); ++m) tightMuonIndex.add(muons[m].Eta(), muons[m].Phi());
+    tightMuonIndex.build();
+
+    JetCorrectionChain * jec = 0;
+    if(changeJECs || syst == "jes__up" || syst == "jes__down") jec = getJetCorrections(jets_label);
     for(int j = 0;j < max_instances[jets_label] ;++j){
       string pref = obj_to_pref[jets_label];
       float pt = vfloats_values[makeName(jets_label,pref,"Pt")][j];
       float ptnomu = pt;
       float ptzero = vfloats_values[makeName(jets_label,pref,"Pt")][j];
       float genpt = vfloats_values[makeName(jets_label,pref,"GenJetPt")][j];
+      float geneta = vfloats_values[makeName(jets_label,pref,"GenJetEta")][j];
+      float genphi = vfloats_values[makeName(jets_label,pref,"GenJetPhi")][j];
       float eta = vfloats_values[makeName(jets_label,pref,"Eta")][j];
       float phi = vfloats_values[makeName(jets_label,pref,"Phi")][j];
       float energy = vfloats_values[makeName(jets_label,pref,"E")][j];
@@ -1819,15 +1823,7 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	
 	if(changeJECs){
 	   
-	  jecCorr->setJetPhi(jetUncorr_.Phi());
-	  jecCorr->setJetEta(jetUncorr_.Eta());
-	  jecCorr->setJetE(jetUncorr_.E());
-	  jecCorr->setJetPt(jetUncorr_.Perp());
-	  jecCorr->setJetA(area);
-	  jecCorr->setRho(Rho);
-	  jecCorr->setNPV(nPV);
-	  
-	  double recorr =  jecCorr->getCorrection();
+	  double recorr =  jec->correction(jetUncorr_.Perp(), jetUncorr_.Eta(), jetUncorr_.Phi(), jetUncorr_.E(), area, Rho, nPV);
 	  jetCorr = jetUncorr_ *recorr;
 	  
 	  pt = jetCorr.Pt();
@@ -1835,68 +1831,30 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	  energy = jetCorr.Energy();
 	  phi = jetCorr.Phi();
 	 
-	  for( size_t c=0;c<jetKeys->at(j).size();++c){
-	    for( size_t mk=0;mk<muKeys->size();++mk){
-	      if(muKeys->at(mk).size()>0){
-		if(muKeys->at(mk).at(0)  == jetKeys->at(j).at(c)){
-		  
-		  string prefmu = obj_to_pref[mu_label];
-		  float mupt = vfloats_values[makeName(mu_label,prefmu,"Pt")][mk];
-		  float mueta = vfloats_values[makeName(mu_label,prefmu,"Eta")][mk];
-		  float muphi = vfloats_values[makeName(mu_label,prefmu,"Phi")][mk];
-		  float mue = vfloats_values[makeName(mu_label,prefmu,"E")][mk];
-		  float muIsGlobal = vfloats_values[makeName(mu_label,prefmu,"IsGlobalMuon")][mk];
-		  float muIsTK = vfloats_values[makeName(mu_label,prefmu,"IsTrackerMuon")][mk];
-		  float muISSAOnly = ((!muIsGlobal && !muIsTK));
-		  
-		  if(muIsGlobal || muISSAOnly){
-		    TLorentzVector muP4_;
-		    muP4_.SetPtEtaPhiE(mupt,mueta,muphi,mue);
-		    jetUncorrNoMu_ -=muP4_;
-		    
-		  } 
-		}
-	      }
-	    }	    
-	    
-	    jecCorr->setJetPhi(jetUncorrNoMu_.Phi());
-	    jecCorr->setJetEta(jetUncorrNoMu_.Eta());
-	    jecCorr->setJetE(jetUncorrNoMu_.E());
-	    jecCorr->setJetPt(jetUncorrNoMu_.Perp());
-	    jecCorr->setJetA(area);
-	    jecCorr->setRho(Rho);
-	    jecCorr->setNPV(nPV);
-	    
-	    double recorrMu =  jecCorr->getCorrection();
-	    jetCorrNoMu = jetUncorrNoMu_ * recorrMu;
-	    
-	    //// Jet corrections for level 1
-	    jecCorr_L1->setJetPhi(jetUncorrNoMu_.Phi()); /// deve essere raw
-	    jecCorr_L1->setJetEta(jetUncorrNoMu_.Eta());
-	    jecCorr_L1->setJetE(jetUncorrNoMu_.E());
-	    jecCorr_L1->setJetPt(jetUncorrNoMu_.Perp());
-	    jecCorr_L1->setJetA(area);
-	    jecCorr_L1->setRho(Rho);
-	    jecCorr_L1->setNPV(nPV);
+	  if(j < (int)jetMuP4Sums.size()){
+	    jetUncorrNoMu_ -= jetMuP4Sums.at(j);
+	  }
+	  double recorrMu =  jec->correction(jetUncorrNoMu_.Perp(), jetUncorrNoMu_.Eta(), jetUncorrNoMu_.Phi(), jetUncorrNoMu_.E(), area, Rho, nPV);
+	  jetCorrNoMu = jetUncorrNoMu_ * recorrMu;
+	  
+	  //// Jet corrections for level 1
+	  double recorr_L1 =  jec->correctionL1(jetUncorrNoMu_.Perp(), jetUncorrNoMu_.Eta(), jetUncorrNoMu_.Phi(), jetUncorrNoMu_.E(), area, Rho, nPV); /// deve essere raw
+	  jetL1Corr = jetUncorrNoMu_ * recorr_L1;
 	    
-	    double recorr_L1 =  jecCorr_L1->getCorrection();
-	    jetL1Corr = jetUncorrNoMu_ * recorr_L1;
-	      
-	    ptnomu = jetCorrNoMu.Pt();
-	    if(pt>15.0 && ( chEmEnFrac + neuEmEnFrac <0.9)){ 
-	      T1Corr += jetCorrNoMu - jetL1Corr;
-	      ptCorr_mL1 = T1Corr.Pt();
-	    }
+	  ptnomu = jetCorrNoMu.Pt();
+	  if(pt>15.0 && ( chEmEnFrac + neuEmEnFrac <0.9)){ 
+	    T1Corr += jetCorrNoMu - jetL1Corr;
+	    ptCorr_mL1 = T1Corr.Pt();
 	  }
 	}
 	
-	smearfact = smear(pt, genpt, eta, syst);
+	smearfact = smear(jerAK4, j, pt, eta, phi, genpt, geneta, genphi, syst);
 	
 	ptCorr = pt * smearfact;
 	energyCorr = energy * smearfact;
 	
-	float unc = jetUncertainty(ptCorr,eta,syst);
-	float unc_nosmear = jetUncertainty(pt,eta,syst);
+	float unc = jec ? jec->uncertainty(ptCorr,eta,syst) : 0.;
+	float unc_nosmear = jec ? jec->uncertainty(pt,eta,syst) : 0.;
 	
 	ptCorr = ptCorr * (1 + unc);
 	ptCorrSmearZero = pt * (1 + unc);//For full correction, including new JECs and MET
@@ -1985,21 +1943,12 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       
       vfloats_values[jets_label+"_PassesID"][j]=(float)passesID;
       
-      //Remove overlap with tight electrons/muons
-      double minDR=9999;
+      //Remove overlap with tight electrons/muons (the muon threshold applies to the closest lepton of either flavour)
       double minDRThrEl=0.3;
       double minDRThrMu=0.4;
-      bool passesDR=true;
- 
-      for (size_t e = 0; e < (size_t)electrons.size(); ++e){
-	minDR = min(minDR,deltaR(math::PtEtaPhiELorentzVector(electrons.at(e).Pt(),electrons.at(e).Eta(),electrons.at(e).Phi(),electrons.at(e).Energy() ) ,math::PtEtaPhiELorentzVector(ptCorr, eta, phi, energyCorr)));
-	if(minDR<minDRThrEl)passesDR = false;
-      }
-      for (size_t m = 0; m < (size_t)muons.size(); ++m){
-	minDR = min(minDR,deltaR(math::PtEtaPhiELorentzVector(muons.at(m).Pt(),muons.at(m).Eta(),muons.at(m).Phi(),muons.at(m).Energy() ) ,math::PtEtaPhiELorentzVector(ptCorr, eta, phi, energyCorr)));
-	//minDR = min(minDR,deltaR(muons.at(m) ,math::PtEtaPhiELorentzVector(ptCorr, eta, phi, energyCorr)));
-	if(minDR<minDRThrMu)passesDR = false;
-      }
+      double minDREl = sqrt(tightElectronIndex.minDR2(eta, phi, 9999.*9999.));
+      double minDR = min(minDREl, sqrt(tightMuonIndex.minDR2(eta, phi, 9999.*9999.)));
+      bool passesDR = minDREl >= minDRThrEl && (muons.empty() || minDR >= minDRThrMu);
       
       vfloats_values[jets_label+"_MinDR"][j]=minDR;
       vfloats_values[jets_label+"_PassesDR"][j]=(float)passesDR;
@@ -2044,50 +1993,12 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	}
 
 	if(passesCut &&  passesID && passesDR){
-	  double csvteff = MCTagEfficiency("csvt",flavor, ptCorr, eta);
-	  double sfcsvt = TagScaleFactor("csvt", flavor, "noSyst", ptCorr);
-	  
-	  double csvleff = MCTagEfficiency("csvl",flavor,ptCorr, eta);
-	  double sfcsvl = TagScaleFactor("csvl", flavor, "noSyst", ptCorr);
-
-	  double csvmeff = MCTagEfficiency("csvm",flavor,ptCorr, eta);
-	  double sfcsvm = TagScaleFactor("csvm", flavor, "noSyst", ptCorr);
-
-	  double sfcsvt_mistag_up = TagScaleFactor("csvt", flavor, "mistag_up", ptCorr);
-	  double sfcsvl_mistag_up = TagScaleFactor("csvl", flavor, "mistag_up", ptCorr);
-	  double sfcsvm_mistag_up = TagScaleFactor("csvm", flavor, "mistag_up", ptCorr);
-
-	  double sfcsvt_mistag_down = TagScaleFactor("csvt", flavor, "mistag_down", ptCorr);
-	  double sfcsvl_mistag_down = TagScaleFactor("csvl", flavor, "mistag_down", ptCorr);
-	  double sfcsvm_mistag_down = TagScaleFactor("csvm", flavor, "mistag_down", ptCorr);
-
-	  double sfcsvt_b_tag_down = TagScaleFactor("csvt", flavor, "b_tag_down", ptCorr);
-	  double sfcsvl_b_tag_down = TagScaleFactor("csvl", flavor, "b_tag_down", ptCorr);
-	  double sfcsvm_b_tag_down = TagScaleFactor("csvm", flavor, "b_tag_down", ptCorr);
-	  
-	  double sfcsvt_b_tag_up = TagScaleFactor("csvt", flavor, "b_tag_up", ptCorr);
-	  double sfcsvl_b_tag_up = TagScaleFactor("csvl", flavor, "b_tag_up", ptCorr);
-	  double sfcsvm_b_tag_up = TagScaleFactor("csvm", flavor, "b_tag_up", ptCorr);
-
-	  jsfscsvt.push_back(BTagWeight::JetInfo(csvteff, sfcsvt));
-	  jsfscsvl.push_back(BTagWeight::JetInfo(csvleff, sfcsvl));
-	  jsfscsvm.push_back(BTagWeight::JetInfo(csvmeff, sfcsvm));
-
-	  jsfscsvt_mistag_up.push_back(BTagWeight::JetInfo(csvteff, sfcsvt_mistag_up));
-	  jsfscsvl_mistag_up.push_back(BTagWeight::JetInfo(csvleff, sfcsvl_mistag_up));
-	  jsfscsvm_mistag_up.push_back(BTagWeight::JetInfo(csvmeff, sfcsvm_mistag_up));
-
-	  jsfscsvt_b_tag_up.push_back(BTagWeight::JetInfo(csvteff, sfcsvt_b_tag_up));
-	  jsfscsvl_b_tag_up.push_back(BTagWeight::JetInfo(csvleff, sfcsvl_b_tag_up));
-	  jsfscsvm_b_tag_up.push_back(BTagWeight::JetInfo(csvmeff, sfcsvm_b_tag_up));
-
-	  jsfscsvt_mistag_down.push_back(BTagWeight::JetInfo(csvteff, sfcsvt_mistag_down));
-	  jsfscsvl_mistag_down.push_back(BTagWeight::JetInfo(csvleff, sfcsvl_mistag_down));
-	  jsfscsvm_mistag_down.push_back(BTagWeight::JetInfo(csvmeff, sfcsvm_mistag_down));
-
-	  jsfscsvt_b_tag_down.push_back(BTagWeight::JetInfo(csvteff, sfcsvt_b_tag_down));
-	  jsfscsvl_b_tag_down.push_back(BTagWeight::JetInfo(csvleff, sfcsvl_b_tag_down));
-	  jsfscsvm_b_tag_down.push_back(BTagWeight::JetInfo(csvmeff, sfcsvm_b_tag_down));
+	  double effs[BTagWeight::nWPs], sfs[BTagWeight::nWPs][BTagWeight::nVariations];
+	  for(int wp = 0; wp < BTagWeight::nWPs; ++wp){
+	    effs[wp] = bTagEffMapsAK4[wp] ? bTagEffMapsAK4[wp]->efficiency(flavor, ptCorr, eta) : 0.;
+	    bTagSFsAK4->eval(wp, flavor, ptCorr, eta, sfs[wp]);
+	  }
+	  bJetsAK4.push_back(effs, sfs);
 
 	}
 	
@@ -2258,17 +2169,52 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       float phi_lmet = fabs(deltaPhi(lepton.Phi(), metphiCorr) );
       float mt = sqrt(2* lepton.Pt() * metptCorr * ( 1- cos(phi_lmet)));
       float_values["Event_mt"] = (float)mt;
-      Mt2Com_bisect *Mt2cal = new Mt2Com_bisect();
-      double Mt2w = Mt2cal->calculateMT2w(jetsnob,bjets,lepton, met,"MT2w");
-      float_values["Event_Mt2w"] = (float)Mt2w;    
-    }
-
-    for(int s = 0;s < min(max_instances[boosted_tops_subjets_label],sizes[boosted_tops_subjets_label]) ;++s){
+      double Mt2[Mt2Com_bisect::nMt2Types];
+      mt2Com.calculateMT2(jetsnob,bjets,lepton, met,Mt2);
+      float_values["Event_Mt2w"] = (float)Mt2[Mt2Com_bisect::MT2w];    
+      float_values["Event_Mt2bl"] = (float)Mt2[Mt2Com_bisect::MT2bl];
+      float_values["Event_Mt2b"] = (float)Mt2[Mt2Com_bisect::MT2b];
+    }
+
+    //Subjet to fat jet association from the vSubjetIndex0/1 of the AK8 jets in one pass; subjets not listed
+    //by any jet fall back to the nearest fat jet within the AK8 radius
+    int nSubjets = min(max_instances[boosted_tops_subjets_label],sizes[boosted_tops_subjets_label]);
+    int nFatJets = min(max_instances[boosted_tops_label],sizes[boosted_tops_label]);
+    subj_jet_map.assign(max(nSubjets,0),-1);
+    {
+      string preft = obj_to_pref[boosted_tops_label], prefs = obj_to_pref[boosted_tops_subjets_label];
+      const float * ptt = vfloats_values[makeName(boosted_tops_label,preft,"Pt")];
+      const float * etat = vfloats_values[makeName(boosted_tops_label,preft,"Eta")];
+      const float * phit = vfloats_values[makeName(boosted_tops_label,preft,"Phi")];
+      const float * index0 = vfloats_values[makeName(boosted_tops_label,preft,"vSubjetIndex0")];
+      const float * index1 = vfloats_values[makeName(boosted_tops_label,preft,"vSubjetIndex1")];
+      const float * etas = vfloats_values[makeName(boosted_tops_subjets_label,prefs,"Eta")];
+      const float * phis = vfloats_values[makeName(boosted_tops_subjets_label,prefs,"Phi")];
+      for(int t = 0;t < nFatJets ;++t){
+	if(ptt[t]<0.0)continue;
+	int i0 = int(index0[t]), i1 = int(index1[t]);
+	if(i0 >= 0 && i0 < nSubjets && subj_jet_map[i0] < 0) subj_jet_map[i0] = t;
+	if(i1 >= 0 && i1 < nSubjets && subj_jet_map[i1] < 0) subj_jet_map[i1] = t;
+      }
+      vector<int> validFatJets;
+      fatJetIndex.clear();
+      for(int t = 0;t < nFatJets ;++t){
+	if(ptt[t]<0.0)continue;
+	validFatJets.push_back(t);
+	fatJetIndex.add(etat[t], phit[t]);
+      }
+      fatJetIndex.build();
+      for(int s = 0;s < nSubjets ;++s){
+	if(subj_jet_map[s] >= 0)continue;
+	int nearest = fatJetIndex.nearest(etas[s], phis[s], 0.8);
+	if(nearest >= 0) subj_jet_map[s] = validFatJets[nearest];
+      }
+    }
+
+    for(int s = 0;s < nSubjets ;++s){
       string pref = obj_to_pref[boosted_tops_subjets_label];
       float pt  = vfloats_values[makeName(boosted_tops_subjets_label,pref,"Pt")][s];
       float eta = vfloats_values[makeName(boosted_tops_subjets_label,pref,"Eta")][s];
-      float phi = vfloats_values[makeName(boosted_tops_subjets_label,pref,"Phi")][s];
-      float e   = vfloats_values[makeName(boosted_tops_subjets_label,pref,"E")][s];
 
       float partonFlavourSubjet = vfloats_values[makeName(boosted_tops_subjets_label,pref,"PartonFlavour")][s];
       int flavorSubjet = int(partonFlavourSubjet);
@@ -2281,9 +2227,6 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       vfloats_values[boosted_tops_subjets_label+"_BSFUp"][s]=bsfupsubj;
       vfloats_values[boosted_tops_subjets_label+"_BSFDown"][s]=bsfdownsubj;
       
-      TLorentzVector subjet;
-      subjet.SetPtEtaPhiE(pt, eta, phi, e);       
-      double minDR=999;
       float subjcsv = vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][s];
      
       bool isCSVM = (subjcsv>0.8484);
@@ -2298,60 +2241,26 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	ncsvm_subj_tags +=1;
       }
       
-      double csvleff_subj = MCTagEfficiencySubjet("csvl",flavorSubjet,pt, eta);
-      double sfcsvl_subj = TagScaleFactorSubjet("csvl", flavorSubjet, "noSyst", pt);
-      
-      double csvmeff_subj = MCTagEfficiencySubjet("csvm",flavorSubjet,pt, eta);
-      double sfcsvm_subj = TagScaleFactorSubjet("csvm", flavorSubjet, "noSyst", pt);
-
-      double sfcsvl_mistag_up_subj = TagScaleFactorSubjet("csvl", flavorSubjet, "mistag_up", pt);
-      double sfcsvm_mistag_up_subj = TagScaleFactorSubjet("csvm", flavorSubjet, "mistag_up", pt);
-
-      double sfcsvl_mistag_down_subj = TagScaleFactorSubjet("csvl", flavorSubjet, "mistag_down", pt);
-      double sfcsvm_mistag_down_subj = TagScaleFactorSubjet("csvm", flavorSubjet, "mistag_down", pt);
-
-      double sfcsvl_b_tag_down_subj = TagScaleFactorSubjet("csvl", flavorSubjet, "b_tag_down", pt);
-      double sfcsvm_b_tag_down_subj = TagScaleFactorSubjet("csvm", flavorSubjet, "b_tag_down", pt);
-      
-      double sfcsvl_b_tag_up_subj = TagScaleFactorSubjet("csvl", flavorSubjet, "b_tag_up", pt);
-      double sfcsvm_b_tag_up_subj = TagScaleFactorSubjet("csvm", flavorSubjet, "b_tag_up", pt);     
-
-      jsfscsvl_subj.push_back(BTagWeight::JetInfo(csvleff_subj, sfcsvl_subj));
-      jsfscsvm_subj.push_back(BTagWeight::JetInfo(csvmeff_subj, sfcsvm_subj));
-      jsfscsvl_subj_mistag_up.push_back(BTagWeight::JetInfo(csvleff_subj, sfcsvl_mistag_up_subj));
-      jsfscsvm_subj_mistag_up.push_back(BTagWeight::JetInfo(csvmeff_subj, sfcsvm_mistag_up_subj));
-      
-      jsfscsvl_subj_b_tag_up.push_back(BTagWeight::JetInfo(csvleff_subj, sfcsvl_b_tag_up_subj));
-      jsfscsvm_subj_b_tag_up.push_back(BTagWeight::JetInfo(csvmeff_subj, sfcsvm_b_tag_up_subj));
-      
-      jsfscsvl_subj_mistag_down.push_back(BTagWeight::JetInfo(csvleff_subj, sfcsvl_mistag_down_subj));
-      jsfscsvm_subj_mistag_down.push_back(BTagWeight::JetInfo(csvmeff_subj, sfcsvm_mistag_down_subj));
-      
-      jsfscsvl_subj_b_tag_down.push_back(BTagWeight::JetInfo(csvleff_subj, sfcsvl_b_tag_down_subj));
-      jsfscsvm_subj_b_tag_down.push_back(BTagWeight::JetInfo(csvmeff_subj, sfcsvm_b_tag_down_subj));
+      //No CSVT map nor SFs for the subjets: efficiency 0 and SF 1, the subjets never pass T
+      double effsSubj[BTagWeight::nWPs], sfsSubj[BTagWeight::nWPs][BTagWeight::nVariations];
+      for(int wp = 0; wp < BTagWeight::nWPs; ++wp){
+	effsSubj[wp] = bTagEffMapsSubj[wp] ? bTagEffMapsSubj[wp]->efficiency(flavorSubjet, pt, eta) : 0.;
+	bTagSFsSubj->eval(wp, flavorSubjet, pt, eta, sfsSubj[wp]);
+      }
+      bJetsSubj.push_back(effsSubj, sfsSubj);
            
       
-      for(int t = 0;t < min(max_instances[boosted_tops_label],sizes[boosted_tops_label]) ;++t){
-	  
-	  float ptj = vfloats_values[makeName(boosted_tops_label,pref,"Pt")][t];
-	  if (ptj<0.0)continue;
-	  float etaj = vfloats_values[makeName(boosted_tops_label,pref,"Eta")][t];
-	  float phij = vfloats_values[makeName(boosted_tops_label,pref,"Phi")][t];
-	  float ej = vfloats_values[makeName(boosted_tops_label,pref,"E")][t];
-	  TLorentzVector topjet;
-	  topjet.SetPtEtaPhiE(ptj, etaj, phij, ej);       
-	  
-	  float DR = subjet.DeltaR(topjet); 
-	    if(DR < minDR){
-	    minDR = DR;
-	    subj_jet_map[s]=t;
-	    }
-      }
-	size_t tm = subj_jet_map[s];
-	if(isCSVM)vfloats_values[boosted_tops_label+"_nCSVM"][tm]+=1;
-	vfloats_values[boosted_tops_label+"_nJ"][tm]+=1;
+      int tm = subj_jet_map[s];
+      if(tm < 0)continue;
+      if(isCSVM)vfloats_values[boosted_tops_label+"_nCSVM"][tm]+=1;
+      vfloats_values[boosted_tops_label+"_nJ"][tm]+=1;
     }
     
+    ak4JetIndex.clear();
+    for(int i = 0; i < sizes[jets_label]; ++i) ak4JetIndex.add(vfloats_values[jets_label+"_CorrEta"][i], vfloats_values[jets_label+"_CorrPhi"][i]);
+    ak4JetIndex.build();
+
+    JetCorrectionChain * jec8 = 0;
     for(int t = 0;t < max_instances[boosted_tops_label] ;++t){
       string pref = obj_to_pref[boosted_tops_label];
       float prunedMass   = vfloats_values[makeName(boosted_tops_label,pref,"prunedMassCHS")][t];
@@ -2366,6 +2275,8 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       float tau3         = vfloats_values[makeName(boosted_tops_label,pref,"tau3")][t];
 
       float genpt8 = vfloats_values[makeName(boosted_tops_label,pref,"GenJetPt")][t];
+      float geneta8 = vfloats_values[makeName(boosted_tops_label,pref,"GenJetEta")][t];
+      float genphi8 = vfloats_values[makeName(boosted_tops_label,pref,"GenJetPhi")][t];
 
       float jecscale8 =  vfloats_values[makeName(boosted_tops_label,pref,"jecFactor0")][t];
       float area8 =  vfloats_values[makeName(boosted_tops_label,pref,"jetArea")][t];
@@ -2395,17 +2306,11 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	juncpt8=jetUncorr8_.Perp();
 	junce8=jetUncorr8_.E();
 
+	if(!jec8) jec8 = getJetCorrections(boosted_tops_label);//no-L1 correction for the groomed masses is always needed
+
 	if(changeJECs){
 	  
-	  jecCorr8->setJetPhi(jetUncorr8_.Phi());
-	  jecCorr8->setJetEta(jetUncorr8_.Eta());
-	  jecCorr8->setJetE(jetUncorr8_.E());
-	  jecCorr8->setJetPt(jetUncorr8_.Perp());
-	  jecCorr8->setJetA(area8);
-	  jecCorr8->setRho(Rho);
-	  jecCorr8->setNPV(nPV);
-	  
-	  double recorr8 =  jecCorr8->getCorrection();
+	  double recorr8 =  jec8->correction(jetUncorr8_.Perp(), jetUncorr8_.Eta(), jetUncorr8_.Phi(), jetUncorr8_.E(), area8, Rho, nPV);
 	  jetCorr8 = jetUncorr8_ *recorr8;
 	  
 	  topPt = jetCorr8.Pt();
@@ -2415,15 +2320,7 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	}
   
 	//// Jet corrections without level 1
-	jecCorr_NoL18->setJetPhi(jetUncorr8_.Phi()); /// deve essere raw
-	jecCorr_NoL18->setJetEta(jetUncorr8_.Eta());
-	jecCorr_NoL18->setJetE(jetUncorr8_.E());
-	jecCorr_NoL18->setJetPt(jetUncorr8_.Perp());
-	jecCorr_NoL18->setJetA(area8);
-	jecCorr_NoL18->setRho(Rho);
-	jecCorr_NoL18->setNPV(nPV);
-	  
-	double recorr_NoL18 =  jecCorr_NoL18->getCorrection();
+	double recorr_NoL18 =  jec8->correctionNoL1(jetUncorr8_.Perp(), jetUncorr8_.Eta(), jetUncorr8_.Phi(), jetUncorr8_.E(), area8, Rho, nPV); /// deve essere raw
 	
 	//cout << "softdropmass " << softDropMass << endl;
         softDropMassCorr = recorr_NoL18 * softDropMass;
@@ -2435,11 +2332,12 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	prunedMass = recorr_NoL18 * prunedMass;
 	prunedMassCorr = prunedMass;
 
-	Masssmearfact8 = MassSmear(topPt, topEta, Rho, 0);
+	double sigma8 = jetResolution8(topPt, topEta, Rho);
+	Masssmearfact8 = MassSmear(sigma8, 0, t, s);
 	prunedMassCorr = prunedMass * Masssmearfact8;
 
-	Masssmearfact8_DOWN = MassSmear(topPt, topEta, Rho, -1);
-	Masssmearfact8_UP = MassSmear(topPt, topEta, Rho, +1);
+	Masssmearfact8_DOWN = MassSmear(sigma8, -1, t, s);
+	Masssmearfact8_UP = MassSmear(sigma8, +1, t, s);
 	prunedMassCorr_JMRUP = prunedMass * Masssmearfact8_UP;
 	prunedMassCorr_JMRDOWN = prunedMass * Masssmearfact8_DOWN;
 	//cout << " prunedmass after JMR: " << prunedMassCorr ;
@@ -2453,11 +2351,11 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 
 	//-------------------
 	
-	smearfact8 = smear(topPt, genpt8, topEta, syst); 
+	smearfact8 = smear(jerAK8, t, topPt, topEta, topPhi, genpt8, geneta8, genphi8, syst); 
 	
 	ptCorr8 = topPt * smearfact8;
 	energyCorr8 = topE * smearfact8;
-	float unc8 = jetUncertainty8(ptCorr8,topEta,syst);
+	float unc8 = jec8->uncertainty(ptCorr8,topEta,syst);
 
 	ptCorr8 = ptCorr8 * (1 + unc8);
 	energyCorr8 = energyCorr8 * (1 + unc8);
@@ -2489,18 +2387,16 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       int indexv0 = vfloats_values[makeName(boosted_tops_label,pref,"vSubjetIndex0")][t];
       int indexv1 = vfloats_values[makeName(boosted_tops_label,pref,"vSubjetIndex1")][t];
 
-      int nCSVsubj = 0;
-      if( vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv0] > 0.8484) ++nCSVsubj;
-      if( vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv1] > 0.8484) ++nCSVsubj;
-
-      int nCSVsubj_tm = 0;
-
-      if( vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv0] > 0.5426 && vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv0]<0.8484) ++nCSVsubj_tm;
-      if( vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv1] > 0.5426 && vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv1] < 0.8484) ++nCSVsubj_tm;
-
-      int nCSVsubj_t = 0;
-      if(vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv0]<0.5426) ++nCSVsubj_t;
-      if(vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")][indexv1]< 0.5426) ++nCSVsubj_t;
+      //CSV of the two subjets, a jet without a subjet index counts as having neither
+      const float * subjCSV = vfloats_values[makeName(boosted_tops_subjets_label,pref,"CSVv2")];
+      int nCSVsubj = 0, nCSVsubj_tm = 0;
+      int subjIndices[2] = {indexv0, indexv1};
+      for(int k = 0; k < 2; ++k){
+	if(subjIndices[k] < 0 || subjIndices[k] >= nSubjets)continue;
+	float csv = subjCSV[subjIndices[k]];
+	if(csv > 0.8484) ++nCSVsubj;
+	if(csv > 0.5426 && csv < 0.8484) ++nCSVsubj_tm;
+      }
       
       vfloats_values[makeName(boosted_tops_label,pref,"nCSVsubj")][t]=(float)nCSVsubj;
       vfloats_values[makeName(boosted_tops_label,pref,"nCSVsubj_tm")][t]=(float)nCSVsubj_tm;
@@ -2524,25 +2420,15 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 					     vfloats_values[makeName(boosted_tops_label,pref,"E")][t]);
 
 	float bestTopMass = 0.;
-	float dRmin = 2.6;
 	
-	for(int i = 0; i < sizes[jets_label]; ++i){
-	 
-	  math::PtEtaPhiELorentzVector p4ak4 = math::PtEtaPhiELorentzVector(vfloats_values[jets_label+"_CorrPt"][i], 
-									    vfloats_values[jets_label+"_CorrEta"][i], 
-									    vfloats_values[jets_label+"_CorrPhi"][i], 
-									    vfloats_values[jets_label+"_CorrE"][i] );
-	  double dR = ROOT::Math::VectorUtil::DeltaR(p4ak8,p4ak4);
-
-	  if (dR <= 0.8 or dR > 2.5) continue;
-
-	  math::PtEtaPhiELorentzVector p4top = (p4ak8+p4ak4);
-	  float topMass = p4top.mass();
-	  if ( dR < dRmin ) {
-	    dRmin = dR;
-	    bestTopMass = topMass;
-	    p4bestB= p4ak4;
-	  }
+	//closest AK4 jet with 0.8 < Delta R <= 2.5
+	int i = ak4JetIndex.nearest(p4ak8.eta(), p4ak8.phi(), 2.5, 0.8);
+	if(i >= 0){
+	  p4bestB = math::PtEtaPhiELorentzVector(vfloats_values[jets_label+"_CorrPt"][i], 
+						 vfloats_values[jets_label+"_CorrEta"][i], 
+						 vfloats_values[jets_label+"_CorrPhi"][i], 
+						 vfloats_values[jets_label+"_CorrE"][i] );
+	  bestTopMass = (p4ak8+p4bestB).mass();
 	}
 
 	if (bestTopMass > 250 or bestTopMass < 140) isW=false; 
@@ -2604,11 +2490,14 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 	//	if(jets.size()==2 && bjets.size()==1) cout << " check this one "<<endl;
 	TopUtilities topUtils;
 	size_t t = 0;
+	//One neutrino solution per lepton for all the b-jets
+	vector<vector<math::PtEtaPhiELorentzVector> > topsSemiLep(leptons.size());
+	for(size_t l =0; l<leptons.size();++l) topUtils.top4Momenta(leptons.at(l), bjets, metPx, metPy, topsSemiLep[l]);
 	//	cout << " size b "<< bjets.size()<< " size l  "<< leptons.size() << " size 0 "<< sizes[namelabel]<<endl ;
 	for(size_t b =0; b<bjets.size();++b){
 	  for(size_t l =0; l<leptons.size();++l){
 	    //	  double metPx= 1.0, metPy =1.0;
-	    math::PtEtaPhiELorentzVector topSemiLep = topUtils.top4Momentum(leptons.at(l), bjets.at(b),metPx , metPy);
+	    const math::PtEtaPhiELorentzVector & topSemiLep = topsSemiLep[l][b];
 	    if(t > (size_t)max_instances[namelabel])continue;
 	    vfloats_values[namelabel+"_Pt"][t]=topSemiLep.pt();
 	    vfloats_values[namelabel+"_Eta"][t]=topSemiLep.eta();
@@ -2661,131 +2550,120 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       
 	int maxJetLoop = min((int)(max_instances[jets_label]),max_leading_jets_for_top);
 	maxJetLoop = min(maxJetLoop,sizes[jets_label]);
-	string pref = obj_to_pref[jets_label];
-	size_t t = 0;
 
-	TLorentzVector jet1, jet2, jet3;
-	
-	
+	//Triplets of tight jets with exactly one CSVM (|eta|<2.4) jet
+	const float * corrPt = vfloats_values[jets_label+"_CorrPt"];
+	const float * corrEta = vfloats_values[jets_label+"_CorrEta"];
+	const float * corrPhi = vfloats_values[jets_label+"_CorrPhi"];
+	const float * corrE = vfloats_values[jets_label+"_CorrE"];
+	const float * isCSVM = vfloats_values[jets_label+"_IsCSVM"];
+	const float * isTight = vfloats_values[jets_label+"_IsTight"];
+	topTriplets.clear();
 	for(int i = 0; i < maxJetLoop ;++i){
-	  for(int j = i+1; j < maxJetLoop ;++j){
-	    for(int k = j+1; k < maxJetLoop ;++k){
-		      
-	      if(vfloats_values[jets_label+"_CorrPt"][i]> 0. && vfloats_values[jets_label+"_CorrPt"][j]> 0. && vfloats_values[jets_label+"_CorrPt"][k]> 0.){
-	      
-	     
-	      //
-	      // Kinematic fitter
-	      //
-		//	      KinematicFitter fitter;
-	      
-	      //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-	      // Stuff that goes into event loop
-	      //
-	      //*********************************
-	      //
-	      // Example tri-jet combination
-	      // The MVA training is done such that the "b-jet" is the jet in the triplet
-	      // that has the highest CSVv2+IVF value. I've called this one "jet3" in the example.
-	      //
-
-	      float  csv_i= (float)vfloats_values[jets_label+"_CSVv2"][i];
-	      float  csv_j= (float)vfloats_values[jets_label+"_CSVv2"][j];
-	      float  csv_k= (float)vfloats_values[jets_label+"_CSVv2"][k];
-	      
-	      vector<float> csv = {csv_i, csv_j, csv_k};
-	      vector<int> idx = {i, j, k};
-	   
-	      ++t;
-      
-	      size_t tt = 0;
-	      //	cout << " test 3 "<<endl;
-	      string pref = obj_to_pref[jets_label];
-	      
-	      bool isIBJet= (bool)vfloats_values[jets_label+"_IsCSVM"][i] && (fabs(vfloats_values[jets_label+"_CorrEta"][i]) < 2.4);
-	      bool isITight= (bool)vfloats_values[jets_label+"_IsTight"][i];
-	      
-	      bool isJBJet= (bool)vfloats_values[jets_label+"_IsCSVM"][j] && (fabs(vfloats_values[jets_label+"_CorrEta"][j]) < 2.4);
-	      bool isJTight=(bool)vfloats_values[jets_label+"_IsTight"][j];
-		
-		//for(int k = j+1; k < maxJetLoop ;++k){
-		int nBJets =0;
-	
-		bool isKBJet= (bool)vfloats_values[jets_label+"_IsCSVM"][k] && (fabs(vfloats_values[jets_label+"_CorrEta"][k]) < 2.4);
-		bool isKTight=(bool)vfloats_values[jets_label+"_IsTight"][k];
-		
-		if(isIBJet)nBJets++;
-		if(isJBJet)nBJets++;
-		if(isKBJet)nBJets++;
-	
-		if(nBJets !=1  || !(isITight && isJTight && isKTight) ) continue;
-		math::PtEtaPhiELorentzVector p4i = math::PtEtaPhiELorentzVector(vfloats_values[jets_label+"_CorrPt"][i], vfloats_values[jets_label+"_CorrEta"][i], vfloats_values[jets_label+"_CorrPhi"][i], vfloats_values[jets_label+"_CorrE"][i] );
-		math::PtEtaPhiELorentzVector p4j = math::PtEtaPhiELorentzVector(vfloats_values[jets_label+"_CorrPt"][j], vfloats_values[jets_label+"_CorrEta"][j], vfloats_values[jets_label+"_CorrPhi"][j], vfloats_values[jets_label+"_CorrE"][j] );
-		math::PtEtaPhiELorentzVector p4k = math::PtEtaPhiELorentzVector(vfloats_values[jets_label+"_CorrPt"][k], vfloats_values[jets_label+"_CorrEta"][k], vfloats_values[jets_label+"_CorrPhi"][k], vfloats_values[jets_label+"_CorrE"][k] );
-		math::PtEtaPhiELorentzVector topHad = (p4i+p4j)+p4k;
-		vfloats_values[namelabel+"_Pt"][tt]=topHad.pt(); 
-		vfloats_values[namelabel+"_Eta"][tt]=topHad.eta();
-		vfloats_values[namelabel+"_Phi"][tt]=topHad.phi();
-		vfloats_values[namelabel+"_E"][tt]=topHad.e();
-		vfloats_values[namelabel+"_Mass"][tt]=topHad.mass();
-		if(isKBJet){
-		  vfloats_values[namelabel+"_IndexB"][tt]= k; vfloats_values[namelabel+"_IndexJ1"][tt]= i;  vfloats_values[namelabel+"_IndexJ2"][tt]= j; 
-		}
-		if(isJBJet){
-		  vfloats_values[namelabel+"_IndexB"][tt]= j; vfloats_values[namelabel+"_IndexJ1"][tt]= i;  vfloats_values[namelabel+"_IndexJ2"][tt]= k; }
-		if(isIBJet){
-		  //		cout << " isibjet"<<endl;
-		  vfloats_values[namelabel+"_IndexB"][tt]= i; vfloats_values[namelabel+"_IndexJ1"][tt]= j;  vfloats_values[namelabel+"_IndexJ2"][tt]= k; }
-
-		math::PtEtaPhiELorentzVector p4w, p4b ;
-		float massdrop_=0., deltaRjets=0.;
-		if(isIBJet){ p4w = p4j+p4k; p4b= p4i;
-		  massdrop_ = max( p4j.mass(),  p4k.mass() )/p4w.mass() ;
-		  deltaRjets = deltaR( p4j,  p4k);}
-		if(isJBJet){p4w = p4i+p4k; p4b= p4j;
-		  massdrop_ = max( p4i.mass(),  p4k.mass() )/p4w.mass() ;
-		  deltaRjets = deltaR( p4i,  p4k);}
-		if(isKBJet){p4w = p4j+p4i; p4b= p4k;
-		  massdrop_ = max( p4i.mass(),  p4j.mass() )/p4w.mass() ;
-		  deltaRjets = deltaR( p4i,  p4j);}
-		vfloats_values[namelabel+"_Pt"][tt]=topHad.pt(); 
-		vfloats_values[namelabel+"_Eta"][tt]=topHad.eta();
-		vfloats_values[namelabel+"_Phi"][tt]=topHad.phi();
-		vfloats_values[namelabel+"_E"][tt]=topHad.e();
-		vfloats_values[namelabel+"_Mass"][tt]=topHad.mass();
-		vfloats_values[namelabel+"_WMass"][tt]=p4w.mass();
-		vfloats_values[namelabel+"_massDrop"][tt]=massdrop_*deltaRjets;
-		//cout<<"Mass drop: "<<massdrop_*deltaRjets<<endl;
-		
-		if(topHad.mass()<0. || p4w.mass()<0){
-		  float genpti = vfloats_values[jets_label+"_GenJetPt"][i];
-		  float genptj = vfloats_values[jets_label+"_GenJetPt"][j];
-		  float genptk = vfloats_values[jets_label+"_GenJetPt"][k];
-		  
-		  float pti = vfloats_values[jets_label+"_Pt"][i];
-		  float ptj = vfloats_values[jets_label+"_Pt"][j];
-		  float ptk = vfloats_values[jets_label+"_Pt"][k];
-		  
-		  std::cout<<"Top Mass: "<<topHad.mass()<<std::endl;
-		  std::cout<<"W Mass: "<<p4w.mass()<<std::endl;
-		  std::cout<<"Pt1: "<<p4i.pt()<<" gen "<< genpti<<" pt0 "<<pti <<" eta "<< p4i.eta()<< " phi "<< p4i.phi()<< " e "<< p4i.e()<<std::endl;
-		  std::cout<<"Pt2: "<<p4j.pt()<< " gen "<< genptj<< " pt0 "<<ptj <<" eta "<< p4j.eta()<< " phi "<< p4j.phi()<< " e "<< p4j.e()<<std::endl;
-		  std::cout<<"Pt3> "<<p4k.pt()<< " gen "<< genptk<<" pt0 "<<ptk<< " eta "<< p4k.eta()<< " phi "<< p4k.phi()<< " e "<< p4k.e()<<std::endl;
-		}
-		if(t > (size_t)max_instances[namelabel])continue;
-		vfloats_values[namelabel+"_WMPhi"][tt]=deltaPhi(p4w.Phi(), metphiCorr);
-		vfloats_values[namelabel+"_TMPhi"][tt]= deltaPhi(topHad.Phi(), metphiCorr);
-		vfloats_values[namelabel+"_BMPhi"][tt]= deltaPhi(p4b.Phi(), metphiCorr);
-		vfloats_values[namelabel+"_WBPhi"][tt]= deltaPhi(p4w.Phi(), p4b.Phi());
-
-		++tt;
-		++sizes[namelabel];
-		
-		//  } //end of if statement on the number of bjets
-	      }//end if statement on jets
-	    }// end 3rd loop on jets
-	  }// end 2st loop on jets
-	}// end 1st loop on jets
+	  if(!(corrPt[i] > 0.) || !(bool)isTight[i])continue;
+	  topTriplets.addJet(i, corrPt[i], corrEta[i], corrPhi[i], corrE[i], (bool)isCSVM[i] && fabs(corrEta[i]) < 2.4);
+	}
+	topTriplets.build(topCandidates);
+
+	//All the candidates scored in one call, the MVA ranking keeps the best ones afterwards
+	if(topMVA && !topCandidates.empty()){
+	  size_t nVar = topMVA->nVariables(), nCand = topCandidates.size();
+	  const float * jetCSV = vfloats_values[jets_label+"_CSVv2"];
+	  topMVARows.resize(nCand*nVar);
+	  topMVAScores.resize(nCand);
+	  for(size_t c = 0; c < nCand; ++c) fillResolvedTopMVAInputs(topCandidates[c], corrPt, jetCSV, &topMVARows[c*nVar]);
+	  topMVA->evaluate(&topMVARows[0], nCand, &topMVAScores[0]);
+	  for(size_t c = 0; c < nCand; ++c){
+	    topCandidates[c].mva = topMVAScores[c];
+	    topCandidates[c].rank = -topMVAScores[c];
+	  }
+	  if(topMVAReader && topMVAChecked < topMVACheckEvents){
+	    for(size_t c = 0; c < nCand; ++c){
+	      std::copy(&topMVARows[c*nVar], &topMVARows[c*nVar]+nVar, topMVAReaderInputs.begin());
+	      topMVAMaxDifference = max(topMVAMaxDifference, fabs(topMVAReader->EvaluateMVA("BDT") - topMVAScores[c]));
+	    }
+	    topMVACheckedCandidates += nCand;
+	    if(++topMVAChecked == topMVACheckEvents) cout << "DMAnalysisTreeMaker: resolvedTopHad BDT vs TMVA::Reader on " << topMVACheckedCandidates << " candidates, max difference " << topMVAMaxDifference << endl;
+	  }
+	  if(topTriplets.ranking()==ResolvedTopTriplets::byMVA) topTriplets.selectBest(topCandidates);
+	}
+
+	topJetP4s.resize(maxJetLoop);
+	for(int i = 0; i < maxJetLoop ;++i) topJetP4s[i].SetPtEtaPhiE(corrPt[i], corrEta[i], corrPhi[i], corrE[i]);
+
+	//Kinematic fit of the kept candidates in one pass, relative pt resolutions from the AK4 JER tables
+	if(doTopKinFit && !topCandidates.empty()){
+	  JME::JetResolution * res = getResolution(jets_label);
+	  vector<double> sigmas(maxJetLoop, -1.);
+	  topKinFit.clear();
+	  for(size_t c = 0; c < topCandidates.size(); ++c){
+	    int jidx[3] = {topCandidates[c].j1, topCandidates[c].j2, topCandidates[c].b};
+	    double p4[3][4];
+	    for(int n = 0; n < 3; ++n){
+	      const TLorentzVector & j = topJetP4s[jidx[n]];
+	      p4[n][0] = j.Px(); p4[n][1] = j.Py(); p4[n][2] = j.Pz(); p4[n][3] = j.E();
+	      if(sigmas[jidx[n]] < 0.){
+		JME::JetParameters parameters;
+		parameters.setJetPt(j.Pt());
+		parameters.setJetEta(j.Eta());
+		parameters.setRho(Rho);
+		sigmas[jidx[n]] = res->getResolution(parameters);
+	      }
+	    }
+	    topKinFit.add(p4[0], sigmas[jidx[0]], p4[1], sigmas[jidx[1]], p4[2], sigmas[jidx[2]]);
+	  }
+	  topKinFit.fit(topKinFitResults);
+	}
+
+	for(size_t c = 0; c < topCandidates.size() && c < (size_t)max_instances[namelabel]; ++c){
+	  const ResolvedTopTriplets::Candidate & cand = topCandidates[c];
+	  vfloats_values[namelabel+"_Pt"][c]=cand.pt;
+	  vfloats_values[namelabel+"_Eta"][c]=cand.eta;
+	  vfloats_values[namelabel+"_Phi"][c]=cand.phi;
+	  vfloats_values[namelabel+"_E"][c]=cand.e;
+	  vfloats_values[namelabel+"_Mass"][c]=cand.mass;
+	  vfloats_values[namelabel+"_IndexB"][c]=cand.b;
+	  vfloats_values[namelabel+"_IndexJ1"][c]=cand.j1;
+	  vfloats_values[namelabel+"_IndexJ2"][c]=cand.j2;
+	  vfloats_values[namelabel+"_WMass"][c]=cand.wMass;
+	  vfloats_values[namelabel+"_massDrop"][c]=cand.massDrop;
+	  vfloats_values[namelabel+"_MassChi2"][c]=cand.massChi2;
+	  if(topMVA) vfloats_values[namelabel+"_MVA"][c]=cand.mva;
+	  vfloats_values[namelabel+"_DPhiJet1b"][c]=cand.dPhiJet1b;
+	  vfloats_values[namelabel+"_DPhiJet2b"][c]=cand.dPhiJet2b;
+	  vfloats_values[namelabel+"_DRJet1b"][c]=cand.dRJet1b;
+	  vfloats_values[namelabel+"_DRJet2b"][c]=cand.dRJet2b;
+	  vfloats_values[namelabel+"_WMPhi"][c]=deltaPhi(cand.wPhi, metphiCorr);
+	  vfloats_values[namelabel+"_TMPhi"][c]=deltaPhi(cand.phi, metphiCorr);
+	  vfloats_values[namelabel+"_BMPhi"][c]=deltaPhi(cand.bPhi, metphiCorr);
+	  vfloats_values[namelabel+"_WBPhi"][c]=deltaPhi(cand.wPhi, cand.bPhi);
+	  if(doTopKinFit){
+	    const TopKinematicFit::Result & fit = topKinFitResults[c];
+	    TLorentzVector wFit = fit.scale[0]*topJetP4s[cand.j1] + fit.scale[1]*topJetP4s[cand.j2];
+	    TLorentzVector topFit = wFit + fit.scale[2]*topJetP4s[cand.b];
+	    vfloats_values[namelabel+"_WMassPreFit"][c]=cand.wMass;
+	    vfloats_values[namelabel+"_MassPreFit"][c]=cand.mass;
+	    vfloats_values[namelabel+"_PtPreFit"][c]=cand.pt;
+	    vfloats_values[namelabel+"_EtaPreFit"][c]=cand.eta;
+	    vfloats_values[namelabel+"_PhiPreFit"][c]=cand.phi;
+	    vfloats_values[namelabel+"_BMPhiPreFit"][c]=vfloats_values[namelabel+"_BMPhi"][c];
+	    vfloats_values[namelabel+"_WMPhiPreFit"][c]=vfloats_values[namelabel+"_WMPhi"][c];
+	    vfloats_values[namelabel+"_TMPhiPreFit"][c]=vfloats_values[namelabel+"_TMPhi"][c];
+	    vfloats_values[namelabel+"_WBPhiPreFit"][c]=vfloats_values[namelabel+"_WBPhi"][c];
+	    vfloats_values[namelabel+"_WMassPostFit"][c]=wFit.M();
+	    vfloats_values[namelabel+"_MassPostFit"][c]=topFit.M();
+	    vfloats_values[namelabel+"_PtPostFit"][c]=topFit.Pt();
+	    vfloats_values[namelabel+"_EtaPostFit"][c]=topFit.Eta();
+	    vfloats_values[namelabel+"_PhiPostFit"][c]=topFit.Phi();
+	    vfloats_values[namelabel+"_BMPhiPostFit"][c]=deltaPhi(cand.bPhi, metphiCorr);
+	    vfloats_values[namelabel+"_WMPhiPostFit"][c]=deltaPhi(wFit.Phi(), metphiCorr);
+	    vfloats_values[namelabel+"_TMPhiPostFit"][c]=deltaPhi(topFit.Phi(), metphiCorr);
+	    vfloats_values[namelabel+"_WBPhiPostFit"][c]=deltaPhi(wFit.Phi(), cand.bPhi);
+	    vfloats_values[namelabel+"_FitChi2"][c]=fit.chi2;
+	    vfloats_values[namelabel+"_FitProb"][c]=fit.prob;
+	  }
+	  ++sizes[namelabel];
+	}
 	
       }// end if statement (at least 3 jets)
       // =============================================================================
@@ -2797,10 +2675,10 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
       
       //      if(getwobjets)cout << " nresolvedtophad "<< sizes["resolvedTopHad"]<<endl;
       //      cout << " namelabel? "<< namelabel<< endl;
-      if(sizes[namelabel]==0){
+      //Unused slots are reset, the candidates of the previous event would otherwise stay there
+      if(sizes[namelabel]<(int)max_instances[namelabel]){
 	vector<string> extravars = additionalVariables(namelabel);
-	for(size_t t =0;t<(size_t)max_instances[namelabel];++t){
-	  //	  if(t> 45)continue;
+	for(size_t t =sizes[namelabel];t<(size_t)max_instances[namelabel];++t){
 	  for(size_t addv = 0; addv < extravars.size();++addv){
 	    //	    cout << "resetting variable "<< extravars.at(addv)<< " name "<< namelabel+"_"+extravars.at(addv)<<" t is "<< t << endl;
 	    vfloats_values[namelabel+"_"+extravars.at(addv)][t]=-9999;
@@ -2811,227 +2689,13 @@ void DMAnalysisTreeMaker::analyze(const edm::Event& iEvent, const edm::EventSetu
 
     //BTagging part
     if(doBTagSF){
-    //CSVT
-      //0 tags
-      b_weight_csvt_0_tags = b_csvt_0_tags.weight(jsfscsvt, ncsvt_tags);  
-      b_weight_csvt_0_tags_mistag_up = b_csvt_0_tags.weight(jsfscsvt_mistag_up, ncsvt_tags);  
-      b_weight_csvt_0_tags_mistag_down = b_csvt_0_tags.weight(jsfscsvt_mistag_down, ncsvt_tags);  
-      b_weight_csvt_0_tags_b_tag_up = b_csvt_0_tags.weight(jsfscsvt_b_tag_up, ncsvt_tags);  
-      b_weight_csvt_0_tags_b_tag_down = b_csvt_0_tags.weight(jsfscsvt_b_tag_down, ncsvt_tags);
-
-      //1
-      b_weight_csvt_1_tag = b_csvt_1_tag.weight(jsfscsvt, ncsvt_tags);  
-      b_weight_csvt_1_tag_mistag_up = b_csvt_1_tag.weight(jsfscsvt_mistag_up, ncsvt_tags);  
-      b_weight_csvt_1_tag_mistag_down = b_csvt_1_tag.weight(jsfscsvt_mistag_down, ncsvt_tags);  
-      b_weight_csvt_1_tag_b_tag_up = b_csvt_1_tag.weight(jsfscsvt_b_tag_up, ncsvt_tags);  
-      b_weight_csvt_1_tag_b_tag_down = b_csvt_1_tag.weight(jsfscsvt_b_tag_down, ncsvt_tags);
-
-    //CSVM
-      //0 tags
-      b_weight_csvm_0_tags = b_csvm_0_tags.weight(jsfscsvm, ncsvm_tags);  
-      b_weight_csvm_0_tags_mistag_up = b_csvm_0_tags.weight(jsfscsvm_mistag_up, ncsvm_tags);  
-      b_weight_csvm_0_tags_mistag_down = b_csvm_0_tags.weight(jsfscsvm_mistag_down, ncsvm_tags);  
-      b_weight_csvm_0_tags_b_tag_up = b_csvm_0_tags.weight(jsfscsvm_b_tag_up, ncsvm_tags);  
-      b_weight_csvm_0_tags_b_tag_down = b_csvm_0_tags.weight(jsfscsvm_b_tag_down, ncsvm_tags);  
-      
-      b_weight_subj_csvm_0_tags = b_subj_csvm_0_tags.weight(jsfscsvm_subj, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_tags_mistag_up = b_subj_csvm_0_tags.weight(jsfscsvm_subj_mistag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_tags_mistag_down = b_subj_csvm_0_tags.weight(jsfscsvm_subj_mistag_down, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_tags_b_tag_up = b_subj_csvm_0_tags.weight(jsfscsvm_subj_b_tag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_tags_b_tag_down = b_subj_csvm_0_tags.weight(jsfscsvm_subj_b_tag_down, ncsvm_subj_tags);
-   
-      //1 tag
-      b_weight_csvm_1_tag = b_csvm_1_tag.weight(jsfscsvm, ncsvm_tags);  
-      b_weight_csvm_1_tag_mistag_up = b_csvm_1_tag.weight(jsfscsvm_mistag_up, ncsvm_tags);  
-      b_weight_csvm_1_tag_mistag_down = b_csvm_1_tag.weight(jsfscsvm_mistag_down, ncsvm_tags);  
-      b_weight_csvm_1_tag_b_tag_up = b_csvm_1_tag.weight(jsfscsvm_b_tag_up, ncsvm_tags);  
-      b_weight_csvm_1_tag_b_tag_down = b_csvm_1_tag.weight(jsfscsvm_b_tag_down, ncsvm_tags);  
-
-      b_weight_subj_csvm_1_tag = b_subj_csvm_1_tag.weight(jsfscsvm_subj, ncsvm_subj_tags);  
-      b_weight_subj_csvm_1_tag_mistag_up = b_subj_csvm_1_tag.weight(jsfscsvm_subj_mistag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_1_tag_mistag_down = b_subj_csvm_1_tag.weight(jsfscsvm_subj_mistag_down, ncsvm_subj_tags);  
-      b_weight_subj_csvm_1_tag_b_tag_up = b_subj_csvm_1_tag.weight(jsfscsvm_subj_b_tag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_1_tag_b_tag_down = b_subj_csvm_1_tag.weight(jsfscsvm_subj_b_tag_down, ncsvm_subj_tags);
-      
-      //2 tags
-
-      b_weight_subj_csvm_2_tags = b_subj_csvm_2_tags.weight(jsfscsvm_subj, ncsvm_subj_tags);  
-      b_weight_subj_csvm_2_tags_mistag_up = b_subj_csvm_2_tags.weight(jsfscsvm_subj_mistag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_2_tags_mistag_down = b_subj_csvm_2_tags.weight(jsfscsvm_subj_mistag_down, ncsvm_subj_tags);  
-      b_weight_subj_csvm_2_tags_b_tag_up = b_subj_csvm_2_tags.weight(jsfscsvm_subj_b_tag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_2_tags_b_tag_down = b_subj_csvm_2_tags.weight(jsfscsvm_subj_b_tag_down, ncsvm_subj_tags);
-      
-      //0-1 tags  
-
-      b_weight_subj_csvm_0_1_tags = b_subj_csvm_0_1_tags.weight(jsfscsvm_subj, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_1_tags_mistag_up = b_subj_csvm_0_1_tags.weight(jsfscsvm_subj_mistag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_1_tags_mistag_down = b_subj_csvm_0_1_tags.weight(jsfscsvm_subj_mistag_down, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_1_tags_b_tag_up = b_subj_csvm_0_1_tags.weight(jsfscsvm_subj_b_tag_up, ncsvm_subj_tags);  
-      b_weight_subj_csvm_0_1_tags_b_tag_down = b_subj_csvm_0_1_tags.weight(jsfscsvm_subj_b_tag_down, ncsvm_subj_tags);
-      
-    //CSVL
-      //0 tags
-      b_weight_csvl_0_tags = b_csvl_0_tags.weight(jsfscsvl, ncsvl_tags);  
-      b_weight_csvl_0_tags_mistag_up = b_csvl_0_tags.weight(jsfscsvl_mistag_up, ncsvl_tags);  
-      b_weight_csvl_0_tags_mistag_down = b_csvl_0_tags.weight(jsfscsvl_mistag_down, ncsvl_tags);  
-      b_weight_csvl_0_tags_b_tag_up = b_csvl_0_tags.weight(jsfscsvl_b_tag_up, ncsvl_tags);  
-      b_weight_csvl_0_tags_b_tag_down = b_csvl_0_tags.weight(jsfscsvl_b_tag_down, ncsvl_tags);  
-
-      b_weight_subj_csvl_0_tags = b_subj_csvl_0_tags.weight(jsfscsvl_subj, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_tags_mistag_up = b_subj_csvl_0_tags.weight(jsfscsvl_subj_mistag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_tags_mistag_down = b_subj_csvl_0_tags.weight(jsfscsvl_subj_mistag_down, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_tags_b_tag_up = b_subj_csvl_0_tags.weight(jsfscsvl_subj_b_tag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_tags_b_tag_down = b_subj_csvl_0_tags.weight(jsfscsvl_subj_b_tag_down, ncsvl_subj_tags);
-      
-      //1 tag
-      b_weight_csvl_1_tag = b_csvl_1_tag.weight(jsfscsvl, ncsvl_tags);  
-      b_weight_csvl_1_tag_mistag_up = b_csvl_1_tag.weight(jsfscsvl_mistag_up, ncsvl_tags);  
-      b_weight_csvl_1_tag_mistag_down = b_csvl_1_tag.weight(jsfscsvl_mistag_down, ncsvl_tags);  
-      b_weight_csvl_1_tag_b_tag_up = b_csvl_1_tag.weight(jsfscsvl_b_tag_up, ncsvl_tags);  
-      b_weight_csvl_1_tag_b_tag_down = b_csvl_1_tag.weight(jsfscsvl_b_tag_down, ncsvl_tags);  
-
-      b_weight_subj_csvl_1_tag = b_subj_csvl_1_tag.weight(jsfscsvl_subj, ncsvl_subj_tags);  
-      b_weight_subj_csvl_1_tag_mistag_up = b_subj_csvl_1_tag.weight(jsfscsvl_subj_mistag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_1_tag_mistag_down = b_subj_csvl_1_tag.weight(jsfscsvl_subj_mistag_down, ncsvl_subj_tags);  
-      b_weight_subj_csvl_1_tag_b_tag_up = b_subj_csvl_1_tag.weight(jsfscsvl_subj_b_tag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_1_tag_b_tag_down = b_subj_csvl_1_tag.weight(jsfscsvl_subj_b_tag_down, ncsvl_subj_tags);
-
-      //2 tags  
-
-      b_weight_subj_csvl_2_tags = b_subj_csvl_2_tags.weight(jsfscsvl_subj, ncsvl_subj_tags);  
-      b_weight_subj_csvl_2_tags_mistag_up = b_subj_csvl_2_tags.weight(jsfscsvl_subj_mistag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_2_tags_mistag_down = b_subj_csvl_2_tags.weight(jsfscsvl_subj_mistag_down, ncsvl_subj_tags);  
-      b_weight_subj_csvl_2_tags_b_tag_up = b_subj_csvl_2_tags.weight(jsfscsvl_subj_b_tag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_2_tags_b_tag_down = b_subj_csvl_2_tags.weight(jsfscsvl_subj_b_tag_down, ncsvl_subj_tags);
-      
-      b_weight_csvl_2_tag = b_csvl_2_tag.weight(jsfscsvl, ncsvl_tags);
-      b_weight_csvl_2_tag_mistag_up = b_csvl_2_tag.weight(jsfscsvl_mistag_up, ncsvl_tags);
-      b_weight_csvl_2_tag_mistag_down = b_csvl_2_tag.weight(jsfscsvl_mistag_down, ncsvl_tags);
-      b_weight_csvl_2_tag_b_tag_up = b_csvl_2_tag.weight(jsfscsvl_b_tag_up, ncsvl_tags);
-      b_weight_csvl_2_tag_b_tag_down = b_csvl_2_tag.weight(jsfscsvl_b_tag_down, ncsvl_tags);
+      int ntags[BTagWeight::nWPs] = {ncsvl_tags, ncsvm_tags, ncsvt_tags};
+      bTagEngine.weights(bJetsAK4, bTagCategoriesAK4, ntags, bTagWeightsAK4);
+      for(size_t b = 0; b < bTagBranchesAK4.size(); ++b) float_values[bTagBranchesAK4[b]] = bTagWeightsAK4[b];
 
-      //0-1 tags
-      
-      b_weight_subj_csvl_0_1_tags = b_subj_csvl_0_1_tags.weight(jsfscsvl_subj, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_1_tags_mistag_up = b_subj_csvl_0_1_tags.weight(jsfscsvl_subj_mistag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_1_tags_mistag_down = b_subj_csvl_0_1_tags.weight(jsfscsvl_subj_mistag_down, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_1_tags_b_tag_up = b_subj_csvl_0_1_tags.weight(jsfscsvl_subj_b_tag_up, ncsvl_subj_tags);  
-      b_weight_subj_csvl_0_1_tags_b_tag_down = b_subj_csvl_0_1_tags.weight(jsfscsvl_subj_b_tag_down, ncsvl_subj_tags);
-      
-      float_values["Event_bWeight0CSVL_subj"]=b_weight_subj_csvl_0_tags;
-      float_values["Event_bWeight1CSVL_subj"]=b_weight_subj_csvl_1_tag;
-      float_values["Event_bWeight2CSVL_subj"]=b_weight_subj_csvl_2_tags;
-      float_values["Event_bWeight0_1CSVL_subj"]=b_weight_subj_csvl_0_1_tags;
-      
-      float_values["Event_bWeight0CSVM_subj"]=b_weight_subj_csvm_0_tags;
-      float_values["Event_bWeight1CSVM_subj"]=b_weight_subj_csvm_1_tag;
-      float_values["Event_bWeight2CSVM_subj"]=b_weight_subj_csvm_2_tags;
-      float_values["Event_bWeight0_1CSVM_subj"]=b_weight_subj_csvm_0_1_tags;
-
-      //Mistag
-      float_values["Event_bWeightMisTagUp0CSVL_subj"]=b_weight_subj_csvl_0_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp1CSVL_subj"]=b_weight_subj_csvl_1_tag_mistag_up;
-      float_values["Event_bWeightMisTagUp2CSVL_subj"]=b_weight_subj_csvl_2_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp0_1CSVL_subj"]=b_weight_subj_csvl_0_1_tags_mistag_up;
-      
-      float_values["Event_bWeightMisTagUp0CSVM_subj"]=b_weight_subj_csvm_0_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp1CSVM_subj"]=b_weight_subj_csvm_1_tag_mistag_up;
-      float_values["Event_bWeightMisTagUp2CSVM_subj"]=b_weight_subj_csvm_2_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp0_1CSVM_subj"]=b_weight_subj_csvm_0_1_tags_mistag_up;
-    
-      float_values["Event_bWeightMisTagDown0CSVL_subj"]=b_weight_subj_csvl_0_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown1CSVL_subj"]=b_weight_subj_csvl_1_tag_mistag_down;
-      float_values["Event_bWeightMisTagDown2CSVL_subj"]=b_weight_subj_csvl_2_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown0_1CSVL_subj"]=b_weight_subj_csvl_0_1_tags_mistag_down;
-      
-      float_values["Event_bWeightMisTagDown0CSVM_subj"]=b_weight_subj_csvm_0_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown1CSVM_subj"]=b_weight_subj_csvm_1_tag_mistag_down;
-      float_values["Event_bWeightMisTagDown2CSVM_subj"]=b_weight_subj_csvm_2_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown0_1CSVM_subj"]=b_weight_subj_csvm_0_1_tags_mistag_down;
-      
-      //Btag
-      float_values["Event_bWeightBTagUp0CSVL_subj"]=b_weight_subj_csvl_0_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp1CSVL_subj"]=b_weight_subj_csvl_1_tag_b_tag_up;
-      float_values["Event_bWeightBTagUp2CSVL_subj"]=b_weight_subj_csvl_2_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp0_1CSVL_subj"]=b_weight_subj_csvl_0_1_tags_b_tag_up;
-      
-      float_values["Event_bWeightBTagUp0CSVM_subj"]=b_weight_subj_csvm_0_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp1CSVM_subj"]=b_weight_subj_csvm_1_tag_b_tag_up;
-      float_values["Event_bWeightBTagUp2CSVM_subj"]=b_weight_subj_csvm_2_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp0_1CSVM_subj"]=b_weight_subj_csvm_0_1_tags_b_tag_up;
-
-      float_values["Event_bWeightBTagDown0CSVL_subj"]=b_weight_subj_csvl_0_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown1CSVL_subj"]=b_weight_subj_csvl_1_tag_b_tag_down;
-      float_values["Event_bWeightBTagDown2CSVL_subj"]=b_weight_subj_csvl_2_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown0_1CSVL_subj"]=b_weight_subj_csvl_0_1_tags_b_tag_down;
-      
-      float_values["Event_bWeightBTagDown0CSVM_subj"]=b_weight_subj_csvm_0_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown1CSVM_subj"]=b_weight_subj_csvm_1_tag_b_tag_down;
-      float_values["Event_bWeightBTagDown2CSVM_subj"]=b_weight_subj_csvm_2_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown0_1CSVM_subj"]=b_weight_subj_csvm_0_1_tags_b_tag_down;
-      
-      /////AK4
-      
-      float_values["Event_bWeight0CSVL"]=b_weight_csvl_0_tags;
-      float_values["Event_bWeight1CSVL"]=b_weight_csvl_1_tag;
-      float_values["Event_bWeight2CSVL"]=b_weight_csvl_2_tag;
-
-      float_values["Event_bWeight0CSVM"]=b_weight_csvm_0_tags;
-      float_values["Event_bWeight1CSVM"]=b_weight_csvm_1_tag;
-      float_values["Event_bWeight2CSVM"]=b_weight_csvm_2_tag;
-
-      float_values["Event_bWeight0CSVT"]=b_weight_csvt_0_tags;
-      float_values["Event_bWeight1CSVT"]=b_weight_csvt_1_tag;
-      float_values["Event_bWeight2CSVT"]=b_weight_csvt_2_tag;
-      //Mistag
-      float_values["Event_bWeightMisTagUp0CSVL"]=b_weight_csvl_0_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp1CSVL"]=b_weight_csvl_1_tag_mistag_up;
-      float_values["Event_bWeightMisTagUp2CSVL"]=b_weight_csvl_2_tag_mistag_up;
-
-      float_values["Event_bWeightMisTagUp0CSVM"]=b_weight_csvm_0_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp1CSVM"]=b_weight_csvm_1_tag_mistag_up;
-      float_values["Event_bWeightMisTagUp2CSVM"]=b_weight_csvm_2_tag_mistag_up;
-
-      float_values["Event_bWeightMisTagUp0CSVT"]=b_weight_csvt_0_tags_mistag_up;
-      float_values["Event_bWeightMisTagUp1CSVT"]=b_weight_csvt_1_tag_mistag_up;   
-      float_values["Event_bWeightMisTagUp2CSVT"]=b_weight_csvt_2_tag_mistag_up;
-
-      float_values["Event_bWeightMisTagDown0CSVL"]=b_weight_csvl_0_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown1CSVL"]=b_weight_csvl_1_tag_mistag_down;
-      float_values["Event_bWeightMisTagDown2CSVL"]=b_weight_csvl_2_tag_mistag_down;
-
-      float_values["Event_bWeightMisTagDown0CSVM"]=b_weight_csvm_0_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown1CSVM"]=b_weight_csvm_1_tag_mistag_down;
-      float_values["Event_bWeightMisTagDown2CSVM"]=b_weight_csvm_2_tag_mistag_down;
-
-      float_values["Event_bWeightMisTagDown0CSVT"]=b_weight_csvt_0_tags_mistag_down;
-      float_values["Event_bWeightMisTagDown1CSVT"]=b_weight_csvt_1_tag_mistag_down;
-      float_values["Event_bWeightMisTagDown2CSVT"]=b_weight_csvt_2_tag_mistag_down;
-
-      //Btag
-      float_values["Event_bWeightBTagUp0CSVL"]=b_weight_csvl_0_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp1CSVL"]=b_weight_csvl_1_tag_b_tag_up;
-      float_values["Event_bWeightBTagUp2CSVL"]=b_weight_csvl_2_tag_b_tag_up;
-
-      float_values["Event_bWeightBTagUp0CSVM"]=b_weight_csvm_0_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp1CSVM"]=b_weight_csvm_1_tag_b_tag_up;
-      float_values["Event_bWeightBTagUp2CSVM"]=b_weight_csvm_2_tag_b_tag_up;
-
-      float_values["Event_bWeightBTagUp0CSVT"]=b_weight_csvt_0_tags_b_tag_up;
-      float_values["Event_bWeightBTagUp1CSVT"]=b_weight_csvt_1_tag_b_tag_up;
-      float_values["Event_bWeightBTagUp2CSVT"]=b_weight_csvt_2_tag_b_tag_up;
-
-      float_values["Event_bWeightBTagDown0CSVL"]=b_weight_csvl_0_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown1CSVL"]=b_weight_csvl_1_tag_b_tag_down;
-      float_values["Event_bWeightBTagDown2CSVL"]=b_weight_csvl_2_tag_b_tag_down;
-
-      float_values["Event_bWeightBTagDown0CSVM"]=b_weight_csvm_0_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown1CSVM"]=b_weight_csvm_1_tag_b_tag_down;
-      float_values["Event_bWeightBTagDown2CSVM"]=b_weight_csvm_2_tag_b_tag_down;
-
-      float_values["Event_bWeightBTagDown0CSVT"]=b_weight_csvt_0_tags_b_tag_down;
-      float_values["Event_bWeightBTagDown1CSVT"]=b_weight_csvt_1_tag_b_tag_down;
-      float_values["Event_bWeightBTagDown2CSVT"]=b_weight_csvt_2_tag_b_tag_down;
+      int ntagsSubj[BTagWeight::nWPs] = {ncsvl_subj_tags, ncsvm_subj_tags, 0};
+      bTagEngine.weights(bJetsSubj, bTagCategoriesSubj, ntagsSubj, bTagWeightsSubj);
+      for(size_t b = 0; b < bTagBranchesSubj.size(); ++b) float_values[bTagBranchesSubj[b]] = bTagWeightsSubj[b];
     }
     
     
@@ -3259,9 +2923,9 @@ vector<string> DMAnalysisTreeMaker::additionalVariables(string object){
   }
 
   if(isResolvedTopHad ){
-    addvar.push_back("Pt");    addvar.push_back("Eta");    addvar.push_back("Phi");    addvar.push_back("E"); addvar.push_back("Mass");  addvar.push_back("massDrop");
+    addvar.push_back("Pt");    addvar.push_back("Eta");    addvar.push_back("Phi");    addvar.push_back("E"); addvar.push_back("Mass");  addvar.push_back("massDrop"); addvar.push_back("MassChi2");
     addvar.push_back("WMass"); addvar.push_back("BMPhi");  addvar.push_back("WMPhi");  addvar.push_back("TMPhi");  addvar.push_back("WBPhi");
-    addvar.push_back("IndexB");    addvar.push_back("IndexJ1");    addvar.push_back("IndexJ2");  addvar.push_back("IndexB_MVA");    addvar.push_back("IndexJ1_MVA");    addvar.push_back("IndexJ2_MVA");  addvar.push_back("MVA");  addvar.push_back("WMassPreFit"); addvar.push_back("MassPreFit"); addvar.push_back("PtPreFit"); addvar.push_back("EtaPreFit"); addvar.push_back("PhiPreFit"); addvar.push_back("BMPhiPreFit");  addvar.push_back("WMPhiPreFit");  addvar.push_back("TMPhiPreFit");  addvar.push_back("WBPhiPreFit"); addvar.push_back("WMassPostFit"); addvar.push_back("MassPostFit"); addvar.push_back("PtPostFit"); addvar.push_back("EtaPostFit"); addvar.push_back("PhiPostFit"); addvar.push_back("BMPhiPostFit");  addvar.push_back("WMPhiPostFit");  addvar.push_back("TMPhiPostFit");  addvar.push_back("WBPhiPostFit");  addvar.push_back("FitProb");  addvar.push_back("DPhiJet1b"); addvar.push_back("DPhiJet2b"); addvar.push_back("DRJet1b"); addvar.push_back("DRJet2b"); 
+    addvar.push_back("IndexB");    addvar.push_back("IndexJ1");    addvar.push_back("IndexJ2");  addvar.push_back("IndexB_MVA");    addvar.push_back("IndexJ1_MVA");    addvar.push_back("IndexJ2_MVA");  addvar.push_back("MVA");  addvar.push_back("WMassPreFit"); addvar.push_back("MassPreFit"); addvar.push_back("PtPreFit"); addvar.push_back("EtaPreFit"); addvar.push_back("PhiPreFit"); addvar.push_back("BMPhiPreFit");  addvar.push_back("WMPhiPreFit");  addvar.push_back("TMPhiPreFit");  addvar.push_back("WBPhiPreFit"); addvar.push_back("WMassPostFit"); addvar.push_back("MassPostFit"); addvar.push_back("PtPostFit"); addvar.push_back("EtaPostFit"); addvar.push_back("PhiPostFit"); addvar.push_back("BMPhiPostFit");  addvar.push_back("WMPhiPostFit");  addvar.push_back("TMPhiPostFit");  addvar.push_back("WBPhiPostFit");  addvar.push_back("FitProb"); addvar.push_back("FitChi2");  addvar.push_back("DPhiJet1b"); addvar.push_back("DPhiJet2b"); addvar.push_back("DRJet1b"); addvar.push_back("DRJet2b"); 
 
   }
 
@@ -3284,6 +2948,8 @@ vector<string> DMAnalysisTreeMaker::additionalVariables(string object){
     addvar.push_back("nElectronsSF");
     addvar.push_back("mt");
     addvar.push_back("Mt2w");
+    addvar.push_back("Mt2bl");
+    addvar.push_back("Mt2b");
     addvar.push_back("category");
     addvar.push_back("nMuonsSF");
     addvar.push_back("nCSVTJets");
@@ -3299,117 +2965,8 @@ vector<string> DMAnalysisTreeMaker::additionalVariables(string object){
     addvar.push_back("nTruePV");
     addvar.push_back("Rho");
 
-    addvar.push_back("bWeight0CSVT");
-    addvar.push_back("bWeight1CSVT");
-    addvar.push_back("bWeight2CSVT");
-
-    addvar.push_back("bWeight0CSVM");
-    addvar.push_back("bWeight1CSVM");
-    addvar.push_back("bWeight2CSVM");
-
-    addvar.push_back("bWeight0CSVL");
-    addvar.push_back("bWeight1CSVL");
-    addvar.push_back("bWeight2CSVL");
-
-    addvar.push_back("bWeightMisTagDown0CSVT");
-    addvar.push_back("bWeightMisTagDown1CSVT");
-    addvar.push_back("bWeightMisTagDown2CSVT");
-
-    addvar.push_back("bWeightMisTagDown0CSVM");
-    addvar.push_back("bWeightMisTagDown1CSVM");
-    addvar.push_back("bWeightMisTagDown2CSVM");
-
-    addvar.push_back("bWeightMisTagDown0CSVL");
-    addvar.push_back("bWeightMisTagDown1CSVL");
-    addvar.push_back("bWeightMisTagDown2CSVL");
-
-    addvar.push_back("bWeightMisTagUp0CSVT");
-    addvar.push_back("bWeightMisTagUp1CSVT");
-    addvar.push_back("bWeightMisTagUp2CSVT");
-
-    addvar.push_back("bWeightMisTagUp0CSVM");
-    addvar.push_back("bWeightMisTagUp1CSVM");
-    addvar.push_back("bWeightMisTagUp2CSVM");
-
-    addvar.push_back("bWeightMisTagUp0CSVL");
-    addvar.push_back("bWeightMisTagUp1CSVL");
-    addvar.push_back("bWeightMisTagUp2CSVL");
-
-    addvar.push_back("bWeightBTagUp0CSVT");
-    addvar.push_back("bWeightBTagUp1CSVT");
-    addvar.push_back("bWeightBTagUp2CSVT");
-    
-    addvar.push_back("bWeightBTagUp0CSVM");
-    addvar.push_back("bWeightBTagUp1CSVM");
-    addvar.push_back("bWeightBTagUp2CSVM");
-
-    addvar.push_back("bWeightBTagUp0CSVL");
-    addvar.push_back("bWeightBTagUp1CSVL");
-    addvar.push_back("bWeightBTagUp2CSVL");
-
-    addvar.push_back("bWeightBTagDown0CSVT");
-    addvar.push_back("bWeightBTagDown1CSVT");
-    addvar.push_back("bWeightBTagDown2CSVT");
-
-    addvar.push_back("bWeightBTagDown0CSVM");
-    addvar.push_back("bWeightBTagDown1CSVM");
-    addvar.push_back("bWeightBTagDown2CSVM");
-
-    addvar.push_back("bWeightBTagDown0CSVL");
-    addvar.push_back("bWeightBTagDown1CSVL");
-    addvar.push_back("bWeightBTagDown2CSVL");
-
-    //subjets
-
-    addvar.push_back("bWeight0CSVM_subj");
-    addvar.push_back("bWeight1CSVM_subj");
-    addvar.push_back("bWeight2CSVM_subj");
-    addvar.push_back("bWeight0_1CSVM_subj");
-
-    addvar.push_back("bWeight0CSVL_subj");
-    addvar.push_back("bWeight1CSVL_subj");
-    addvar.push_back("bWeight2CSVL_subj");
-    addvar.push_back("bWeight0_1CSVL_subj");
-
-    addvar.push_back("bWeightMisTagDown0CSVM_subj");
-    addvar.push_back("bWeightMisTagDown1CSVM_subj");
-    addvar.push_back("bWeightMisTagDown2CSVM_subj");
-    addvar.push_back("bWeightMisTagDown0_1CSVM_subj");
-
-    addvar.push_back("bWeightMisTagDown0CSVL_subj");
-    addvar.push_back("bWeightMisTagDown1CSVL_subj");
-    addvar.push_back("bWeightMisTagDown2CSVL_subj");
-    addvar.push_back("bWeightMisTagDown0_1CSVL_subj");
-
-    addvar.push_back("bWeightMisTagUp0CSVM_subj");
-    addvar.push_back("bWeightMisTagUp1CSVM_subj");
-    addvar.push_back("bWeightMisTagUp2CSVM_subj");
-    addvar.push_back("bWeightMisTagUp0_1CSVM_subj");
-
-    addvar.push_back("bWeightMisTagUp0CSVL_subj");
-    addvar.push_back("bWeightMisTagUp1CSVL_subj");
-    addvar.push_back("bWeightMisTagUp2CSVL_subj");
-    addvar.push_back("bWeightMisTagUp0_1CSVL_subj");
-
-    addvar.push_back("bWeightBTagUp0CSVM_subj");
-    addvar.push_back("bWeightBTagUp1CSVM_subj");
-    addvar.push_back("bWeightBTagUp2CSVM_subj");
-    addvar.push_back("bWeightBTagUp0_1CSVM_subj");
-
-    addvar.push_back("bWeightBTagUp0CSVL_subj");
-    addvar.push_back("bWeightBTagUp1CSVL_subj");
-    addvar.push_back("bWeightBTagUp2CSVL_subj");
-    addvar.push_back("bWeightBTagUp0_1CSVL_subj");
-
-    addvar.push_back("bWeightBTagDown0CSVM_subj");
-    addvar.push_back("bWeightBTagDown1CSVM_subj");
-    addvar.push_back("bWeightBTagDown2CSVM_subj");
-    addvar.push_back("bWeightBTagDown0_1CSVM_subj");
-
-    addvar.push_back("bWeightBTagDown0CSVL_subj");
-    addvar.push_back("bWeightBTagDown1CSVL_subj");
-    addvar.push_back("bWeightBTagDown2CSVL_subj");
-    addvar.push_back("bWeightBTagDown0_1CSVL_subj");
+    for(size_t b = 0; b < bTagBranchesAK4.size(); ++b) addvar.push_back(bTagBranchesAK4[b].substr(string("Event_").size()));
+    for(size_t b = 0; b < bTagBranchesSubj.size(); ++b) addvar.push_back(bTagBranchesSubj[b].substr(string("Event_").size()));
 
     addvar.push_back("T_Pt");
     addvar.push_back("T_Eta");
@@ -3902,42 +3459,79 @@ void DMAnalysisTreeMaker::initTreeWeightHistory(bool useLHEW){
 }
 
 
-double DMAnalysisTreeMaker::MassSmear(double pt,  double eta, double rho, int fac){ //stochastic smearing
-  double smear =1.0,  sigma=1.0;
-  double delta =1.0;
-  double sf=1.23;
-  double unc=0.18;
-  
-  std::string resolFile = "Spring16_25nsV10_MC_PtResolution_AK8PFchs.txt";
-  
-  JME::JetResolution resolution;
-
-  resolution = JME::JetResolution(resolFile);
-	
+double DMAnalysisTreeMaker::jetResolution8(double pt,  double eta, double rho){ //-1 without an AK8 resolution file
+  JME::JetResolution * res = getResolution(boosted_tops_label);
+  if(!res) return -1.;
   JME::JetParameters parameters;
 
   parameters.setJetPt(pt);
   parameters.setJetEta(eta);
   parameters.setRho(rho);
 
-  sigma = resolution.getResolution(parameters);
+  return res->getResolution(parameters);
+}
+
+double DMAnalysisTreeMaker::MassSmear(double sigma, int fac, int obj, int syst){ //stochastic smearing, sigma from jetResolution8
+  double smear =1.0;
+  double delta =1.0;
+  double sf=massResolSF8;
+  double unc=massResolSFUnc8;
+  if(sigma <= 0) return smear;
+  
   delta = std::max((double)(0.0), (double)(pow((sf+fac*unc),2) - 1.));
     
-  std::random_device rd;
-  std::mt19937 gen(rd()); 
-
-  std::normal_distribution<> d(0, sigma);
+  //one independent draw per jet, systematic and variation, as with the previous per-call generator
+  double gaus = rng.gaus(obj, syst, fac+1, sigma);
 
-  smear = std::max((double)(0.0), (double)(1 + d(gen) * sqrt(delta)));
+  smear = std::max((double)(0.0), (double)(1 + gaus * sqrt(delta)));
 
   return  smear;
 }
 
-double DMAnalysisTreeMaker::smear(double pt, double genpt, double eta, string syst){ //scaling method
-  double resolScale = resolSF(fabs(eta), syst);
-  double smear =1.0;
-  if(genpt>0) smear = std::max((double)(0.0), (double)(pt + (pt - genpt) * resolScale) / pt);
-  return  smear;
+double DMAnalysisTreeMaker::smear(int coll, int obj, double pt, double eta, double phi, double genpt, double geneta, double genphi, string syst){ //hybrid method
+  if(isData)return 1.0;
+  vector<JERFactors> & cache = jerCache[coll];
+  const string & label = coll == jerAK8 ? boosted_tops_label : jets_label;
+  if(obj >= (int)cache.size())cache.resize(max(obj+1, max_instances[label]));
+  JERFactors & f = cache[obj];
+  if(!f.done){
+    //corrected pt does not change with the systematics before smearing, so the first one fills the cache
+    if(coll == jerAK8) jerFactors(pt, eta, phi, genpt, geneta, genphi, 0.8, getResolution(label), obj, 101, f);
+    else jerFactors(pt, eta, phi, genpt, geneta, genphi, 0.4, getResolution(label), obj, 100, f);
+  }
+  if (syst == "jer__up")return f.up;
+  if (syst == "jer__down")return f.down;
+  return f.nominal;
+}
+
+void DMAnalysisTreeMaker::jerFactors(double pt, double eta, double phi, double genpt, double geneta, double genphi, double rcone, JME::JetResolution * res, int obj, int stream, JERFactors & f){
+  //from https://twiki.cern.ch/twiki/bin/viewauth/CMS/JetResolution#Smearing_procedures
+  double sigma = -1.;
+  if(res){
+    JME::JetParameters parameters;
+    parameters.setJetPt(pt);
+    parameters.setJetEta(eta);
+    parameters.setRho(Rho);
+    sigma = res->getResolution(parameters);
+  }
+  //gen jet match: dR < R/2 and, when the resolution is known, |pt-genpt| < 3 sigma pt
+  bool matched = genpt > 0 && deltaR(eta, phi, geneta, genphi) < rcone/2.;
+  if(matched && sigma > 0) matched = fabs(pt - genpt) < 3 * sigma * pt;
+
+  //one draw shared by the three variations
+  double gaus = 0.;
+  if(!matched && sigma > 0) gaus = rng.gaus(obj, 0, stream, sigma);
+
+  float * out[3] = {&f.nominal, &f.up, &f.down};
+  string systs[3] = {"noSyst", "jer__up", "jer__down"};
+  for(int v = 0; v < 3; ++v){
+    double resolScale = resolSF(fabs(eta), systs[v]);
+    double smear = 1.0;
+    if(matched) smear = std::max((double)(0.0), (double)(pt + (pt - genpt) * resolScale) / pt);
+    else if(sigma > 0) smear = std::max((double)(0.0), (double)(1 + gaus * sqrt(std::max(0.0, pow(1 + resolScale, 2) - 1.))));
+    *(out[v]) = smear;
+  }
+  f.done = true;
 }
 
 double DMAnalysisTreeMaker::resolSF(double eta, string syst)
@@ -3994,32 +3588,108 @@ double DMAnalysisTreeMaker::getEffectiveArea(string particle, double eta){
 
 
 };
-double DMAnalysisTreeMaker::jetUncertainty(double ptCorr, double eta, string syst)
+void DMAnalysisTreeMaker::addJetCorrections(string label, string algo, string payloadPrefix, string uncPrefix)
 {
-  if(ptCorr<0)return ptCorr;
-  if(syst == "jes__up" || syst == "jes__down"){
-    double fac = 1.;
-    if (syst == "jes__down")fac = -1.;
-    jecUnc->setJetEta(eta);
-    jecUnc->setJetPt(ptCorr);
-    double JetCorrection = jecUnc->getUncertainty(true);
-    return JetCorrection*fac;
+  JetCorrectionConfig c;
+  c.algo = algo;
+  c.payloadPrefix = payloadPrefix;
+  c.uncPrefix = uncPrefix;
+  jecConfigs[label] = c;
+}
+
+JetCorrectionChain * DMAnalysisTreeMaker::getJetCorrections(string label)
+{
+  map<string, JetCorrectionChain *>::iterator it = jetCorrections.find(label);
+  if(it != jetCorrections.end()) return it->second;
+  JetCorrectionConfig & c = jecConfigs[label];
+  if(jecChains.find(c.algo) == jecChains.end()){
+    TStopwatch timer;
+    timer.Start();
+    jecChains[c.algo] = new JetCorrectionChain(c.algo, c.payloadPrefix, c.uncPrefix, isData);
+    timer.Stop();
+    reportLoad("JEC "+c.payloadPrefix+"*_"+c.algo, timer.RealTime());
+  }
+  jetCorrections[label] = jecChains[c.algo];
+  return jetCorrections[label];
+}
+
+JME::JetResolution * DMAnalysisTreeMaker::getResolution(string label)
+{
+  bool isAK8 = (label == boosted_tops_label);
+  JME::JetResolution *& res = isAK8 ? resolution8 : resolution4;
+  string & file = isAK8 ? resolFile8 : resolFile4;
+  if(!res && file != ""){
+    TStopwatch timer;
+    timer.Start();
+    res = new JME::JetResolution(file);
+    timer.Stop();
+    reportLoad("JER "+file, timer.RealTime());
+  }
+  return res;
+}
+
+void DMAnalysisTreeMaker::loadBTagEfficiencyMaps(const edm::ParameterSet & iConfig, string param, vector<string> defaults, BTagEfficiencyMap * maps[BTagWeight::nWPs])
+{
+  vector<string> files = iConfig.getUntrackedParameter<vector<string> >(param, defaults);
+  for(int wp = 0; wp < BTagWeight::nWPs; ++wp){
+    maps[wp] = 0;
+    if(wp >= (int)files.size() || files.at(wp) == "") continue;
+    //the binary table written next to the .root file by makeBTaggingEfficiencyMaps is read instead
+    string file = files.at(wp);
+    if(file.size() > 5 && file.compare(file.size() - 5, 5, ".root") == 0){
+      string table = file.substr(0, file.size() - 5) + ".bin";
+      if(std::ifstream(table.c_str()).good()) file = table;
+    }
+    TStopwatch timer;
+    timer.Start();
+    maps[wp] = new BTagEfficiencyMap(file);
+    timer.Stop();
+    reportLoad("b-tag efficiency map "+file, timer.RealTime());
   }
-  return 0.0;
 }
 
-double DMAnalysisTreeMaker::jetUncertainty8(double ptCorr, double eta, string syst)
+int DMAnalysisTreeMaker::resolvedTopMVAInput(string name)
 {
-  if(ptCorr<0)return ptCorr;
-  if(syst == "jes__up" || syst == "jes__down"){
-    double fac = 1.;
-    if (syst == "jes__down")fac = -1.;
-    jecUnc8->setJetEta(eta);
-    jecUnc8->setJetPt(ptCorr);
-    double JetCorrection = jecUnc8->getUncertainty(true);
-    return JetCorrection*fac;
+  const char * names[nResolvedTopMVAInputs] = {"Pt", "Eta", "Mass", "WMass", "massDrop", "MassChi2", "WBPhi",
+					       "DPhiJet1b", "DPhiJet2b", "DRJet1b", "DRJet2b",
+					       "BPt", "J1Pt", "J2Pt", "BCSV", "J1CSV", "J2CSV"};
+  for(int i = 0; i < nResolvedTopMVAInputs; ++i) if(name == names[i]) return i;
+  throw cms::Exception("DMAnalysisTreeMaker") << "resolvedTopHad BDT variable " << name << " is not available\n";
+}
+
+void DMAnalysisTreeMaker::fillResolvedTopMVAInputs(const ResolvedTopTriplets::Candidate & cand, const float * jetPt, const float * jetCSV, float * row)
+{
+  for(size_t v = 0; v < topMVAInputs.size(); ++v){
+    float x = 0.;
+    switch(topMVAInputs[v]){
+    case tmvaPt: x = cand.pt; break;
+    case tmvaEta: x = cand.eta; break;
+    case tmvaMass: x = cand.mass; break;
+    case tmvaWMass: x = cand.wMass; break;
+    case tmvaMassDrop: x = cand.massDrop; break;
+    case tmvaMassChi2: x = cand.massChi2; break;
+    case tmvaWBPhi: x = deltaPhi(cand.wPhi, cand.bPhi); break;
+    case tmvaDPhiJet1b: x = cand.dPhiJet1b; break;
+    case tmvaDPhiJet2b: x = cand.dPhiJet2b; break;
+    case tmvaDRJet1b: x = cand.dRJet1b; break;
+    case tmvaDRJet2b: x = cand.dRJet2b; break;
+    case tmvaBPt: x = jetPt[cand.b]; break;
+    case tmvaJ1Pt: x = jetPt[cand.j1]; break;
+    case tmvaJ2Pt: x = jetPt[cand.j2]; break;
+    case tmvaBCSV: x = jetCSV[cand.b]; break;
+    case tmvaJ1CSV: x = jetCSV[cand.j1]; break;
+    case tmvaJ2CSV: x = jetCSV[cand.j2]; break;
+    }
+    row[v] = x;
   }
-  return 0.0;
+}
+
+void DMAnalysisTreeMaker::reportLoad(string what, double seconds)
+{
+  ostringstream line;
+  line << what << " loaded in " << seconds << " s";
+  cout << "DMAnalysisTreeMaker: " << line.str() << endl;
+  loadReport.push_back(line.str());
 }
 
 double DMAnalysisTreeMaker::massUncertainty8(double massCorr, string syst)
@@ -4066,1032 +3736,232 @@ bool DMAnalysisTreeMaker::isInVector(std::vector<std::string> v, std::string s){
 
 
 //BTag weighter
-bool DMAnalysisTreeMaker::BTagWeight::filter(int t)
+bool DMAnalysisTreeMaker::BTagWeight::Category::filter(const int ntags[nWPs]) const
 {
-    return (t >= minTags && t <= maxTags);
+    for (int w = 0; w < nWPs; ++w)
+    {
+        if (ntags[w] < minTags[w] || ntags[w] > maxTags[w]) return false;
+    }
+    return true;
 }
 
-float DMAnalysisTreeMaker::BTagWeight::weight(vector<JetInfo> jetTags, int tags)
+int DMAnalysisTreeMaker::BTagWeight::Category::singleWP() const
 {
-    if (!filter(tags))
+    int wp = -1;
+    for (int w = 0; w < nWPs; ++w)
     {
-      //std::cout << "nThis event should not pass the selection, what is it doing here?" << std::endl;
-        return 0;
+        if (!constrains(w)) continue;
+        if (wp >= 0) return -1;
+        wp = w;
     }
-    int njetTags = jetTags.size();
-    int comb = 1 << njetTags;
-    float pMC = 0;
-    float pData = 0;
-    for (int i = 0; i < comb; i++)
-    {
-        float mc = 1.;
-        float data = 1.;
-        int ntagged = 0;
-        for (int j = 0; j < njetTags; j++)
-        {
-            bool tagged = ((i >> j) & 0x1) == 1;
-            if (tagged)
-            {
-                ntagged++;
-                mc *= jetTags[j].eff;
-                data *= jetTags[j].eff * jetTags[j].sf;
-            }
-            else
-            {
-                mc *= (1. - jetTags[j].eff);
-                data *= (1. - jetTags[j].eff * jetTags[j].sf);
-            }
-        }
+    return wp < 0 ? CSVL : wp;
+}
 
-        if (filter(ntagged))
-        {
-	  //	  std::cout << mc << " " << data << endl;
-            pMC += mc;
-            pData += data;
-        }
+void DMAnalysisTreeMaker::BTagWeight::JetTable::clear()
+{
+    for (int w = 0; w < nWPs; ++w)
+    {
+        eff[w].clear();
+        for (int v = 0; v < nVariations; ++v) sf[w][v].clear();
     }
-
-    if (pMC == 0) return 0;
-    return pData / pMC;
 }
 
-
-double DMAnalysisTreeMaker::MCTagEfficiencySubjet(string algo, int flavor, double pt, double eta){
-  if ((abs(flavor) ==5)){ 
-    if (algo=="csvm") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.284091; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.361111; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.283784; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.476489; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.454861; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.376923; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.502451; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.480892; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.439024; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.532209; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.527831; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.474074; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.54755; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.557831; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.467187; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.552198; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.573951; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.492498; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.535885; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.531685; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.453575; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.449269; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.44352; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.400552; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.390766; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.394737; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.317647; 
-    }
-    if (algo=="csvl") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.477273; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.555556; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.472973; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.658307; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.649306; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.588462; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.64951; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.707006; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.61324; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.691718; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.738964; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.654321; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.728146; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.736145; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.690625; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.730769; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.741722; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.732568; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.720694; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.70711; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.694771; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.677206; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.664588; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.680939; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.656532; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.642857; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.711765; 
-    }
-  }
-  if ((abs(flavor) ==4)){ 
-    if (algo=="csvm") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0704225; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.0432692; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.0432692; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0807834; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.0852941; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.0872675; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.0861298; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.0989957; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.0802469; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.101236; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.106457; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.087146; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.107405; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.112926; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.112971; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.110882; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.109333; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.092999; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.0974194; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.0953184; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.0986214; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.0934178; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.109236; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.113351; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.0968069; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.119436; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.1; 
-    }
-    if (algo=="csvl") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.232394; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.206731; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.192308; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.277846; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.305882; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.253219; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.289709; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.315638; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.257716; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.304482; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.316754; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.305011; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.307518; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.308949; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.320502; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.312049; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.332; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.338036; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.296452; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.31337; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.344115; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.304004; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.330776; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.385831; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.329954; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.397626; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.426087; 
-    }
-  }
-  if ((abs(flavor)!= 5 && (abs(flavor)!= 4 ))){ 
-    if (algo=="csvm") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0127099; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.0142752; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.0150551; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0149497; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.0148449; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.025; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.0102449; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.0128765; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.016835; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.010187; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.0139552; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.0218688; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.00983413; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.0115432; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.0188073; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.00940008; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.0106913; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.019997; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.01057; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.0139478; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.022888; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.0148112; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.0187542; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.0307771; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.022779; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.0282619; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.0396389; 
-    }
-    if (algo=="csvl") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0755788; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.0950037; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.101357; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.10048; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.108998; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.137057; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.0830857; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.100368; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.129032; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.0839288; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.10876; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.137448; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.0784764; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.100403; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.150217; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.0774176; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.0937824; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.155002; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.0850308; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.10305; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.171304; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.109577; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.133381; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.215083; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.157024; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.179517; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.243524; 
+void DMAnalysisTreeMaker::BTagWeight::JetTable::push_back(const double effs[nWPs], const double sfs[nWPs][nVariations])
+{
+    for (int w = 0; w < nWPs; ++w)
+    {
+        eff[w].push_back(effs[w]);
+        for (int v = 0; v < nVariations; ++v) sf[w][v].push_back(sfs[w][v]);
     }
-  }
-  
-  return 1.0;
 }
 
-double DMAnalysisTreeMaker::MCTagEfficiency(string algo, int flavor, double pt, double eta){
-
-  if ((abs(flavor) ==5)){ 
-    if (algo=="csvt") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.342571; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.288474; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.216505; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.437115; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.4047; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.338496; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.486694; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.422745; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.361853; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.481402; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.475984; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.374789; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.491533; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.460526; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.369161; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.448853; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.470953; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.347471; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.431072; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.421002; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.315734; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.361362; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.34923; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.295325; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.330469; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.348276; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.265306; 
-    }
-    if (algo=="csvm") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.534198; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.499001; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.414671; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.647904; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.627937; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.56167; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.67714; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.651373; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.576598; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.68872; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.699531; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.592855; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.695597; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.679656; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.576595; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.6739; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.680093; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.556281; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.644785; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.635838; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.55755; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.589675; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.590609; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.523375; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.53125; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.55977; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.483965; 
-    }
-    if (algo=="csvl") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.732311; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.714191; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.677025; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.810026; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.807441; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.779314; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.836807; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.826275; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.787961; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.848171; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.853738; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.799461; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.850127; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.857794; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.804119; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.83695; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.846631; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.797716; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.81984; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.806358; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.795143; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.804683; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.796038; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.777651; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.794531; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.791954; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.787172; 
-    }
-  }
-  if ((abs(flavor) ==4)){ 
-    if (algo=="csvt") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0262541; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.0185376; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.0136986; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0319807; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.0197183; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.0279493; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.0255741; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.01772; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.0205867; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.0232438; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.0279521; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.0255624; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.0260586; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.0359205; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.0274143; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.0343137; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.0388926; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.0204082; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.0273909; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.0384615; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.0315594; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.0278928; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.0291363; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.030622; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.0356135; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.0491315; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.0286369; 
-    }
-    if (algo=="csvm") { 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.112049; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.101442; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.0826069; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.138239; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.128773; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.132922; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.129436; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.113408; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.121462; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.137913; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.12664; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.121166; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.123779; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.140475; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.141433; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.143791; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.151615; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.115412; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.129062; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.142534; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.133045; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.118476; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.141172; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.146411; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.124824; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.144417; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.153494; 
-    }
-    if (algo=="csvl") {
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.320206; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.34243; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.288501; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.358666; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.4; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.375691; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.368476; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.384525; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.384457; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.370351; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.396463; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.373211; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.357763; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.381655; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.384424; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.383987; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.423863; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.399719; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.370474; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.397059; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.429455; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.360398; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.417967; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.465072; 
-      if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.386812; 
-      if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.456079; 
-      if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.510882; 
-    }
-  }
-  if ((abs(flavor)!= 5 && (abs(flavor)!= 4))){ 
-      if (algo=="csvt") {
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.00259623; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.00213082; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.00150227; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0014928; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.0017178; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.00184959; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.000814536; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.00163144; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.000850871; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.00123497; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.00141717; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.00166174; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.00107009; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.00175009; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.00151395; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.00120192; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.00189036; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.00296673; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.00119175; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.00238975; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.00293906; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.00236889; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.00339697; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.00545897; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.00495133; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.00795053; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.00723691; 
-      }
-      if (algo=="csvm") {
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0128081; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.0132035; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.0141569; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0117292; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.0147411; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.0181379; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.00733083; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.0127678; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.0150888; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.00708482; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.0106661; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.0147095; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.00825499; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.0119881; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.0188162; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.00773738; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.0116859; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.0221798; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.00991031; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.0137591; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.028191; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.013274; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.0217214; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.0386715; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.0226748; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.0373743; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.0433209; 
-      }
-      if (algo=="csvl") {
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  20) && (pt < 30))) return 0.0864027; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  20) && (pt < 30))) return 0.115483; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  20) && (pt < 30))) return 0.182538; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  30) && (pt < 50))) return 0.0854452; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  30) && (pt < 50))) return 0.116731; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  30) && (pt < 50))) return 0.164494; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  50) && (pt < 70))) return 0.0652256; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  50) && (pt < 70))) return 0.0963967; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  50) && (pt < 70))) return 0.130183; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  70) && (pt < 100))) return 0.0654534; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  70) && (pt < 100))) return 0.0936824; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  70) && (pt < 100))) return 0.137001; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  100) && (pt < 140))) return 0.0640526; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  100) && (pt < 140))) return 0.0920546; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  100) && (pt < 140))) return 0.145051; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  140) && (pt < 200))) return 0.0706881; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  140) && (pt < 200))) return 0.100962; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  140) && (pt < 200))) return 0.169457; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  200) && (pt < 300))) return 0.0755818; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  200) && (pt < 300))) return 0.107032; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  200) && (pt < 300))) return 0.183781; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  300) && (pt < 600))) return 0.0990443; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  300) && (pt < 600))) return 0.143629; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  300) && (pt < 600))) return 0.222533; 
-	if(((fabs(eta)>=0) && (fabs(eta) <0.6)) && ((pt >=  600) && (pt < 1000))) return 0.152535; 
-	if(((fabs(eta)>=0.6) && (fabs(eta) <1.2)) && ((pt >=  600) && (pt < 1000))) return 0.207257; 
-	if(((fabs(eta)>=1.2) && (fabs(eta) <2.4)) && ((pt >=  600) && (pt < 1000))) return 0.287868; 
-      }
+void DMAnalysisTreeMaker::BTagWeight::propagate(const JetTable & jets, int var, vector<double> & p)
+{
+    size_t size = nbins[CSVL] * nbins[CSVM] * nbins[CSVT];
+    p.assign(size, 0.);
+    p[0] = 1.;
+    for (size_t j = 0; j < jets.size(); j++)
+    {
+        //WPs are nested, so the efficiencies are kept ordered
+        double e[nWPs];
+        for (int w = 0; w < nWPs; ++w)
+        {
+            e[w] = jets.eff[w][j];
+            if (var >= 0) e[w] = min(1., e[w] * jets.sf[w][var][j]);
+            if (w > 0) e[w] = min(e[w], e[w - 1]);
+        }
+        //Probabilities of the four states: fails L, L only, M only, T
+        double st[4] = { 1. - e[CSVL], e[CSVL] - e[CSVM], e[CSVM] - e[CSVT], e[CSVT] };
+
+        next.assign(size, 0.);
+        for (int l = 0; l < nbins[CSVL]; ++l)
+            for (int m = 0; m < nbins[CSVM]; ++m)
+                for (int t = 0; t < nbins[CSVT]; ++t)
+                {
+                    size_t i = (l * nbins[CSVM] + m) * nbins[CSVT] + t;
+                    if (p[i] == 0.) continue;
+                    for (int s = 0; s < 4; ++s)
+                    {
+                        int nl = min(l + (s >= 1), nbins[CSVL] - 1);
+                        int nm = min(m + (s >= 2), nbins[CSVM] - 1);
+                        int nt = min(t + (s >= 3), nbins[CSVT] - 1);
+                        next[(nl * nbins[CSVM] + nm) * nbins[CSVT] + nt] += p[i] * st[s];
+                    }
+                }
+        p.swap(next);
     }
-    
-    return 1.0;
 }
-  
-double DMAnalysisTreeMaker::TagScaleFactor(string algo, int flavor, string syst, double pt){
-  double x = pt;
-if(algo == "csvt"){
-    if(syst ==  "noSyst") {
-      if(abs(flavor)==5){
-        if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
-      }
-      if(abs(flavor)==4){
-        if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-        if( pt>=20 && pt < 1000) return 0.971945+163.215/(x*x)+0.000517836*x;
-      }
-    }
-     if(syst ==  "mistag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return (0.971945+163.215/(x*x)+0.000517836*x)*(1+(0.291298+-0.000222983*x+1.69699e-07*x*x));
-      }
-    }
-    if(syst ==  "mistag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
 
-      }
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 1000) return 0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return (0.971945+163.215/(x*x)+0.000517836*x)*(1-(0.291298+-0.000222983*x+1.69699e-07*x*x));
-      }
-    }
-  if(syst ==  "b_tag_up") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.11806446313858032;
-        if (pt >= 30  && pt < 50 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.054699532687664032;
-        if (pt >= 50  && pt < 70 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.047356218099594116;
-        if (pt >= 70  && pt < 100) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.047634456306695938;
-        if (pt >= 100 && pt < 140) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.04632849246263504;
-        if (pt >= 140 && pt < 200) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.048323042690753937;
-        if (pt >= 200 && pt < 300) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.068715795874595642;
-        if (pt >= 300 && pt < 600) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.10824859887361526;
-	if (pt >= 600  && pt < 1000 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.18500012159347534;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 30 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.033732704818248749;
-        if (pt >= 30  && pt < 50 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.01562843844294548 ;
-        if (pt >= 50  && pt < 70 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.013530348427593708;
-        if (pt >= 70  && pt < 100) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.013609844259917736;
-        if (pt >= 100 && pt < 140) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.013236711733043194;
-        if (pt >= 140 && pt < 200) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.013806583359837532;
-        if (pt >= 200 && pt < 300) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.019633084535598755;
-        if (pt >= 300 && pt < 600) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.030928170308470726;
-	if (pt >= 600  && pt < 1000 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))+0.052857179194688797;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-        if( pt>= 20 && pt < 1000) return (0.971945+163.215/(x*x)+0.000517836*x)*(1+(0.291298+-0.000222983*x+1.69699e-07*x*x));
-      }
-    }
-if(syst ==  "b_tag_down") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.11806446313858032;
-        if (pt >= 30  && pt < 50 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.054699532687664032;
-        if (pt >= 50  && pt < 70 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.047356218099594116;
-        if (pt >= 70  && pt < 100) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.047634456306695938;
-        if (pt >= 100 && pt < 140) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.04632849246263504;
-        if (pt >= 140 && pt < 200) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.048323042690753937;
-        if (pt >= 200 && pt < 300) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.068715795874595642;
-        if (pt >= 300 && pt < 600) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.10824859887361526;
-	if (pt >= 600  && pt < 1000 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.18500012159347534;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 30 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.033732704818248749;
-        if (pt >= 30  && pt < 50 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.01562843844294548;
-        if (pt >= 50  && pt < 70 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.013530348427593708;
-        if (pt >= 70  && pt < 100) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.013609844259917736;
-        if (pt >= 100 && pt < 140) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.013236711733043194;
-        if (pt >= 140 && pt < 200) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.013806583359837532;
-        if (pt >= 200 && pt < 300) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.019633084535598755;
-        if (pt >= 300 && pt < 600) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.03092817030847072 ;
-	if (pt >= 600  && pt < 1000 ) return (0.817647*((1.+(0.038703*x))/(1.+(0.0312388*x))))-0.052857179194688797;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-        if ( pt>=20 && pt<1000) return (0.971945+163.215/(x*x)+0.000517836*x)*(1-(0.291298+-0.000222983*x+1.69699e-07*x*x));
-      }
-    }
- }                 
-  //Medium WP
-  if(algo == "csvm"){
-    if(syst ==  "noSyst") {
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 1000) return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 1000) return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return 1.0589+0.000382569*x+-2.4252e-07*x*x+2.20966e-10*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30  && pt < 670) return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30  && pt < 670) return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return (1.0589+0.000382569*x+-2.4252e-07*x*x+2.20966e-10*x*x*x)*(1+(0.100485+3.95509e-05*x+-4.90326e-08*x*x));
-      }
+void DMAnalysisTreeMaker::BTagWeight::tagMultiplicity(const JetTable & jets, int wp, int var, vector<double> & p)
+{
+    //Poisson-binomial recursion: adding jet j moves probability from n to n+1 tags with p = eff (MC) or eff*sf (data)
+    size_t njets = jets.size();
+    p.assign(njets + 1, 0.);
+    p[0] = 1.;
+    for (size_t j = 0; j < njets; j++)
+    {
+        double e = jets.eff[wp][j];
+        if (var >= 0) e *= jets.sf[wp][var][j];
+        for (size_t n = j + 1; n > 0; n--) p[n] = p[n] * (1. - e) + p[n - 1] * e;
+        p[0] *= (1. - e);
     }
-    if(syst ==  "mistag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30  && pt < 670)  return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
+}
 
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30  && pt < 670) return 0.561694*((1.+(0.31439*x))/(1.+(0.17756*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return (1.0589+0.000382569*x+-2.4252e-07*x*x+2.20966e-10*x*x*x)*(1-(0.100485+3.95509e-05*x+-4.90326e-08*x*x));
-      }
+void DMAnalysisTreeMaker::BTagWeight::weights(const JetTable & jets, const vector<Category> & cats, const int ntags[nWPs], vector<double> & result)
+{
+    size_t ncats = cats.size();
+    int njets = jets.size();
+    result.assign(ncats * nVariations, 0.);
+
+    bool any = false;
+    for (size_t c = 0; c < ncats; ++c) any = any || cats[c].filter(ntags);
+    if (!any) return;
+
+    //Bins of the joint distribution, only on the WPs constrained by the multi WP categories: a range
+    //ending below N needs the bins up to maxTags+1 (all the counts above it fail), one open above needs
+    //them up to minTags; an unconstrained WP has a single bin
+    bool single1D[nWPs] = { false, false, false };
+    bool joint = false;
+    for (int w = 0; w < nWPs; ++w) nbins[w] = 1;
+    for (size_t c = 0; c < ncats; ++c)
+    {
+        if (!cats[c].filter(ntags)) continue;
+        int wp = cats[c].singleWP();
+        if (wp >= 0)
+        {
+            single1D[wp] = true;
+            continue;
+        }
+        joint = true;
+        for (int w = 0; w < nWPs; ++w)
+        {
+            if (!cats[c].constrains(w)) continue;
+            int needed = cats[c].maxTags[w] < njets ? cats[c].maxTags[w] + 1 : cats[c].minTags[w];
+            nbins[w] = max(nbins[w], min(njets, needed) + 1);
+        }
     }
 
-    if(syst ==  "b_tag_up") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.12064050137996674;
-	if (pt >= 30  && pt < 50 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.042138919234275818;
-	if (pt >= 50  && pt < 70 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.03711806982755661;
-	if (pt >= 70  && pt < 100) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.036822021007537842;
-	if (pt >= 100 && pt < 140) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.034397732466459274;
-	if (pt >= 140 && pt < 200) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.0362386554479599;
-	if (pt >= 200 && pt < 300) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.044985830783843994;
-	if (pt >= 300 && pt < 600) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.064243391156196594;
-	if (pt >= 600  && pt < 1000 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.097131341695785522;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 30 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.040213499218225479;
-	if (pt >= 30  && pt < 50 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.014046305790543556;
-	if (pt >= 50  && pt < 70 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.012372690252959728;
-	if (pt >= 70  && pt < 100) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.012274007312953472;
-	if (pt >= 100 && pt < 140) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.011465910822153091;
-	if (pt >= 140 && pt < 200) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.012079551815986633;
-	if (pt >= 200 && pt < 300) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.014995276927947998;
-	if (pt >= 300 && pt < 600) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.021414462476968765;
-	if (pt >= 600  && pt < 1000 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))+0.032377112656831741;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if( pt>=20 && pt<1000) return (1.0589+0.000382569*x+-2.4252e-07*x*x+2.20966e-10*x*x*x)*(1+(0.100485+3.95509e-05*x+-4.90326e-08*x*x));
-      }
+    for (int w = 0; w < nWPs; ++w) if (single1D[w]) tagMultiplicity(jets, w, -1, pMC1D[w]);
+    if (joint) propagate(jets, -1, pMC);
+    for (int v = 0; v < nVariations; ++v)
+    {
+        for (int w = 0; w < nWPs; ++w) if (single1D[w]) tagMultiplicity(jets, w, v, pData1D[w]);
+        if (joint) propagate(jets, v, pData);
+        for (size_t c = 0; c < ncats; ++c)
+        {
+            if (!cats[c].filter(ntags)) continue;
+            double sumMC = 0;
+            double sumData = 0;
+            int wp = cats[c].singleWP();
+            if (wp >= 0)
+            {
+                for (int n = max(cats[c].minTags[wp], 0); n <= min(cats[c].maxTags[wp], njets); ++n)
+                {
+                    sumMC += pMC1D[wp][n];
+                    sumData += pData1D[wp][n];
+                }
+            }
+            else
+            {
+                for (int l = 0; l < nbins[CSVL]; ++l)
+                    for (int m = 0; m < nbins[CSVM]; ++m)
+                        for (int t = 0; t < nbins[CSVT]; ++t)
+                        {
+                            int counts[nWPs] = { l, m, t };
+                            if (!cats[c].filter(counts)) continue;
+                            size_t i = (l * nbins[CSVM] + m) * nbins[CSVT] + t;
+                            sumMC += pMC[i];
+                            sumData += pData[i];
+                        }
+            }
+            if (sumMC != 0) result[v * ncats + c] = sumData / sumMC;
+        }
     }
+}
 
-    if(syst ==  "b_tag_down") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.12064050137996674;
-	if (pt >= 30  && pt < 50 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.042138919234275818;
-	if (pt >= 50  && pt < 70 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.03711806982755661;
-	if (pt >= 70  && pt < 100) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.036822021007537842;
-	if (pt >= 100 && pt < 140) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.034397732466459274;
-	if (pt >= 140 && pt < 200) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.0362386554479599;
-	if (pt >= 200 && pt < 300) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.044985830783843994;
-	if (pt >= 300 && pt < 670) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.064243391156196594;
-	if (pt >= 600  && pt < 1000 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.097131341695785522;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 30 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.040213499218225479 ;
-	if (pt >= 30  && pt < 50 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.014046305790543556;
-	if (pt >= 50  && pt < 70 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.012372690252959728;
-	if (pt >= 70  && pt < 100) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.012274007312953472;
-	if (pt >= 100 && pt < 140) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.011465910822153091;
-	if (pt >= 140 && pt < 200) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.012079551815986633;
-	if (pt >= 200 && pt < 300) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.014995276927947998;
-	if (pt >= 300 && pt < 600) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.021414462476968765;
-	if (pt >= 600  && pt < 1000 ) return (0.561694*((1.+(0.31439*x))/(1.+(0.17756*x))))-0.032377112656831741;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return ((1.0589+0.000382569*x+-2.4252e-07*x*x+2.20966e-10*x*x*x)*(1-(0.100485+3.95509e-05*x+-4.90326e-08*x*x)));
-      }
+void DMAnalysisTreeMaker::bookBTagCategories(const vector<BTagWeight::Category> & cats, vector<string> & branches){
+  string variations[BTagWeight::nVariations] = {"","MisTagUp","MisTagDown","BTagUp","BTagDown"};
+  branches.clear();
+  for(int v = 0; v < BTagWeight::nVariations; ++v){
+    for(size_t c = 0; c < cats.size(); ++c){
+      branches.push_back("Event_bWeight"+variations[v]+cats.at(c).name);
     }
   }
+}
 
-  //Loose WP
-  if(algo == "csvl"){
-    double x=pt;
-    if(syst ==  "noSyst") {
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 1000) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 1000) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 1.13904+-0.000594946*x+1.97303e-06*x*x+-1.38194e-09*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30  && pt < 670) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30  && pt < 670) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return (1.13904+-0.000594946*x+1.97303e-06*x*x+-1.38194e-09*x*x*x)*(1+(0.0996438+-8.33354e-05*x+4.74359e-08*x*x));
-      }
-    }
-    if(syst ==  "mistag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30  && pt < 670) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30  && pt < 670) return 0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x)));
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return (1.13904+-0.000594946*x+1.97303e-06*x*x+-1.38194e-09*x*x*x)*(1-(0.0996438+-8.33354e-05*x+4.74359e-08*x*x));
-      }
-    }
-    
-    if(syst ==  "b_tag_up") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.063454590737819672; 
-	if (pt >= 30  && pt < 50 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.031410016119480133;
-	if (pt >= 50  && pt < 70 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.02891194075345993;
-	if (pt >= 70  && pt < 100) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.028121808543801308;
-	if (pt >= 100 && pt < 140) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.027028990909457207;
-	if (pt >= 140 && pt < 200) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.027206243947148323;
-	if (pt >= 200 && pt < 300) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.033642303198575974;
-	if (pt >= 300 && pt < 600) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.04273652657866478;
-	if (pt >= 600 && pt< 1000) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.054665762931108475;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20  && pt < 30 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.025381835177540779;
-      	if (pt >= 30  && pt < 50 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.012564006261527538;
-	if (pt >= 50  && pt < 70 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.011564776301383972;
-	if (pt >= 70  && pt < 100) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.011248723603785038;
-	if (pt >= 100 && pt < 140) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.010811596177518368;
-	if (pt >= 140 && pt < 200) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.010882497765123844;
-	if (pt >= 200 && pt < 300) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.013456921093165874;
-	if (pt >= 300 && pt < 600) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.017094610258936882;
-	if (pt >= 600 && pt < 1000) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))+0.02186630479991436;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return (1.13904+-0.000594946*x+1.97303e-06*x*x+-1.38194e-09*x*x*x)*(1+(0.0996438+-8.33354e-05*x+4.74359e-08*x*x));
-      }
-    }
 
-    if(syst ==  "b_tag_down") {
-      if(abs(flavor)==4){
-	if (pt >= 20  && pt < 30 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.063454590737819672;
-	if (pt >= 30  && pt < 50 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.031410016119480133;
-	if (pt >= 50  && pt < 70 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.02891194075345993;
-	if (pt >= 70  && pt < 100) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.028121808543801308;
-	if (pt >= 100 && pt < 140) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.027028990909457207;
-	if (pt >= 140 && pt < 200) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.027206243947148323;
-	if (pt >= 200 && pt < 300) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.033642303198575974;
-	if (pt >= 300 && pt < 600) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.04273652657866478;
-	if (pt >= 600 && pt < 1000) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.054665762931108475;
-      }
-      if(abs(flavor)==5){
-	if (pt >= 20 && pt < 30) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.025381835177540779;
-      	if (pt >= 30  && pt < 50 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.012564006261527538;
-	if (pt >= 50  && pt < 70 ) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.011564776301383972;
-	if (pt >= 70  && pt < 100) return(0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.011248723603785038;
-	if (pt >= 100 && pt < 140) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.010811596177518368;
-	if (pt >= 140 && pt < 200) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.010882497765123844;
-	if (pt >= 200 && pt < 300) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.013456921093165874;
-	if (pt >= 300 && pt < 600) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.017094610258936882;
-	if (pt >= 600 && pt < 1000) return (0.887973*((1.+(0.0523821*x))/(1.+(0.0460876*x))))-0.02186630479991436;
-      }      
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return (1.13904+-0.000594946*x+1.97303e-06*x*x+-1.38194e-09*x*x*x)*(1-(0.0996438+-8.33354e-05*x+4.74359e-08*x*x));
-      }
-    }
+void DMAnalysisTreeMaker::PFKeyIndex::build(const vector<vector<int> > & objKeys){
+  //Table size is a power of two at least twice the number of objects, so probing stays short
+  size_t cap = 16;
+  while(cap < 2*objKeys.size()) cap <<= 1;
+  mask = cap-1;
+  keys.assign(cap,0);
+  values.assign(cap,-1);
+  for(size_t o = 0; o < objKeys.size(); ++o){
+    if(objKeys.at(o).size()==0)continue;
+    int key = objKeys.at(o).at(0);
+    size_t s = slot(key);
+    while(values[s]!=-1 && keys[s]!=key) s = (s+1) & mask;
+    if(values[s]==-1){ keys[s]=key; values[s]=(int)o; }
   }
-
-  return 1.0;
-
 }
 
-double DMAnalysisTreeMaker::TagScaleFactorSubjet(string algo, int flavor, string syst, double pt){
-  double x = pt;
-
-  //Medium WP
-  if(algo == "csvm"){
-    if(syst ==  "noSyst") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return 0.629961+0.00245187*x+-3.64539e-06*x*x+2.04999e-09*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return 0.676736+0.00286128*x+-4.34618e-06*x*x+2.44485e-09*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.97841;
-	if (pt >= 120  && pt < 180 ) return 1.00499;
-	if (pt >= 180  && pt < 240 ) return 1.01106;
-	if (pt >= 240  && pt < 450 ) return 1.02189;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if (pt >= 20 && pt < 1000) return 0.582177+0.00204348*x+-2.94226e-06*x*x+1.6536e-09*x*x*x;
-      }
-    }
-
-    if(syst ==  "b_tag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 1.01236;
-	if (pt >= 120  && pt < 180 ) return 1.02287;
-	if (pt >= 180  && pt < 240 ) return 1.0347;
-	if (pt >= 240  && pt < 450 ) return 1.05521;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 1.04631;
-	if (pt >= 120  && pt < 180 ) return 1.04074;
-	if (pt >= 180  && pt < 240 ) return 1.05834;
-	if (pt >= 240  && pt < 450 ) return 1.08854;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if( pt>=20 && pt<1000) return 0.676736+0.00286128*x+-4.34618e-06*x*x+2.44485e-09*x*x*x;
-      }
-    }
-
-    if(syst ==  "b_tag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.94446;
-	if (pt >= 120  && pt < 180 ) return 0.98711;
-	if (pt >= 180  && pt < 240 ) return 0.98742;
-	if (pt >= 240  && pt < 450 ) return 0.98857;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.9105;
-	if (pt >= 120  && pt < 180 ) return 0.96924;
-	if (pt >= 180  && pt < 240 ) return 0.96378;
-	if (pt >= 240  && pt < 450 ) return 0.95524;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 0.582177+0.00204348*x+-2.94226e-06*x*x+1.6536e-09*x*x*x;
-      }
-    }
+int DMAnalysisTreeMaker::PFKeyIndex::find(int key) const {
+  if(values.empty())return -1;
+  size_t s = slot(key);
+  while(values[s]!=-1){
+    if(keys[s]==key)return values[s];
+    s = (s+1) & mask;
   }
+  return -1;
+}
 
-  //Loose WP
-  if(algo == "csvl"){
-    double x=pt;
-    if(syst ==  "noSyst") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 0.954689+0.000316059*x+3.22024e-07*x*x+-4.06201e-10*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 1.0358+0.000107516*x+9.58049e-07*x*x+-8.59906e-10*x*x*x;
-      }
-    }
-    if(syst ==  "mistag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.99839;
-	if (pt >= 120  && pt < 180 ) return 1.0022;
-	if (pt >= 180  && pt < 240 ) return 1.00468;
-	if (pt >= 240  && pt < 450 ) return 1.01764;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 0.873638+0.0005247*x+-3.15316e-07*x*x+4.83633e-11*x*x*x;
-      }
-    }
-    
-    if(syst ==  "b_tag_up") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 1.0091;
-	if (pt >= 120  && pt < 180 ) return 1.01303;
-	if (pt >= 180  && pt < 240 ) return 1.01659;
-	if (pt >= 240  && pt < 450 ) return 1.03703;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 1.01981;
-	if (pt >= 120  && pt < 180 ) return 1.02386;
-	if (pt >= 180  && pt < 240 ) return 1.02849;
-	if (pt >= 240  && pt < 450 ) return 1.05642;
-      }
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 1.0358+0.000107516*x+9.58049e-07*x*x+-8.59906e-10*x*x*x;
-      }
-    }
+void DMAnalysisTreeMaker::fillJetMuonSums(){
+  muKeyIndex.build(*muKeys);
 
-    if(syst ==  "b_tag_down") {
-      if(abs(flavor)==5){
-	if (pt >= 30   && pt < 120 ) return 0.98769;
-	if (pt >= 120  && pt < 180 ) return 0.99137;
-	if (pt >= 180  && pt < 240 ) return 0.99277;
-	if (pt >= 240  && pt < 450 ) return 0.99825;
-      }
-      if(abs(flavor)==4){
-	if (pt >= 30   && pt < 120 ) return 0.97698;
-	if (pt >= 120  && pt < 180 ) return 0.98054;
-	if (pt >= 180  && pt < 240 ) return 0.98087;
-	if (pt >= 240  && pt < 450 ) return 0.97886;
-      }      
-      if(abs(flavor)!=5 && abs(flavor)!=4){
-	if(pt>=20 && pt<1000) return 0.873638+0.0005247*x+-3.15316e-07*x*x+4.83633e-11*x*x*x;
+  string prefmu = obj_to_pref[mu_label];
+  float * mupts = vfloats_values[makeName(mu_label,prefmu,"Pt")];
+  float * muetas = vfloats_values[makeName(mu_label,prefmu,"Eta")];
+  float * muphis = vfloats_values[makeName(mu_label,prefmu,"Phi")];
+  float * mues = vfloats_values[makeName(mu_label,prefmu,"E")];
+  float * muglobals = vfloats_values[makeName(mu_label,prefmu,"IsGlobalMuon")];
+  float * mutrackers = vfloats_values[makeName(mu_label,prefmu,"IsTrackerMuon")];
+
+  size_t njets = min((size_t)max_instances[jets_label], jetKeys->size());
+  jetMuP4Sums.assign(njets, TLorentzVector(0,0,0,0));
+  for(size_t j = 0; j < njets; ++j){
+    for(size_t c = 0; c < jetKeys->at(j).size(); ++c){
+      int mk = muKeyIndex.find(jetKeys->at(j).at(c));
+      if(mk < 0 || mk >= max_instances[mu_label])continue;
+      bool muIsGlobal = muglobals[mk];
+      bool muISSAOnly = (!muIsGlobal && !mutrackers[mk]);
+      if(muIsGlobal || muISSAOnly){
+	TLorentzVector muP4_;
+	muP4_.SetPtEtaPhiE(mupts[mk],muetas[mk],muphis[mk],mues[mk]);
+	jetMuP4Sums[j] += muP4_;
       }
     }
   }
-
-  return 1.0;
-
-}
-
-float DMAnalysisTreeMaker::BTagWeight::weightWithVeto(vector<JetInfo> jetsTags, int tags, vector<JetInfo> jetsVetoes, int vetoes)
-{//This function takes into account cases where you have n b-tags and m vetoes, but they have different thresholds. 
-    if (!filter(tags))
-    {
-        //   std::cout << "nThis event should not pass the selection, what is it doing here?" << std::endl;
-        return 0;
-    }
-    int njets = jetsTags.size();
-    if(njets != (int)(jetsVetoes.size()))return 0;//jets tags and vetoes must have same size!
-    int comb = 1 << njets;
-    float pMC = 0;
-    float pData = 0;
-    for (int i = 0; i < comb; i++)
-    {
-        float mc = 1.;
-        float data = 1.;
-        int ntagged = 0;
-        for (int j = 0; j < njets; j++)
-        {
-            bool tagged = ((i >> j) & 0x1) == 1;
-            if (tagged)
-            {
-                ntagged++;
-                mc *= jetsTags[j].eff;
-                data *= jetsTags[j].eff * jetsTags[j].sf;
-            }
-            else
-            {
-                mc *= (1. - jetsVetoes[j].eff);
-                data *= (1. - jetsVetoes[j].eff * jetsVetoes[j].sf);
-            }
-        }
-
-        if (filter(ntagged))
-        {
-            //  std::cout << mc << " " << data << endl;
-            pMC += mc;
-            pData += data;
-        }
-    }
-
-    if (pMC == 0) return 0;
-    return pData / pMC;
 }
 
 bool DMAnalysisTreeMaker::isEWKID(int id){
@@ -5115,6 +3985,9 @@ double DMAnalysisTreeMaker::pileUpSF(string syst)
 }
 
 void DMAnalysisTreeMaker::endJob(){
+  cout << "DMAnalysisTreeMaker: correction payloads loaded in this job: " << loadReport.size() << endl;
+  for(size_t l = 0; l < loadReport.size(); ++l) cout << "   " << loadReport.at(l) << endl;
+  if(mt2Com.cacheCalls()) cout << "DMAnalysisTreeMaker: MT2 pairs evaluated " << mt2Com.cacheCalls() << ", from the cache " << mt2Com.cacheHits() << ", skipped by their bounds " << mt2Com.pairsSkipped() << endl;
   //  for(size_t s=0;s< systematics.size();++s){
   //    std::string syst  = systematics.at(s);
   /*  cout <<" init events are "<< nInitEvents <<endl;
@@ -39,10 +39,20 @@ public:
   math::PtEtaPhiELorentzVector top4Momentum(math::PtEtaPhiELorentzVector , math::PtEtaPhiELorentzVector, double, double );
   math::PtEtaPhiELorentzVector top4Momentum(float leptonPx, float leptonPy, float leptonPz, float leptonE, float jetPx, float jetPy, float jetPz, float jetE, float metPx, float metPy);
   math::XYZTLorentzVector NuMomentum(float leptonPx, float leptonPy, float leptonPz, float leptonPt, float leptonE, float metPx, float metPy );
+  //NuMomentum solved once per lepton and MET and reused while this object lives (one event and systematic)
+  math::XYZTLorentzVector neutrino(float leptonPx, float leptonPy, float leptonPz, float leptonE, float metPx, float metPy);
+  //top4Momentum of the lepton with each of the jets, sharing one neutrino solution
+  void top4Momenta(TLorentzVector lepton, const std::vector<TLorentzVector> & jets, double metPx, double metPy, std::vector<math::PtEtaPhiELorentzVector> & tops);
 
   double  topMtw(TLorentzVector, TLorentzVector, float metPx, float metPy);  
   double  topMtw(math::PtEtaPhiELorentzVector lepton, math::PtEtaPhiELorentzVector jet, float metPx, float metPy);  
 
+private:
+  struct NuSolution {
+    float lepton[4], met[2];
+    math::XYZTLorentzVector p4;
+  };
+  std::vector<NuSolution> nuSolutions_;
     
 
 };
@@ -63,9 +73,7 @@ math::PtEtaPhiELorentzVector TopUtilities::top4Momentum(math::PtEtaPhiELorentzVe
 //top quark 4-momentum original function given the necessary parameters
 math::PtEtaPhiELorentzVector TopUtilities::top4Momentum(float leptonPx, float leptonPy, float leptonPz, float leptonE, float jetPx, float jetPy, float jetPz, float jetE, float metPx, float metPy)
 {
-    float lepton_Pt = sqrt( (leptonPx * leptonPx) +  (leptonPy * leptonPy) );
-
-    math::XYZTLorentzVector neutrino = NuMomentum(leptonPx, leptonPy, leptonPz, lepton_Pt, leptonE, metPx, metPy); //.at(0);;
+    math::XYZTLorentzVector neutrino = this->neutrino(leptonPx, leptonPy, leptonPz, leptonE, metPx, metPy); //.at(0);;
 
     math::XYZTLorentzVector lep(leptonPx, leptonPy, leptonPz, leptonE);
     math::XYZTLorentzVector jet(jetPx, jetPy, jetPz, jetE);
@@ -74,6 +82,35 @@ math::PtEtaPhiELorentzVector TopUtilities::top4Momentum(float leptonPx, float le
     return math::PtEtaPhiELorentzVector(top.pt(), top.eta(), top.phi(), top.E());
 }
 
+math::XYZTLorentzVector TopUtilities::neutrino(float leptonPx, float leptonPy, float leptonPz, float leptonE, float metPx, float metPy)
+{
+    for (size_t i = 0; i < nuSolutions_.size(); ++i)
+    {
+        const NuSolution & nu = nuSolutions_[i];
+        if (nu.lepton[0] == leptonPx && nu.lepton[1] == leptonPy && nu.lepton[2] == leptonPz && nu.lepton[3] == leptonE && nu.met[0] == metPx && nu.met[1] == metPy) return nu.p4;
+    }
+    float lepton_Pt = sqrt( (leptonPx * leptonPx) +  (leptonPy * leptonPy) );
+    NuSolution nu = {{leptonPx, leptonPy, leptonPz, leptonE}, {metPx, metPy}, NuMomentum(leptonPx, leptonPy, leptonPz, lepton_Pt, leptonE, metPx, metPy)};
+    nuSolutions_.push_back(nu);
+    return nu.p4;
+}
+
+//same conversions as top4Momentum(TLorentzVector, TLorentzVector, double, double), so the results are identical
+void TopUtilities::top4Momenta(TLorentzVector lepton, const std::vector<TLorentzVector> & jets, double metPx, double metPy, std::vector<math::PtEtaPhiELorentzVector> & tops)
+{
+    tops.clear();
+    math::PtEtaPhiELorentzVector lep(lepton.Pt(),lepton.Eta(),lepton.Phi(),lepton.Energy());
+    float leptonPx = lep.px(), leptonPy = lep.py(), leptonPz = lep.pz(), leptonE = lep.energy();
+    math::XYZTLorentzVector lep4 = math::XYZTLorentzVector(leptonPx, leptonPy, leptonPz, leptonE);
+    math::XYZTLorentzVector nu = neutrino(leptonPx, leptonPy, leptonPz, leptonE, metPx, metPy);
+    for (size_t j = 0; j < jets.size(); ++j)
+    {
+        math::PtEtaPhiELorentzVector bjet(jets[j].Pt(),jets[j].Eta(),jets[j].Phi(),jets[j].Energy());
+        math::XYZTLorentzVector jet((float)bjet.px(), (float)bjet.py(), (float)bjet.pz(), (float)bjet.energy());
+        math::XYZTLorentzVector top = lep4 + jet + nu;
+        tops.push_back(math::PtEtaPhiELorentzVector(top.pt(), top.eta(), top.phi(), top.E()));
+    }
+}
 
 /////What it does:
 //w boson mass put to pdg value
@@ -0,0 +1,157 @@
+#ifndef _Eta_Phi_Index_h_
+#define _Eta_Phi_Index_h_
+
+/**
+ *\Function EtaPhiIndex:
+ *
+ * Per-event index of objects in (eta, phi) for the cross-collection Delta R
+ * searches (lepton cleaning, jet-lepton overlap, AK8-AK4 and subjet-fat jet
+ * matching). Eta and phi are computed once per object and the queries compare
+ * squared Delta R. Above sortThreshold objects the index is sorted in phi, so
+ * a query only visits the window [phi - dR, phi + dR] wrapped at +-pi; below
+ * it a linear scan is faster. Objects are referred to by their insertion order.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<algorithm>
+#include<utility>
+#include<cmath>
+
+class EtaPhiIndex {
+
+public:
+  EtaPhiIndex(): sorted_(false){;}
+  ~EtaPhiIndex(){;}
+
+  //Sorting pays only for many narrow queries: at the 5-40 objects of an event a linear scan wins
+  enum { sortThreshold = 64 };
+
+  void clear(){ points_.clear(); sorted_ = false; }
+  //Object number size() before the call
+  void add(double eta, double phi);
+  //To be called after the last add and before the queries
+  void build(){ sorted_ = points_.size() > sortThreshold; if(sorted_) std::sort(points_.begin(), points_.end()); }
+  size_t size() const { return points_.size(); }
+
+  //Closest object with minDR < Delta R <= maxDR, -1 if none; equal distances go to the first added
+  int nearest(double eta, double phi, double maxDR, double minDR = -1.) const;
+  //Smallest squared Delta R to any object, maxDR2 if none is closer
+  double minDR2(double eta, double phi, double maxDR2 = 1.e6) const;
+  //Objects with Delta R <= dR, in insertion order
+  void within(double eta, double phi, double dR, std::vector<int> & result) const;
+  //(object of this, object of other) pairs with Delta R <= dR, ordered by the first then the second index
+  void allPairsWithin(const EtaPhiIndex & other, double dR, std::vector< std::pair<int,int> > & result) const;
+
+  static double deltaPhi(double phi1, double phi2);
+  static double deltaR2(double eta1, double phi1, double eta2, double phi2){ double deta = eta1 - eta2, dphi = deltaPhi(phi1, phi2); return deta * deta + dphi * dphi; }
+
+private:
+  struct Point {
+    double phi, eta;
+    int index;
+    bool operator<(const Point & p) const { return phi < p.phi || (phi == p.phi && index < p.index); }
+  };
+  std::vector<Point> points_;
+  bool sorted_;
+
+  static double wrap(double phi);
+  //Calls f(point) for the points in the phi window of half width dPhi around phi
+  template<class F> void scan(double phi, double dPhi, F & f) const;
+};
+
+inline double EtaPhiIndex::wrap(double phi){
+  while(phi >= M_PI) phi -= 2. * M_PI;
+  while(phi < -M_PI) phi += 2. * M_PI;
+  return phi;
+}
+
+inline double EtaPhiIndex::deltaPhi(double phi1, double phi2){
+  return wrap(phi1 - phi2);
+}
+
+inline void EtaPhiIndex::add(double eta, double phi){
+  Point p;
+  p.phi = wrap(phi);
+  p.eta = eta;
+  p.index = points_.size();
+  points_.push_back(p);
+  sorted_ = false;
+}
+
+template<class F> inline void EtaPhiIndex::scan(double phi, double dPhi, F & f) const {
+  if(points_.empty()) return;
+  if(!sorted_ || dPhi >= M_PI){
+    for(size_t i = 0; i < points_.size(); ++i) f(points_[i]);
+    return;
+  }
+  phi = wrap(phi);
+  double lo = phi - dPhi, hi = phi + dPhi;
+  //at most two contiguous ranges in [-pi, pi)
+  double ranges[2][2] = {{lo, hi}, {1., 0.}};
+  if(lo < -M_PI){ ranges[0][0] = -M_PI; ranges[1][0] = lo + 2. * M_PI; ranges[1][1] = M_PI; }
+  else if(hi >= M_PI){ ranges[0][1] = M_PI; ranges[1][0] = -M_PI; ranges[1][1] = hi - 2. * M_PI; }
+  for(int r = 0; r < 2; ++r){
+    if(ranges[r][0] > ranges[r][1]) continue;
+    Point key;
+    key.phi = ranges[r][0];
+    key.eta = 0.;
+    key.index = -1;
+    for(std::vector<Point>::const_iterator it = std::lower_bound(points_.begin(), points_.end(), key); it != points_.end() && it->phi <= ranges[r][1]; ++it) f(*it);
+  }
+}
+
+namespace etaPhiIndex {
+  struct Nearest {
+    double eta, phi, min2, max2, best2;
+    int best;
+    template<class P> void operator()(const P & p){
+      double d2 = EtaPhiIndex::deltaR2(eta, phi, p.eta, p.phi);
+      if(d2 <= min2 || d2 > max2) return;
+      if(best < 0 || d2 < best2 || (d2 == best2 && p.index < best)){ best2 = d2; best = p.index; }
+    }
+  };
+  struct MinDR2 {
+    double eta, phi, best2;
+    template<class P> void operator()(const P & p){ double d2 = EtaPhiIndex::deltaR2(eta, phi, p.eta, p.phi); if(d2 < best2) best2 = d2; }
+  };
+  struct Within {
+    double eta, phi, max2;
+    std::vector<int> * result;
+    template<class P> void operator()(const P & p){ if(EtaPhiIndex::deltaR2(eta, phi, p.eta, p.phi) <= max2) result->push_back(p.index); }
+  };
+}
+
+inline int EtaPhiIndex::nearest(double eta, double phi, double maxDR, double minDR) const {
+  etaPhiIndex::Nearest f = {eta, phi, minDR < 0. ? -1. : minDR * minDR, maxDR * maxDR, 0., -1};
+  scan(phi, maxDR, f);
+  return f.best;
+}
+
+inline double EtaPhiIndex::minDR2(double eta, double phi, double maxDR2) const {
+  etaPhiIndex::MinDR2 f = {eta, phi, maxDR2};
+  scan(phi, sorted_ ? sqrt(maxDR2) : M_PI, f);
+  return f.best2;
+}
+
+inline void EtaPhiIndex::within(double eta, double phi, double dR, std::vector<int> & result) const {
+  result.clear();
+  etaPhiIndex::Within f = {eta, phi, dR * dR, &result};
+  scan(phi, dR, f);
+  if(sorted_) std::sort(result.begin(), result.end());//unsorted, the scan is in insertion order
+}
+
+inline void EtaPhiIndex::allPairsWithin(const EtaPhiIndex & other, double dR, std::vector< std::pair<int,int> > & result) const {
+  result.clear();
+  std::vector<int> matches;
+  for(size_t i = 0; i < points_.size(); ++i){
+    other.within(points_[i].eta, points_[i].phi, dR, matches);
+    for(size_t k = 0; k < matches.size(); ++k) result.push_back(std::make_pair(points_[i].index, matches[k]));
+  }
+  if(sorted_) std::sort(result.begin(), result.end());
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef _Jet_Correction_Chain_h_
+#define _Jet_Correction_Chain_h_
+
+/**
+ *\Function JetCorrectionChain:
+ *
+ * Text-file jet energy corrections for one jet algorithm (AK4PFchs, AK8PFPuppi, ...):
+ * full L1L2L3(+residuals) chain, L1 only, L2L3(+residuals) without L1 and the
+ * total uncertainty. The same object can be shared by all the collections
+ * using the same algorithm.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<string>
+#include<vector>
+
+#include "CondFormats/JetMETObjects/interface/FactorizedJetCorrector.h"
+#include "CondFormats/JetMETObjects/interface/JetCorrectionUncertainty.h"
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParameters.h"
+
+class JetCorrectionChain {
+
+public:
+  //payloads are read as payloadPrefix+"L1FastJet_"+algo+".txt" etc., the uncertainty as uncPrefix+"UncertaintySources_"+algo+".txt"
+  JetCorrectionChain(std::string algo, std::string payloadPrefix, std::string uncPrefix, bool addResiduals);
+  ~JetCorrectionChain();
+
+  std::string algo() const { return algo_; }
+
+  double correction(double pt, double eta, double phi, double e, double area, double rho, double npv){ return evaluate(full_, pt, eta, phi, e, area, rho, npv); }
+  double correctionL1(double pt, double eta, double phi, double e, double area, double rho, double npv){ return evaluate(l1_, pt, eta, phi, e, area, rho, npv); }
+  double correctionNoL1(double pt, double eta, double phi, double e, double area, double rho, double npv){ return evaluate(noL1_, pt, eta, phi, e, area, rho, npv); }
+  //Signed relative jes__up/jes__down shift, 0 for the other systematics
+  double uncertainty(double pt, double eta, std::string syst);
+
+private:
+  std::string algo_;
+  FactorizedJetCorrector *full_, *l1_, *noL1_;
+  JetCorrectionUncertainty *unc_;
+
+  static double evaluate(FactorizedJetCorrector * corr, double pt, double eta, double phi, double e, double area, double rho, double npv);
+};
+
+inline JetCorrectionChain::JetCorrectionChain(std::string algo, std::string payloadPrefix, std::string uncPrefix, bool addResiduals): algo_(algo){
+  JetCorrectorParameters parsL1(payloadPrefix+"L1FastJet_"+algo+".txt");
+  JetCorrectorParameters parsL2(payloadPrefix+"L2Relative_"+algo+".txt");
+  JetCorrectorParameters parsL3(payloadPrefix+"L3Absolute_"+algo+".txt");
+
+  std::vector<JetCorrectorParameters> parsFull, parsL1Only, parsNoL1;
+  parsFull.push_back(parsL1);
+  parsFull.push_back(parsL2);
+  parsFull.push_back(parsL3);
+  parsL1Only.push_back(parsL1);
+  parsNoL1.push_back(parsL2);
+  parsNoL1.push_back(parsL3);
+  if(addResiduals){
+    JetCorrectorParameters parsRes(payloadPrefix+"L2L3Residual_"+algo+".txt");
+    parsFull.push_back(parsRes);
+    parsNoL1.push_back(parsRes);
+  }
+
+  full_ = new FactorizedJetCorrector(parsFull);
+  l1_ = new FactorizedJetCorrector(parsL1Only);
+  noL1_ = new FactorizedJetCorrector(parsNoL1);
+
+  JetCorrectorParameters parsUnc(uncPrefix+"UncertaintySources_"+algo+".txt", "Total");
+  unc_ = new JetCorrectionUncertainty(parsUnc);
+}
+
+inline JetCorrectionChain::~JetCorrectionChain(){
+  delete full_;
+  delete l1_;
+  delete noL1_;
+  delete unc_;
+}
+
+inline double JetCorrectionChain::evaluate(FactorizedJetCorrector * corr, double pt, double eta, double phi, double e, double area, double rho, double npv){
+  corr->setJetPhi(phi);
+  corr->setJetEta(eta);
+  corr->setJetE(e);
+  corr->setJetPt(pt);
+  corr->setJetA(area);
+  corr->setRho(rho);
+  corr->setNPV(npv);
+  return corr->getCorrection();
+}
+
+inline double JetCorrectionChain::uncertainty(double ptCorr, double eta, std::string syst){
+  if(ptCorr<0)return ptCorr;
+  if(syst == "jes__up" || syst == "jes__down"){
+    double fac = 1.;
+    if (syst == "jes__down")fac = -1.;
+    unc_->setJetEta(eta);
+    unc_->setJetPt(ptCorr);
+    return unc_->getUncertainty(true)*fac;
+  }
+  return 0.0;
+}
+
+#endif
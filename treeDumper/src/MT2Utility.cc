@@ -34,6 +34,7 @@
 #include <math.h>
 //#include "EventReco/interface/MT2Utility.h"
 #include "MT2Utility.h"
+#include "PolynomialRoots.h"
 
 using namespace std;
 
@@ -296,44 +297,8 @@ int mt2::nsols_massless(double Dsq)
   A1 = (2*b*b2+2*e2)/(Easq*Ea);
   A0 = (a2*b*b+2*b*d2+f2)/(Easq*Easq);
  
-  /*
-  long  double A0sq, A1sq, A2sq, A4sq;
-  A0sq = A0*A0;
-  A1sq = A1*A1;
-  A2sq = A2*A2;
-  A4sq = A4*A4;
-  */
-  long double A3sq;
-  A3sq = A3*A3;
-
-  long double B3, B2, B1, B0;
-  B3 = 4*A4;
-  B2 = 3*A3;
-  B1 = 2*A2;
-  B0 = A1;
-  long double C2, C1, C0;
-  C2 = -(A2/2 - 3*A3sq/(16*A4));
-  C1 = -(3*A1/4. -A2*A3/(8*A4));
-  C0 = -A0 + A1*A3/(16*A4);
-  long double  D1, D0;
-  D1 = -B1 - (B3*C1*C1/C2 - B3*C0 -B2*C1)/C2;
-  D0 = -B0 - B3 *C0 *C1/(C2*C2)+ B2*C0/C2;
- 
-  long double E0;
-  E0 = -C0 - C2*D0*D0/(D1*D1) + C1*D0/D1;
- 
-  long  double t1,t2,t3,t4,t5;
-   
-//find the coefficients for the leading term in the Sturm sequence  
-   t1 = A4;
-   t2 = A4;
-   t3 = C2;
-   t4 = D1;
-   t5 = E0;
-  
-   int nsol;
-   nsol = signchange_n(t1,t2,t3,t4,t5)-signchange_p(t1,t2,t3,t4,t5);
-   if( nsol < 0 ) nsol=0;
+  //Number of real solutions from the Sturm sequence of the quartic
+  int nsol = polyroots::quarticRealRootCount<long double>(A4, A3, A2, A1, A0);
 
    return nsol;
   
@@ -602,73 +567,12 @@ int mt2::nsols(  double Dsq)
    4*a2*d1*d1*f2 - 4*a1*d1*d2*f2 - 2*a1*a2*f1*f2 + 
      a1*a1*f2*f2)/(Easq*Easq);
   
-   /*
-   long  double A0sq, A1sq, A2sq, A4sq;
-   A0sq = A0*A0;
-   A1sq = A1*A1;
-   A2sq = A2*A2;
-   A4sq = A4*A4;
-   */
-   long double A3sq;
-   A3sq = A3*A3;
-   
-   long double B3, B2, B1, B0;
-   B3 = 4*A4;
-   B2 = 3*A3;
-   B1 = 2*A2;
-   B0 = A1;
-   
-   long double C2, C1, C0;
-   C2 = -(A2/2 - 3*A3sq/(16*A4));
-   C1 = -(3*A1/4. -A2*A3/(8*A4));
-   C0 = -A0 + A1*A3/(16*A4);
-   
-   long double D1, D0;
-   D1 = -B1 - (B3*C1*C1/C2 - B3*C0 -B2*C1)/C2;
-   D0 = -B0 - B3 *C0 *C1/(C2*C2)+ B2*C0/C2;
-   
-   long double E0;
-   E0 = -C0 - C2*D0*D0/(D1*D1) + C1*D0/D1;
-   
-   long  double t1,t2,t3,t4,t5;
-//find the coefficients for the leading term in the Sturm sequence  
-   t1 = A4;
-   t2 = A4;
-   t3 = C2;
-   t4 = D1;
-   t5 = E0;
- 
-
-//The number of solutions depends on diffence of number of sign changes for x->Inf and x->-Inf
-   int nsol;
-   nsol = signchange_n(t1,t2,t3,t4,t5) - signchange_p(t1,t2,t3,t4,t5);
-
-//Cannot have negative number of solutions, must be roundoff effect
-   if (nsol < 0) nsol = 0;
+   //Number of real solutions from the Sturm sequence of the quartic
+   int nsol = polyroots::quarticRealRootCount<long double>(A4, A3, A2, A1, A0);
 
    return nsol;
   
 }  
 
-inline int mt2::signchange_n( long double t1, long double t2, long double t3, long double t4, long double t5)
-{
-   int nsc;
-   nsc=0;
-   if(t1*t2>0) nsc++;
-   if(t2*t3>0) nsc++;
-   if(t3*t4>0) nsc++;
-   if(t4*t5>0) nsc++;
-   return nsc;
-}
-inline int mt2::signchange_p( long double t1, long double t2, long double t3, long double t4, long double t5)
-{
-   int nsc;
-   nsc=0;
-   if(t1*t2<0) nsc++;
-   if(t2*t3<0) nsc++;
-   if(t3*t4<0) nsc++;
-   if(t4*t5<0) nsc++;
-   return nsc;
-}
 
 }//end namespace mt2_bisect
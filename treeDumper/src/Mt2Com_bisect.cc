@@ -1,9 +1,25 @@
 //#include "EventReco/interface/Mt2Com_bisect.h"
 #include "Mt2Com_bisect.h"
 
-Mt2Com_bisect::Mt2Com_bisect(){}
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+Mt2Com_bisect::Mt2Com_bisect(): cacheHits_(0), cacheCalls_(0), pairsSkipped_(0){
+  CacheEntry empty;
+  memset(&empty, 0, sizeof(empty));
+  empty.type = -1;
+  cache_.assign(cacheSize, empty);
+}
 Mt2Com_bisect::~Mt2Com_bisect(){}
 
+Mt2Com_bisect::Mt2Type Mt2Com_bisect::type(const string& mt2type){
+  if (mt2type == "MT2w") return MT2w;
+  if (mt2type == "MT2bl") return MT2bl;
+  if (mt2type == "MT2b") return MT2b;
+  return nMt2Types;
+}
+
 //###########################################
 //    Global Functions
 //###########################################
@@ -31,15 +47,16 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
 				    const TLorentzVector leptonInput,
 				    TVector2 vecMet,
 				    string mt2type)
- {
-
-// double Mt2Com_bisect::calculateMT2w(const std::vector<IPHCTree::NTJet>& jets, 
-//                                     const std::vector<IPHCTree::NTJet>& bjets, 
-//                                     const TLorentzVector leptonInput, 
-//                                     TVector2 vecMet,
-//                                     string mt2type)
+{
+  return calculateMT2w(jets, bjets, leptonInput, vecMet, type(mt2type));
+}
 
-// {
+double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
+				    const std::vector<TLorentzVector>& bjets,
+				    const TLorentzVector& leptonInput,
+				    const TVector2& vecMet,
+				    Mt2Type mt2type)
+ {
 
     //Variables
     metval = vecMet.Mod();
@@ -51,6 +68,66 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
     // require at least 2 jets
     if ( jets.size()<2 ) return 99999.; 
 
+    makePairs(jets, bjets);
+
+    float min_mt2w = 9999;
+    for (size_t p = 0; p < pairs_.size(); ++p)
+    {
+      float c_mt2w = Mt2Com_bisect::mt2wWrapper(lep, *pairs_[p].first, *pairs_[p].second, metval, metphi, mt2type);
+      if (c_mt2w < min_mt2w) min_mt2w = c_mt2w;
+    }
+    return min_mt2w;
+}
+
+
+void Mt2Com_bisect::calculateMT2(const std::vector<TLorentzVector>& jets,
+				 const std::vector<TLorentzVector>& bjets,
+				 const TLorentzVector& leptonInput,
+				 const TVector2& vecMet,
+				 double result[nMt2Types])
+{
+    metval = vecMet.Mod();
+    metphi = vecMet.Phi();
+    lep = leptonInput;
+
+    if ( jets.size()<2 ) {
+      for (int t = 0; t < nMt2Types; ++t) result[t] = 99999.;
+      return;
+    }
+
+    makePairs(jets, bjets);
+    size_t n = pairs_.size();
+    bounds_.resize(n*nMt2Types);
+    for (size_t p = 0; p < n; ++p) pairBounds(*pairs_[p].first, *pairs_[p].second, &bounds_[p*nMt2Types]);
+
+    for (int t = 0; t < nMt2Types; ++t)
+    {
+      // insertion sort of the few pairs by their bound
+      order_.resize(n);
+      for (size_t p = 0; p < n; ++p)
+      {
+        size_t k = p;
+        for (; k > 0 && bounds_[order_[k-1]*nMt2Types + t] > bounds_[p*nMt2Types + t]; --k) order_[k] = order_[k-1];
+        order_[k] = p;
+      }
+      float min_mt2 = 9999;
+      for (size_t k = 0; k < n; ++k)
+      {
+        int p = order_[k];
+        if (bounds_[p*nMt2Types + t] >= min_mt2) { pairsSkipped_ += n - k; break; }
+        float c_mt2 = Mt2Com_bisect::mt2wWrapper(lep, *pairs_[p].first, *pairs_[p].second, metval, metphi, Mt2Type(t));
+        if (c_mt2 < min_mt2) min_mt2 = c_mt2;
+      }
+      result[t] = min_mt2;
+    }
+}
+
+
+void Mt2Com_bisect::makePairs(const std::vector<TLorentzVector>& jets,
+			      const std::vector<TLorentzVector>& bjets)
+{
+    pairs_.clear();
+
     n_btag = (int) bjets.size();
 
     // We do different things depending on the number of b-tagged jets
@@ -61,18 +138,6 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
 
     int n_jets = int(jets.size());
     
-//     if(entry_ == 58469) {
-//       cout<<"check all jets/bjet " << jets.size()<<" "<<bjets.size()<<endl; 
-//       for(int j=0; j<int(jets.size()); j++){
-// 	cout<<" jets " << jets[j].X()<<" "<< jets[j].Y()<<" "<<jets[j].Z()<<" "<<jets[j].E()<<endl; 
-//       }
-//       for(int j=0; j<int(bjets.size()); j++){
-//         cout<<" jets " << bjets[j].X()<<" "<< bjets[j].Y()<<" "<<bjets[j].Z()<<" "<<bjets[j].E()<<endl;
-//       }
-      
-//     }
-    
-    
     // -------
     // 0 bTag
     // -------
@@ -81,17 +146,12 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
     {
       // If no b-jets select the minimum of the mt2w from all combinations with 
       // the three leading jets
-      float min_mt2w = 9999;
-      
       for (int i=0; i<nMax && i < n_jets; i++)  //fixed by Yang (it<n_jets)
 	for (int j=0; j<nMax && j< n_jets; j++)
 	  {
           if (i == j) continue;
-          float c_mt2w = Mt2Com_bisect::mt2wWrapper(lep, jets[i], jets[j], metval, metphi, mt2type);
-          if (c_mt2w < min_mt2w)
-          min_mt2w = c_mt2w;
+          pairs_.push_back(std::make_pair(&jets[i], &jets[j]));
       }
-      return min_mt2w;
     }
     // -------
     // 1 bTag
@@ -99,7 +159,6 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
     else if (n_btag == 1 )
     {
       // if only one b-jet choose the three non-b leading jets and choose the smaller
-      float min_mt2w = 9999;
       int it(0);
       int ctr(0);
 
@@ -107,10 +166,7 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
 	{
 	if (bjets[0]!=jets[it]) 
 	  {
-	    ///if(entry_ == 58469) cout<<"it " << it <<endl; 
-
-	    float c_mt2w = Mt2Com_bisect::mt2wWrapper(lep, bjets[0], jets[it], metval, metphi, mt2type);
-	    if (c_mt2w < min_mt2w) min_mt2w = c_mt2w;
+	    pairs_.push_back(std::make_pair(&bjets[0], &jets[it]));
 	    ctr ++;
 	    it ++;
 	  }
@@ -122,16 +178,12 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
       {
             if (bjets[0]!=jets[it])
             {
-	      ///if(entry_ == 58469) cout<<"it2 " << it <<endl;
-
-	      float c_mt2w = Mt2Com_bisect::mt2wWrapper(lep, jets[it], bjets[0], metval, metphi, mt2type);
-                if (c_mt2w < min_mt2w) min_mt2w = c_mt2w;
+	      pairs_.push_back(std::make_pair(&jets[it], &bjets[0]));
                 ctr ++;
                 it ++;
             }
             else it ++;
       }
-      return min_mt2w;
     } 
     // -------
     // 2 bTag
@@ -140,82 +192,107 @@ double Mt2Com_bisect::calculateMT2w(const std::vector<TLorentzVector>& jets,
     {
       // if 3 or more b-jets the paper says ignore b-tag and do like 0-bjets 
       // but we are going to make the combinations with the b-jets
-      float min_mt2w = 9999;
       for (int i=0; i<n_btag; i++)
         for (int j=0; j<n_btag; j++)
         {
           if (i == j) continue;
-          float c_mt2w = Mt2Com_bisect::mt2wWrapper(lep, bjets[i], bjets[j], metval, metphi, mt2type);
-	  //	  cout<<" c_mt2w " << c_mt2w <<" "<<metphi<<endl;
-
-          if (c_mt2w < min_mt2w)
-          min_mt2w = c_mt2w;
+          pairs_.push_back(std::make_pair(&bjets[i], &bjets[j]));
         }
-      return min_mt2w;
     }
-
-    return -1.;
 }
 
 
+// Each variable is at least the largest sum of visible and invisible masses of a side; MT2w is also
+// above the m(b1 l) endpoint bound. Margins: the precision of mt2w, the massless approximation below
+// MIN_MASS and the rounding of the scaled MT2 solvers.
+void Mt2Com_bisect::pairBounds(const TLorentzVector& jet_o, const TLorentzVector& jet_b, double bounds[nMt2Types])
+{
+    double ex = lep.E() + jet_o.E(), px = lep.Px() + jet_o.Px(), py = lep.Py() + jet_o.Py(), pz = lep.Pz() + jet_o.Pz();
+    double mbl = sqrt(std::max(0., ex*ex - px*px - py*py - pz*pz));
+    double mo = fabs(jet_o.M()), mb = fabs(jet_b.M());
+
+    metx = metval * cos( metphi );
+    mety = metval * sin( metphi );
+    pl[0]= lep.E(); pl[1]= lep.Px(); pl[2]= lep.Py(); pl[3]= lep.Pz();
+    pb1[0] = jet_o.E(); pb1[1] = jet_o.Px();  pb1[2] = jet_o.Py();   pb1[3] = jet_o.Pz();
+    pb2[0] = jet_b.E(); pb2[1] = jet_b.Px();  pb2[2] = jet_b.Py();   pb2[3] = jet_b.Pz();
+    pmiss[0] = 0.; pmiss[1] = metx; pmiss[2] = mety;
+    mt2w::set_momenta(pl, pb1, pb2, pmiss);
+
+    bounds[MT2w] = mt2w::get_lower_bound() - mt2w::get_precision();
+    bounds[MT2bl] = std::max(mbl, mb + 80.4)*(1. - 1.e-6) - MIN_MASS;
+    bounds[MT2b] = (std::max(mo, mb) + 80.385)*(1. - 1.e-6) - MIN_MASS;
+}
+
 
 
 // This funcion is a wrapper for mt2w_bisect etc that takes LorentzVectors instead of doubles
 double Mt2Com_bisect::mt2wWrapper(TLorentzVector& lep, const TLorentzVector& jet_o,
                                                                     const TLorentzVector& jet_b, float& metval, float& metphi,
                                                                     string& mt2type){
+    return mt2wWrapper(lep, jet_o, jet_b, metval, metphi, type(mt2type));
+}
+
+double Mt2Com_bisect::mt2wWrapper(const TLorentzVector& lep, const TLorentzVector& jet_o,
+                                  const TLorentzVector& jet_b, float metval, float metphi,
+                                  Mt2Type mt2type){
+
+    if (mt2type == nMt2Types) return -1.;
 
     // same for all MT2x variables
     metx = metval * cos( metphi );
     mety = metval * sin( metphi );
 
-    
-//     if(entry_ == 58469) {
-//       cout<<" metx/y " << metx <<" "<<mety <<endl;
-//       cout<<" mt2wWrapper  jet_b " <<  jet_b.X()<<" "<<jet_b.Y()<<" "<<jet_b.Z()<<" "<<jet_b.E()<<endl;
-//     }
-    
-
     pl[0]= lep.E(); pl[1]= lep.Px(); pl[2]= lep.Py(); pl[3]= lep.Pz();
-    pb1[1] = jet_o.Px();  pb1[2] = jet_o.Py();   pb1[3] = jet_o.Pz();
-    pb2[1] = jet_b.Px();  pb2[2] = jet_b.Py();   pb2[3] = jet_b.Pz();
+    pb1[0] = jet_o.E(); pb1[1] = jet_o.Px();  pb1[2] = jet_o.Py();   pb1[3] = jet_o.Pz();
+    pb2[0] = jet_b.E(); pb2[1] = jet_b.Px();  pb2[2] = jet_b.Py();   pb2[3] = jet_b.Pz();
     pmiss[0] = 0.; pmiss[1] = metx; pmiss[2] = mety;
 
+    // exact inputs as key, direct mapped: a colliding entry is overwritten
+    double key[14];
+    memcpy(key, pl, sizeof(pl));
+    memcpy(key + 4, pb1, sizeof(pb1));
+    memcpy(key + 8, pb2, sizeof(pb2));
+    key[12] = pmiss[1]; key[13] = pmiss[2];
+    unsigned long long hash = 1469598103934665603ULL + mt2type;
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(key);
+    for (size_t b = 0; b < sizeof(key); ++b) hash = (hash ^ bytes[b]) * 1099511628211ULL;
+    CacheEntry & entry = cache_[(hash ^ (hash >> 32)) & (cacheSize - 1)];
+
+    ++cacheCalls_;
+    if (entry.type == mt2type && memcmp(entry.key, key, sizeof(key)) == 0) {
+      ++cacheHits_;
+      return entry.value;
+    }
+    double value = solve(mt2type, jet_o, jet_b);
+    memcpy(entry.key, key, sizeof(key));
+    entry.type = mt2type;
+    entry.value = value;
+    return value;
+}
+
+// pl, pb1, pb2 and pmiss are set by mt2wWrapper
+double Mt2Com_bisect::solve(Mt2Type mt2type, const TLorentzVector& jet_o, const TLorentzVector& jet_b){
+
     // specifics for each variable
-    if (mt2type == "MT2b") 
-    {
+    switch (mt2type) {
+    case MT2b:
       pmiss_lep[0] = 0.;
       pmiss_lep[1] = pmiss[1]+pl[1]; pmiss_lep[2] = pmiss[2]+pl[2];
 
       pb1[0] = jet_o.M();
       pb2[0] = jet_b.M();
 
-      //mt2_bisect::mt2 mt2_event;
       mt2::set_momenta( pb1, pb2, pmiss_lep );
       mt2::set_mn( 80.385 );   // Invisible particle mass == W mass
       return mt2::get_mt2();
+    case MT2bl:
+      mt2bl::set_momenta(pl, pb1, pb2, pmiss);
+      return mt2bl::get_mt2bl();
+    case MT2w:
+      mt2w::set_momenta(pl, pb1, pb2, pmiss);
+      return mt2w::get_mt2w();
+    default:
+      return -1.;
     }
-
-    else 
-    {
-      pb1[0] = jet_o.E();
-      pb2[0] = jet_b.E();
-
-      if (mt2type == "MT2bl") 
-      {
-
-	//	if(entry_ == 58469) cout<<" check "<< entry_ <<endl; 
-
-        mt2bl::set_momenta(pl, pb1, pb2, pmiss);
-        return mt2bl::get_mt2bl();
-      }
-      else if (mt2type == "MT2w") 
-      {
-        mt2w::set_momenta(pl, pb1, pb2, pmiss);
-        return mt2w::get_mt2w();
-      }
-    }
-
-    return -1.;
 }
-
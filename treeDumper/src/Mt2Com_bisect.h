@@ -11,6 +11,7 @@
 #include "mt2bl_bisect.h"
 #include "mt2w_bisect.h"
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -20,8 +21,13 @@ class Mt2Com_bisect : public mt2bl_bisect::mt2bl,
 {
     public:
     
+    enum Mt2Type { MT2w = 0, MT2bl, MT2b, nMt2Types };
+
     Mt2Com_bisect();
     ~Mt2Com_bisect();
+
+    //nMt2Types for an unknown name
+    static Mt2Type type(const string& mt2type);
     
 /*     double calculateMT2w(const std::vector<TLorentzVector>& jets,  */
 /*                          const std::vector<TLorentzVector>& bjets,  */
@@ -36,11 +42,36 @@ class Mt2Com_bisect : public mt2bl_bisect::mt2bl,
                          TVector2 vecMet,
                          string mt2type);
 
+    double calculateMT2w(const std::vector<TLorentzVector>& jets, 
+                         const std::vector<TLorentzVector>& bjets, 
+                         const TLorentzVector& leptonInput, 
+                         const TVector2& vecMet,
+                         Mt2Type mt2type);
+
+
+    //MT2w, MT2bl and MT2b (indexed by Mt2Type) over the jet pairs of calculateMT2w, built once. For each
+    //variable the pairs go by increasing lower bound and stop once the bound reaches the minimum found
+    void calculateMT2(const std::vector<TLorentzVector>& jets, 
+                      const std::vector<TLorentzVector>& bjets, 
+                      const TLorentzVector& leptonInput, 
+                      const TVector2& vecMet,
+                      double result[nMt2Types]);
 
     double mt2wWrapper(TLorentzVector& lep, const TLorentzVector& jet_o,
                        const TLorentzVector& jet_b, float& met, float& metphi,
                        string& mt2type);
 
+    double mt2wWrapper(const TLorentzVector& lep, const TLorentzVector& jet_o,
+                       const TLorentzVector& jet_b, float metval, float metphi,
+                       Mt2Type mt2type);
+
+    //Results are cached on the exact lepton, jet and MET inputs in a fixed size table,
+    //so repeated inputs (e.g. systematics not touching them) are solved once. The key is ordered: the two
+    //jet orderings of a pair are different MT2 problems and are solved separately
+    size_t cacheHits() const { return cacheHits_; }
+    size_t cacheCalls() const { return cacheCalls_; }
+    size_t pairsSkipped() const { return pairsSkipped_; }
+
     private:
     
     std::vector<TLorentzVector> jets; 
@@ -64,6 +95,24 @@ class Mt2Com_bisect : public mt2bl_bisect::mt2bl,
     double pmiss_lep[3];
     double pmiss[3];  // <unused>, pmx, pmy   missing pT
 
+    enum { cacheSize = 1024 };//power of two
+    struct CacheEntry {
+      double key[14];//pl, pb1, pb2 (E, px, py, pz), pmx, pmy
+      int type;//-1 if empty
+      double value;
+    };
+    std::vector<CacheEntry> cache_;
+    size_t cacheHits_, cacheCalls_;
+    double solve(Mt2Type mt2type, const TLorentzVector& jet_o, const TLorentzVector& jet_b);
+
+    //(jet_o, jet_b) pairs of the arXiv:1203.4813 recipe
+    std::vector< std::pair<const TLorentzVector*, const TLorentzVector*> > pairs_;
+    void makePairs(const std::vector<TLorentzVector>& jets, const std::vector<TLorentzVector>& bjets);
+    //Lower bounds of the three variables for a pair, with margins for the precision of the solvers
+    void pairBounds(const TLorentzVector& jet_o, const TLorentzVector& jet_b, double bounds[nMt2Types]);
+    std::vector<double> bounds_;
+    std::vector<int> order_;
+    size_t pairsSkipped_;
 
 };
 #endif
@@ -0,0 +1,234 @@
+#ifndef _Polynomial_Roots_h_
+#define _Polynomial_Roots_h_
+
+/**
+ *\Function PolynomialRoots:
+ *
+ * Real roots of polynomials up to the fourth degree and real root counting,
+ * shared by the neutrino reconstruction (EquationSolver) and the MT2 solvers.
+ * Templated on the floating point type (float, double, long double):
+ *
+ *  - quadraticRoots, cubicRoots, quarticRoots: real roots in ascending order,
+ *    returning their number. Quadratics avoid the cancellation of the textbook
+ *    formula; cubics use the trigonometric form for three real roots and
+ *    Cardano with a single cube root otherwise; quartics go through the
+ *    resolvent cubic. Cubic and quartic roots get one Newton step.
+ *  - quarticRealRootCount: number of distinct real roots of a quartic from
+ *    the leading coefficients of its Sturm sequence, as used by the MT2
+ *    bisections to know whether two ellipses intersect.
+ *  - sturmRootCount: number of distinct real roots in (lo, hi].
+ *  - quarticFactorDiscriminant: continuous measure of how far a quartic is
+ *    from having (or losing) real roots, for root finding on parameters.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<cmath>
+#include<algorithm>
+#include<limits>
+
+namespace polyroots {
+
+  template<class T> inline T evaluate(const T * coeffs, int degree, T x){
+    T p = coeffs[0];
+    for(int i = 1; i <= degree; ++i) p = p * x + coeffs[i];
+    return p;
+  }
+
+  //One Newton step on the polynomial, kept only if it reduces |p(x)|
+  template<class T> inline T polish(const T * coeffs, int degree, T x){
+    T p = coeffs[0], dp = 0;
+    for(int i = 1; i <= degree; ++i){ dp = dp * x + p; p = p * x + coeffs[i]; }
+    if(dp == 0) return x;
+    T x1 = x - p / dp;
+    return std::fabs(evaluate(coeffs, degree, x1)) < std::fabs(p) ? x1 : x;
+  }
+
+  //a x^2 + b x + c = 0
+  template<class T> inline int quadraticRoots(T a, T b, T c, T roots[2]){
+    if(a == 0){
+      if(b == 0) return 0;
+      roots[0] = -c / b;
+      return 1;
+    }
+    T disc = b * b - 4 * a * c;
+    if(disc < 0) return 0;
+    if(disc == 0){
+      roots[0] = -b / (2 * a);
+      return 1;
+    }
+    T q = -(b + (b < 0 ? -std::sqrt(disc) : std::sqrt(disc))) / 2;
+    roots[0] = q / a;
+    roots[1] = q != 0 ? c / q : -roots[0];
+    if(roots[0] > roots[1]) std::swap(roots[0], roots[1]);
+    return 2;
+  }
+
+  //a x^3 + b x^2 + c x + d = 0
+  template<class T> inline int cubicRoots(T a, T b, T c, T d, T roots[3]){
+    if(a == 0) return quadraticRoots(b, c, d, roots);
+    T B = b / a, C = c / a, D = d / a;
+    T q = (3 * C - B * B) / 9;
+    T r = (9 * B * C - 27 * D - 2 * B * B * B) / 54;
+    T disc = q * q * q + r * r;
+    T shift = -B / 3;
+    int n = 0;
+    //a double root has disc = 0 up to the roundoff of q and r, which goes to the three root branch
+    T qErr = (3 * std::fabs(C) + B * B) / 9, rErr = (9 * std::fabs(B * C) + 27 * std::fabs(D) + 2 * std::fabs(B * B * B)) / 54;
+    T tolerance = 16 * std::numeric_limits<T>::epsilon() * (3 * q * q * qErr + 2 * std::fabs(r) * rErr);
+    if(disc > tolerance){
+      //one real root: s t = -q, the cube root taken on the side without cancellation
+      T s = std::cbrt(r + (r < 0 ? -std::sqrt(disc) : std::sqrt(disc)));
+      roots[n++] = s != 0 ? s - q / s + shift : shift;
+    }
+    else{
+      T sq = std::sqrt(std::max(T(0), -q));
+      T cosine = sq > 0 ? r / (sq * sq * sq) : 0;
+      T theta = std::acos(std::max(T(-1), std::min(T(1), cosine))) / 3;
+      //cos(theta + 2 pi k/3) from one sine and cosine, already in ascending order for theta in [0, pi/3]
+      T ct = std::cos(theta), st = std::sin(theta) * T(0.86602540378443864676372317075293618L);
+      roots[n++] = 2 * sq * (-ct / 2 - st) + shift;
+      roots[n++] = 2 * sq * (-ct / 2 + st) + shift;
+      roots[n++] = 2 * sq * ct + shift;
+    }
+    const T coeffs[4] = {1, B, C, D};
+    for(int i = 0; i < n; ++i) roots[i] = polish(coeffs, 3, roots[i]);
+    if(n == 3 && (roots[0] > roots[1] || roots[1] > roots[2])) std::sort(roots, roots + n);
+    return n;
+  }
+
+  //a x^4 + b x^3 + c x^2 + d x + e = 0
+  template<class T> inline int quarticRoots(T a, T b, T c, T d, T e, T roots[4]){
+    if(a == 0) return cubicRoots(b, c, d, e, roots);
+    T B = b / a, C = c / a, D = d / a, E = e / a;
+    //depressed quartic y^4 + p y^2 + q y + r, x = y - B/4
+    T B2 = B * B;
+    T p = C - 3 * B2 / 8;
+    T q = D - B * C / 2 + B2 * B / 8;
+    T r = E - B * D / 4 + B2 * C / 16 - 3 * B2 * B2 / 256;
+    T shift = -B / 4;
+    int n = 0;
+    T z[3], y[2];
+    if(std::fabs(q) <= 1e-12 * (std::fabs(p) * std::fabs(p) + std::fabs(r) + 1)){
+      //biquadratic
+      int nz = quadraticRoots(T(1), p, r, z);
+      for(int i = 0; i < nz; ++i){
+        if(z[i] < 0) continue;
+        T s = std::sqrt(z[i]);
+        roots[n++] = s + shift;
+        if(s > 0) roots[n++] = -s + shift;
+      }
+    }
+    else{
+      //largest root of the resolvent cubic m^3 + p m^2 + (p^2/4 - r) m - q^2/8, positive since q != 0
+      int nz = cubicRoots(T(1), p, p * p / 4 - r, -q * q / 8, z);
+      T m = z[nz - 1];
+      if(m > 0){
+        T s = std::sqrt(2 * m);
+        int ny = quadraticRoots(T(1), -s, m + p / 2 + q / (2 * s), y);
+        for(int i = 0; i < ny; ++i) roots[n++] = y[i] + shift;
+        ny = quadraticRoots(T(1), s, m + p / 2 - q / (2 * s), y);
+        for(int i = 0; i < ny; ++i) roots[n++] = y[i] + shift;
+      }
+    }
+    const T coeffs[5] = {1, B, C, D, E};
+    for(int i = 0; i < n; ++i) roots[i] = polish(coeffs, 4, roots[i]);
+    std::sort(roots, roots + n);
+    return n;
+  }
+
+  //Larger discriminant of the two real quadratic factors of a x^4 + b x^3 + c x^2 + d x + e, in the variable
+  //of the monic quartic: positive iff there are real roots, and changing sign smoothly when a pair of complex
+  //roots merges into a real double root. 0 if the factorization is degenerate (biquadratic or a == 0)
+  template<class T> inline T quarticFactorDiscriminant(T a, T b, T c, T d, T e){
+    if(a == 0) return 0;
+    T B = b / a, C = c / a, D = d / a, E = e / a;
+    T B2 = B * B;
+    T p = C - 3 * B2 / 8;
+    T q = D - B * C / 2 + B2 * B / 8;
+    T r = E - B * D / 4 + B2 * C / 16 - 3 * B2 * B2 / 256;
+    if(std::fabs(q) <= 1e-12 * (std::fabs(p) * std::fabs(p) + std::fabs(r) + 1)) return 0;
+    T z[3];
+    int nz = cubicRoots(T(1), p, p * p / 4 - r, -q * q / 8, z);
+    T m = z[nz - 1];
+    if(!(m > 0)) return 0;
+    //y^4 + p y^2 + q y + r = (y^2 - s y + m + p/2 + q/2s) (y^2 + s y + m + p/2 - q/2s)
+    T s = std::sqrt(2 * m);
+    T d1 = 2 * m - 4 * (m + p / 2 + q / (2 * s));
+    T d2 = 2 * m - 4 * (m + p / 2 - q / (2 * s));
+    return std::max(d1, d2);
+  }
+
+  //Distinct real roots of A4 x^4 + A3 x^3 + A2 x^2 + A1 x + A0: sign changes of the leading
+  //coefficients of the Sturm sequence at -infinity minus those at +infinity, 0 if negative by roundoff
+  template<class T> inline int quarticRealRootCount(T A4, T A3, T A2, T A1, T A0){
+    T A3sq = A3 * A3;
+    T B3 = 4 * A4, B2 = 3 * A3, B1 = 2 * A2, B0 = A1;
+    T C2 = -(A2 / 2 - 3 * A3sq / (16 * A4));
+    T C1 = -(3 * A1 / 4. - A2 * A3 / (8 * A4));
+    T C0 = -A0 + A1 * A3 / (16 * A4);
+    T D1 = -B1 - (B3 * C1 * C1 / C2 - B3 * C0 - B2 * C1) / C2;
+    T D0 = -B0 - B3 * C0 * C1 / (C2 * C2) + B2 * C0 / C2;
+    T E0 = -C0 - C2 * D0 * D0 / (D1 * D1) + C1 * D0 / D1;
+    const T t[5] = {A4, A4, C2, D1, E0};
+    int nsol = 0;
+    for(int i = 0; i < 4; ++i){
+      T s = t[i] * t[i + 1];
+      nsol += (s > 0) - (s < 0);
+    }
+    return nsol < 0 ? 0 : nsol;
+  }
+
+  //Distinct real roots in (lo, hi] of coeffs[0] x^degree + ... + coeffs[degree], degree <= 4
+  template<class T> inline int sturmRootCount(const T * coeffs, int degree, T lo, T hi){
+    T seq[5][5];//seq[k]: polynomial of degree[k], highest power first
+    int deg[5];
+    int n = 0;
+    while(degree > 0 && coeffs[0] == 0){ ++coeffs; --degree; }
+    if(degree <= 0) return 0;
+    for(int i = 0; i <= degree; ++i){
+      seq[0][i] = coeffs[i];
+      if(i < degree) seq[1][i] = (degree - i) * coeffs[i];
+    }
+    deg[0] = degree;
+    deg[1] = degree - 1;
+    n = 2;
+    while(deg[n - 1] > 0 && n < 5){
+      //seq[n] = -remainder(seq[n-2] / seq[n-1])
+      T rem[5];
+      int dr = deg[n - 2];
+      for(int i = 0; i <= dr; ++i) rem[i] = seq[n - 2][i];
+      int dd = deg[n - 1];
+      for(int i = 0; i <= dr - dd; ++i){
+        T f = rem[i] / seq[n - 1][0];
+        for(int j = 0; j <= dd; ++j) rem[i + j] -= f * seq[n - 1][j];
+      }
+      //remainder in rem[dr-dd+1 .. dr], drop the vanishing leading terms
+      int first = dr - dd + 1;
+      T scale = 0;
+      for(int i = 0; i <= dr; ++i) scale = std::max(scale, std::fabs(seq[n - 2][i]));
+      while(first <= dr && std::fabs(rem[first]) <= scale * 1e-12) ++first;
+      if(first > dr) break;
+      deg[n] = dr - first;
+      for(int i = first; i <= dr; ++i) seq[n][i - first] = -rem[i];
+      ++n;
+    }
+    int changes[2] = {0, 0};
+    const T x[2] = {lo, hi};
+    for(int k = 0; k < 2; ++k){
+      T last = 0;
+      for(int s = 0; s < n; ++s){
+        T v = evaluate(seq[s], deg[s], x[k]);
+        if(v == 0) continue;
+        if(last != 0 && (v > 0) != (last > 0)) ++changes[k];
+        last = v;
+      }
+    }
+    return changes[0] - changes[1];
+  }
+
+}
+
+#endif
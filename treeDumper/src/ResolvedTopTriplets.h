@@ -0,0 +1,197 @@
+#ifndef _Resolved_Top_Triplets_h_
+#define _Resolved_Top_Triplets_h_
+
+/**
+ *\Function ResolvedTopTriplets:
+ *
+ * Hadronic top candidates from three tight AK4 jets with exactly one CSVM
+ * b-jet. The jets are copied once per event into contiguous arrays; only the
+ * (b-jet x pair of non-b jets) combinations are enumerated. The W masses of
+ * all the light pairs are computed in one pass and the optional W and top mass
+ * windows prune the combinations before the remaining candidate variables are
+ * evaluated. With a maximum number of candidates only the best ones by the
+ * chosen ranking are kept in a bounded heap and returned best first. For the
+ * MVA ranking all the candidates are built, scored by the caller in one batch
+ * and then reduced with selectBest().
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<algorithm>
+#include<cmath>
+#include<string>
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+class ResolvedTopTriplets {
+
+public:
+  struct Candidate {
+    int b, j1, j2;//jet indices, j1 < j2
+    float pt, eta, phi, e, mass;//top
+    float wMass, wPhi, bPhi;
+    float massDrop;//max(m(j1), m(j2))/m(W) x Delta R(j1, j2)
+    float massChi2;//((m(W) - mW)/sigmaW)^2 + ((m(top) - mTop)/sigmaTop)^2
+    float dPhiJet1b, dPhiJet2b, dRJet1b, dRJet2b;
+    float mva;
+    float rank;//lower is better
+  };
+
+  enum Ranking { byJetOrder = 0, byMassChi2, byMVA };
+
+  ResolvedTopTriplets(){ setMassWindows(-1.e9, 1.e9, -1.e9, 1.e9); setMassHypotheses(80.4, 10., 172.5, 15.); setRanking(byJetOrder, 0); }
+  ~ResolvedTopTriplets(){;}
+
+  void setMassWindows(double wMin, double wMax, double topMin, double topMax){ wMin_ = wMin; wMax_ = wMax; topMin_ = topMin; topMax_ = topMax; }
+
+  void setMassHypotheses(double mW, double sigmaW, double mTop, double sigmaTop){ mW_ = mW; sigmaW_ = sigmaW; mTop_ = mTop; sigmaTop_ = sigmaTop; }
+  //maxCandidates <= 0 keeps all of them
+  void setRanking(Ranking ranking, int maxCandidates){ ranking_ = ranking; maxCandidates_ = maxCandidates; }
+  static Ranking ranking(const std::string & name);
+
+  void clear();
+  //Only the tight jets take part; b-tagged ones are the b candidates, the others the W daughters
+  void addJet(int index, double pt, double eta, double phi, double e, bool isB);
+  //Best candidates first; the jet loop (i < j < k) order breaks the ties
+  void build(std::vector<Candidate> & candidates);
+  //Keeps the best maxCandidates by rank, best first; for the MVA ranking after setting the rank to -mva
+  void selectBest(std::vector<Candidate> & candidates) const;
+  Ranking ranking() const { return ranking_; }
+
+  //Signed invariant mass, negative for space-like vectors as ROOT::Math
+  static double mass(double e, double px, double py, double pz){ double m2 = e * e - px * px - py * py - pz * pz; return m2 >= 0. ? sqrt(m2) : -sqrt(-m2); }
+
+private:
+  struct Jets {
+    std::vector<int> index;
+    std::vector<double> px, py, pz, e, eta, phi, m;
+    void clear(){ index.clear(); px.clear(); py.clear(); pz.clear(); e.clear(); eta.clear(); phi.clear(); m.clear(); }
+  };
+  Jets b_, light_;
+  std::vector<double> pairMass_;//[a*nLight+c], c > a
+  double wMin_, wMax_, topMin_, topMax_;
+  double mW_, sigmaW_, mTop_, sigmaTop_;
+  Ranking ranking_;
+  int maxCandidates_;
+
+  static bool jetOrder(const Candidate & x, const Candidate & y);
+  static bool better(const Candidate & x, const Candidate & y){ return x.rank < y.rank || (x.rank == y.rank && jetOrder(x, y)); }
+  //Bounded max-heap on the rank: the worst kept candidate is at the front
+  static void keep(std::vector<Candidate> & heap, const Candidate & cand, int maxCandidates);
+  static double deltaPhi(double phi1, double phi2){ double d = phi1 - phi2; while(d > M_PI) d -= 2. * M_PI; while(d <= -M_PI) d += 2. * M_PI; return d; }
+};
+
+inline void ResolvedTopTriplets::clear(){
+  b_.clear();
+  light_.clear();
+}
+
+inline void ResolvedTopTriplets::addJet(int index, double pt, double eta, double phi, double e, bool isB){
+  Jets & jets = isB ? b_ : light_;
+  double px = pt * cos(phi), py = pt * sin(phi), pz = pt * sinh(eta);
+  jets.index.push_back(index);
+  jets.px.push_back(px);
+  jets.py.push_back(py);
+  jets.pz.push_back(pz);
+  jets.e.push_back(e);
+  jets.eta.push_back(eta);
+  jets.phi.push_back(phi);
+  jets.m.push_back(mass(e, px, py, pz));
+}
+
+inline bool ResolvedTopTriplets::jetOrder(const Candidate & x, const Candidate & y){
+  int xs[3] = {x.b, x.j1, x.j2}, ys[3] = {y.b, y.j1, y.j2};
+  std::sort(xs, xs + 3);
+  std::sort(ys, ys + 3);
+  return std::lexicographical_compare(xs, xs + 3, ys, ys + 3);
+}
+
+inline ResolvedTopTriplets::Ranking ResolvedTopTriplets::ranking(const std::string & name){
+  if(name == "jetOrder") return byJetOrder;
+  if(name == "massChi2") return byMassChi2;
+  if(name == "mva") return byMVA;
+  throw cms::Exception("ResolvedTopTriplets") << "unknown ranking " << name << ", use jetOrder, massChi2 or mva\n";
+}
+
+inline void ResolvedTopTriplets::keep(std::vector<Candidate> & heap, const Candidate & cand, int maxCandidates){
+  if(maxCandidates <= 0 || (int)heap.size() < maxCandidates){
+    heap.push_back(cand);
+    std::push_heap(heap.begin(), heap.end(), better);
+  }
+  else if(better(cand, heap.front())){
+    std::pop_heap(heap.begin(), heap.end(), better);
+    heap.back() = cand;
+    std::push_heap(heap.begin(), heap.end(), better);
+  }
+}
+
+inline void ResolvedTopTriplets::selectBest(std::vector<Candidate> & candidates) const {
+  std::vector<Candidate> heap;
+  for(size_t c = 0; c < candidates.size(); ++c) keep(heap, candidates[c], maxCandidates_);
+  std::sort_heap(heap.begin(), heap.end(), better);
+  candidates.swap(heap);
+}
+
+inline void ResolvedTopTriplets::build(std::vector<Candidate> & candidates){
+  candidates.clear();
+  int nB = b_.index.size(), nL = light_.index.size();
+  if(nB < 1 || nL < 2) return;
+  int maxCandidates = ranking_ == byMVA ? 0 : maxCandidates_;
+
+  //W masses of all the light pairs, the inner loop runs over contiguous arrays
+  pairMass_.assign(nL * nL, 0.);
+  const double * px = &light_.px[0], * py = &light_.py[0], * pz = &light_.pz[0], * e = &light_.e[0];
+  for(int a = 0; a < nL; ++a){
+    double * row = &pairMass_[a * nL];
+    for(int c = a + 1; c < nL; ++c){
+      double se = e[a] + e[c], sx = px[a] + px[c], sy = py[a] + py[c], sz = pz[a] + pz[c];
+      double m2 = se * se - sx * sx - sy * sy - sz * sz;
+      row[c] = m2 >= 0. ? sqrt(m2) : -sqrt(-m2);
+    }
+  }
+
+  for(int a = 0; a < nL; ++a){
+    for(int c = a + 1; c < nL; ++c){
+      double mW = pairMass_[a * nL + c];
+      if(mW < wMin_ || mW > wMax_) continue;
+      double wx = px[a] + px[c], wy = py[a] + py[c], wz = pz[a] + pz[c], we = e[a] + e[c];
+      for(int k = 0; k < nB; ++k){
+        double tx = wx + b_.px[k], ty = wy + b_.py[k], tz = wz + b_.pz[k], te = we + b_.e[k];
+        double mTop = mass(te, tx, ty, tz);
+        if(mTop < topMin_ || mTop > topMax_) continue;
+        Candidate cand;
+        cand.b = b_.index[k];
+        cand.j1 = light_.index[a];
+        cand.j2 = light_.index[c];
+        double pt = sqrt(tx * tx + ty * ty);
+        cand.pt = pt;
+        cand.eta = asinh(tz / pt);
+        cand.phi = atan2(ty, tx);
+        cand.e = te;
+        cand.mass = mTop;
+        cand.wMass = mW;
+        cand.wPhi = atan2(wy, wx);
+        cand.bPhi = b_.phi[k];
+        double dEta = light_.eta[a] - light_.eta[c], dPhi = deltaPhi(light_.phi[a], light_.phi[c]);
+        cand.massDrop = std::max(light_.m[a], light_.m[c]) / mW * sqrt(dEta * dEta + dPhi * dPhi);
+        double pullW = (mW - mW_) / sigmaW_, pullTop = (mTop - mTop_) / sigmaTop_;
+        cand.massChi2 = pullW * pullW + pullTop * pullTop;
+        double dPhi1 = deltaPhi(light_.phi[a], b_.phi[k]), dPhi2 = deltaPhi(light_.phi[c], b_.phi[k]);
+        double dEta1 = light_.eta[a] - b_.eta[k], dEta2 = light_.eta[c] - b_.eta[k];
+        cand.dPhiJet1b = dPhi1;
+        cand.dPhiJet2b = dPhi2;
+        cand.dRJet1b = sqrt(dEta1 * dEta1 + dPhi1 * dPhi1);
+        cand.dRJet2b = sqrt(dEta2 * dEta2 + dPhi2 * dPhi2);
+        cand.mva = -2.;
+        cand.rank = ranking_ == byMassChi2 ? cand.massChi2 : 0.;
+        keep(candidates, cand, maxCandidates);
+      }
+    }
+  }
+  std::sort_heap(candidates.begin(), candidates.end(), better);
+}
+
+#endif
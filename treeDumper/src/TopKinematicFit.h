@@ -0,0 +1,142 @@
+#ifndef _Top_Kinematic_Fit_h_
+#define _Top_Kinematic_Fit_h_
+
+/**
+ *\Function TopKinematicFit:
+ *
+ * Kinematic fit of hadronic top candidates (two W jets and a b-jet) to the W
+ * and top masses. The jet directions and masses are kept and each jet is
+ * scaled by a factor a_i, measured as 1 within its relative pt resolution;
+ * the masses enter as two more residuals with the given widths:
+ *
+ *   chi2 = sum_i ((a_i - 1)/sigma_i)^2 + ((m(W) - mW)/wW)^2 + ((m(top) - mTop)/wTop)^2
+ *
+ * With the pair products p_i.p_j computed once, m^2 is a quadratic form in the
+ * a_i and the Jacobian is analytic. A fixed number of Gauss-Newton steps is
+ * taken on all the candidates together, each step solving the 3x3 normal
+ * equations in closed form. The fit probability is exp(-chi2/2), the one of
+ * two degrees of freedom.
+ *
+ *\version  $Id:
+ *
+ *
+*/
+
+#include<vector>
+#include<cmath>
+
+class TopKinematicFit {
+
+public:
+  struct Result {
+    double scale[3];//j1, j2, b
+    double chi2, prob;
+    bool converged;//false if a mass became non-physical, the scales are then 1
+  };
+
+  TopKinematicFit(){ setMasses(80.4, 2.1, 172.5, 1.5); setIterations(5); }
+  ~TopKinematicFit(){;}
+
+  void setMasses(double mW, double widthW, double mTop, double widthTop){ mW_ = mW; wW_ = widthW; mTop_ = mTop; wTop_ = widthTop; }
+  void setIterations(int n){ iterations_ = n; }
+
+  void clear(){ in_.clear(); }
+  //Jets as (px, py, pz, e), with the relative pt resolutions
+  void add(const double j1[4], double sigma1, const double j2[4], double sigma2, const double b[4], double sigmaB);
+  size_t size() const { return in_.size(); }
+  void fit(std::vector<Result> & results) const;
+
+  static double dot(const double p[4], const double q[4]){ return p[3] * q[3] - p[0] * q[0] - p[1] * q[1] - p[2] * q[2]; }
+
+private:
+  struct Input {
+    double m11, m22, mbb, m12, m1b, m2b;//Minkowski products
+    double w1, w2, wb;//1/sigma^2
+  };
+  std::vector<Input> in_;
+  double mW_, wW_, mTop_, wTop_;
+  int iterations_;
+
+  //Residual vector and normal equations at the scales a, false if a mass is not physical
+  bool normal(const Input & in, const double a[3], double A[3][3], double g[3], double & chi2) const;
+};
+
+inline void TopKinematicFit::add(const double j1[4], double sigma1, const double j2[4], double sigma2, const double b[4], double sigmaB){
+  Input in;
+  in.m11 = dot(j1, j1);
+  in.m22 = dot(j2, j2);
+  in.mbb = dot(b, b);
+  in.m12 = dot(j1, j2);
+  in.m1b = dot(j1, b);
+  in.m2b = dot(j2, b);
+  in.w1 = 1. / (sigma1 * sigma1);
+  in.w2 = 1. / (sigma2 * sigma2);
+  in.wb = 1. / (sigmaB * sigmaB);
+  in_.push_back(in);
+}
+
+inline bool TopKinematicFit::normal(const Input & in, const double a[3], double A[3][3], double g[3], double & chi2) const {
+  double mW2 = a[0] * a[0] * in.m11 + a[1] * a[1] * in.m22 + 2. * a[0] * a[1] * in.m12;
+  double mT2 = mW2 + a[2] * a[2] * in.mbb + 2. * a[2] * (a[0] * in.m1b + a[1] * in.m2b);
+  if(!(mW2 > 0.) || !(mT2 > 0.)) return false;
+  double mW = sqrt(mW2), mT = sqrt(mT2);
+  //gradients of the masses
+  double dW[3] = {(a[0] * in.m11 + a[1] * in.m12) / mW, (a[1] * in.m22 + a[0] * in.m12) / mW, 0.};
+  double dT[3] = {(a[0] * in.m11 + a[1] * in.m12 + a[2] * in.m1b) / mT,
+                  (a[1] * in.m22 + a[0] * in.m12 + a[2] * in.m2b) / mT,
+                  (a[2] * in.mbb + a[0] * in.m1b + a[1] * in.m2b) / mT};
+  double rW = (mW - mW_) / wW_, rT = (mT - mTop_) / wTop_;
+  double w[3] = {in.w1, in.w2, in.wb};
+  chi2 = rW * rW + rT * rT;
+  for(int i = 0; i < 3; ++i){
+    chi2 += w[i] * (a[i] - 1.) * (a[i] - 1.);
+    g[i] = w[i] * (a[i] - 1.) + rW * dW[i] / wW_ + rT * dT[i] / wTop_;
+    for(int j = 0; j < 3; ++j) A[i][j] = (i == j ? w[i] : 0.) + dW[i] * dW[j] / (wW_ * wW_) + dT[i] * dT[j] / (wTop_ * wTop_);
+  }
+  return true;
+}
+
+inline void TopKinematicFit::fit(std::vector<Result> & results) const {
+  size_t n = in_.size();
+  results.resize(n);
+  for(size_t c = 0; c < n; ++c){
+    Result & r = results[c];
+    r.scale[0] = r.scale[1] = r.scale[2] = 1.;
+    r.converged = true;
+  }
+  double A[3][3], g[3], chi2;
+  for(int it = 0; it < iterations_; ++it){
+    for(size_t c = 0; c < n; ++c){
+      Result & r = results[c];
+      if(!r.converged) continue;
+      if(!normal(in_[c], r.scale, A, g, chi2)){ r.converged = false; continue; }
+      //A delta = -g by Cramer's rule, A is symmetric and positive definite
+      double c00 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
+      double c01 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
+      double c02 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+      double det = A[0][0] * c00 + A[0][1] * c01 + A[0][2] * c02;
+      if(!(det > 0.)){ r.converged = false; continue; }
+      double c11 = A[0][0] * A[2][2] - A[0][2] * A[2][0];
+      double c12 = A[0][2] * A[1][0] - A[0][0] * A[1][2];
+      double c22 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+      double delta[3] = {-(c00 * g[0] + c01 * g[1] + c02 * g[2]) / det,
+                         -(c01 * g[0] + c11 * g[1] + c12 * g[2]) / det,
+                         -(c02 * g[0] + c12 * g[1] + c22 * g[2]) / det};
+      for(int i = 0; i < 3; ++i) r.scale[i] += delta[i];
+    }
+  }
+  for(size_t c = 0; c < n; ++c){
+    Result & r = results[c];
+    if(!r.converged || !normal(in_[c], r.scale, A, g, chi2)){
+      r.converged = false;
+      r.scale[0] = r.scale[1] = r.scale[2] = 1.;
+      r.chi2 = -1.;
+      r.prob = 0.;
+      continue;
+    }
+    r.chi2 = chi2;
+    r.prob = exp(-0.5 * chi2);
+  }
+}
+
+#endif
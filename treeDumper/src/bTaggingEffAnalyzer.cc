@@ -22,7 +22,7 @@
 
 // user include files
 #include "FWCore/Framework/interface/Frameworkfwd.h"
-#include "FWCore/Framework/interface/EDAnalyzer.h"
+#include "FWCore/Framework/interface/global/EDAnalyzer.h"
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
@@ -30,9 +30,14 @@
 #include "DataFormats/PatCandidates/interface/Muon.h"
 #include "FWCore/ServiceRegistry/interface/Service.h"
 #include "CommonTools/UtilAlgos/interface/TFileService.h"
+#include "TH1D.h"
 #include "TH2D.h"
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cmath>
 //
 // class declaration
 //
@@ -40,7 +45,16 @@
 using namespace std;
 using namespace edm;
 
-class bTaggingEffAnalyzer : public edm::EDAnalyzer {
+namespace bTaggingEff {
+  // bin contents filled by one stream, same layout as the booked histograms (under/overflow included)
+  struct StreamCounts {
+    double events;// processed events, for the cross section weights of the map production
+    std::vector< std::vector<double> > denom;// [collection][flavour*nBins+bin]
+    std::vector< std::vector<double> > num;// [collection][(workingPoint*nFlavours+flavour)*nBins+bin]
+  };
+}
+
+class bTaggingEffAnalyzer : public edm::global::EDAnalyzer< edm::StreamCache<bTaggingEff::StreamCounts> > {
 public:
   explicit bTaggingEffAnalyzer(const edm::ParameterSet&);
   ~bTaggingEffAnalyzer();
@@ -49,14 +63,11 @@ public:
 
 
 private:
-  virtual void beginJob() ;
-  virtual void analyze(const edm::Event&, const edm::EventSetup&);
-  virtual void endJob() ;
-
-  virtual void beginRun(edm::Run const&, edm::EventSetup const&);
-  virtual void endRun(edm::Run const&, edm::EventSetup const&);
-  virtual void beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
-  virtual void endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&);
+  virtual void beginJob() override;
+  virtual std::unique_ptr<bTaggingEff::StreamCounts> beginStream(edm::StreamID) const override;
+  virtual void analyze(edm::StreamID, const edm::Event&, const edm::EventSetup&) const override;
+  virtual void endStream(edm::StreamID) const override;
+  virtual void endJob() override;
 
   // ----------member data ---------------------------
 
@@ -68,8 +79,6 @@ private:
   
   const edm::InputTag jetsTag;
   const edm::InputTag muonsTag;
-  const std::string   discriminatorTag;
-  const double  discriminatorValue;
   const int     ptNBins;
   const double  ptMin;
   const double  ptMax;
@@ -78,12 +87,34 @@ private:
   const double  etaMax;
   
   edm::Service<TFileService>  fs;
-  TH2D  *h2_bTaggingEff_Denom_b;
-  TH2D  *h2_bTaggingEff_Denom_c;
-  TH2D  *h2_bTaggingEff_Denom_udsg;
-  TH2D  *h2_bTaggingEff_Num_b;
-  TH2D  *h2_bTaggingEff_Num_c;
-  TH2D  *h2_bTaggingEff_Num_udsg;
+
+  enum Flavour { b = 0, c, udsg, nFlavours };
+
+  // one numerator/denominator set per working point, in its own directory with the usual h2_bTaggingEff_* names
+  struct WorkingPoint {
+    std::string name;
+    double value;
+    TH2D * num[nFlavours];
+    TH2D * denom[nFlavours];
+  };
+  struct JetCollection {
+    std::string name;
+    edm::EDGetTokenT< PatJetCollection > token;
+    std::string discriminatorTag;
+    std::vector<WorkingPoint> workingPoints;// increasing thresholds
+  };
+  std::vector<JetCollection> collections;
+
+  // the TFileService histograms are only touched when a stream ends, under the lock;
+  // the streams look up bins in a private copy of the binning (FindFixBin is const)
+  TH2D * binning;
+  int nBins;
+  TH1D * h1_nEvents;
+  mutable std::mutex mergeMutex;
+  static void merge(TH2D * h, const double * counts, int nBins);
+
+  void book(JetCollection & coll, std::vector<edm::ParameterSet> wps, bool ownDirectories);
+  static bool tighter(const WorkingPoint & a, const WorkingPoint & b) { return a.value < b.value; }
 
 };
 
@@ -103,8 +134,6 @@ bTaggingEffAnalyzer::bTaggingEffAnalyzer(const edm::ParameterSet& iConfig):
 
   jetsTag(iConfig.getParameter<edm::InputTag>("JetsTag")),
   muonsTag(iConfig.getParameter<edm::InputTag>("MuonsTag")),
-  discriminatorTag(iConfig.getParameter<std::string>("DiscriminatorTag")),
-  discriminatorValue(iConfig.getParameter<double>("DiscriminatorValue")),
   ptNBins(iConfig.getParameter<int>("PtNBins")),
   ptMin(iConfig.getParameter<double>("PtMin")),
   ptMax(iConfig.getParameter<double>("PtMax")),
@@ -117,12 +146,56 @@ bTaggingEffAnalyzer::bTaggingEffAnalyzer(const edm::ParameterSet& iConfig):
   t_muonsTag_ = consumes< PatMuonCollection >( muonsTag );
   
   //now do what ever initialization is needed
-  h2_bTaggingEff_Denom_b    = fs->make<TH2D>("h2_bTaggingEff_Denom_b", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
-  h2_bTaggingEff_Denom_c    = fs->make<TH2D>("h2_bTaggingEff_Denom_c", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
-  h2_bTaggingEff_Denom_udsg = fs->make<TH2D>("h2_bTaggingEff_Denom_udsg", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
-  h2_bTaggingEff_Num_b    = fs->make<TH2D>("h2_bTaggingEff_Num_b", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
-  h2_bTaggingEff_Num_c    = fs->make<TH2D>("h2_bTaggingEff_Num_c", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
-  h2_bTaggingEff_Num_udsg = fs->make<TH2D>("h2_bTaggingEff_Num_udsg", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
+  binning = new TH2D("bTaggingEffBinning", ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
+  binning->SetDirectory(0);
+  nBins = (ptNBins+2)*(etaNBins+2);
+  h1_nEvents = fs->make<TH1D>("h1_nEvents", ";;processed events", 1, 0., 1.);
+
+  if( iConfig.exists("JetCollections") )
+    {
+      // several collections and working points in one pass: histograms go to <Name>_<WorkingPoint name>/
+      std::vector<edm::ParameterSet> collsPSet = iConfig.getParameter<std::vector<edm::ParameterSet> >("JetCollections");
+      for(size_t i = 0; i < collsPSet.size(); ++i)
+	{
+	  JetCollection coll;
+	  coll.name = collsPSet[i].getParameter<std::string>("Name");
+	  coll.token = consumes< PatJetCollection >( collsPSet[i].getParameter<edm::InputTag>("JetsTag") );
+	  coll.discriminatorTag = collsPSet[i].getParameter<std::string>("DiscriminatorTag");
+	  book(coll, collsPSet[i].getParameter<std::vector<edm::ParameterSet> >("WorkingPoints"), true);
+	  collections.push_back(coll);
+	}
+    }
+  else
+    {
+      // single working point, histograms in the module directory as before
+      JetCollection coll;
+      coll.token = t_jetsTag_;
+      coll.discriminatorTag = iConfig.getParameter<std::string>("DiscriminatorTag");
+      edm::ParameterSet wp;
+      wp.addParameter<std::string>("Name", "");
+      wp.addParameter<double>("DiscriminatorValue", iConfig.getParameter<double>("DiscriminatorValue"));
+      book(coll, std::vector<edm::ParameterSet>(1, wp), false);
+      collections.push_back(coll);
+    }
+}
+
+void bTaggingEffAnalyzer::book(JetCollection & coll, std::vector<edm::ParameterSet> wps, bool ownDirectories)
+{
+  const char * flavours[nFlavours] = {"b", "c", "udsg"};
+  for(size_t w = 0; w < wps.size(); ++w)
+    {
+      WorkingPoint wp;
+      wp.name = wps[w].getParameter<std::string>("Name");
+      wp.value = wps[w].getParameter<double>("DiscriminatorValue");
+      TFileDirectory dir = ownDirectories ? fs->mkdir(coll.name+"_"+wp.name) : *fs;
+      for(int f = 0; f < nFlavours; ++f)
+	{
+	  wp.denom[f] = dir.make<TH2D>((std::string("h2_bTaggingEff_Denom_")+flavours[f]).c_str(), ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
+	  wp.num[f] = dir.make<TH2D>((std::string("h2_bTaggingEff_Num_")+flavours[f]).c_str(), ";p_{T} [GeV];#eta", ptNBins, ptMin, ptMax, etaNBins, etaMin, etaMax);
+	}
+      coll.workingPoints.push_back(wp);
+    }
+  std::sort(coll.workingPoints.begin(), coll.workingPoints.end(), tighter);
 }
 
 
@@ -131,6 +204,7 @@ bTaggingEffAnalyzer::~bTaggingEffAnalyzer()
  
   // do anything here that needs to be done at desctruction time
   // (e.g. close files, deallocate resources etc.)
+  delete binning;
 
 }
 
@@ -140,8 +214,11 @@ bTaggingEffAnalyzer::~bTaggingEffAnalyzer()
 //
 
 // ------------ method called for each event  ------------
-void bTaggingEffAnalyzer::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+void bTaggingEffAnalyzer::analyze(edm::StreamID iStream, const edm::Event& iEvent, const edm::EventSetup& iSetup) const
 {
+  bTaggingEff::StreamCounts * counts = streamCache(iStream);
+  counts->events += 1.;
+
   edm::Handle<PatJetCollection> jets;
   iEvent.getByToken(t_jetsTag_,jets );
 
@@ -181,26 +258,22 @@ void bTaggingEffAnalyzer::analyze(const edm::Event& iEvent, const edm::EventSetu
 
   if(Ht>1250 && nJets>3 && nMuons==0){
   //if(1>0){
-    // loop over jets
-    for(PatJetCollection::const_iterator it = jets->begin(); it != jets->end(); ++it)
+    // loop over collections and jets: one discriminator call per jet fills all the working points
+    for(size_t i = 0; i < collections.size(); ++i)
       {
-	int partonFlavor = it->partonFlavour();
-	if( abs(partonFlavor)==5 )
-	  {
-	    h2_bTaggingEff_Denom_b->Fill(it->pt(), it->eta());
-	    if( it->bDiscriminator(discriminatorTag.c_str()) >= discriminatorValue ) h2_bTaggingEff_Num_b->Fill(it->pt(), it->eta());
-	  }
-	else if( abs(partonFlavor)==4 )
+	const JetCollection & coll = collections[i];
+	edm::Handle<PatJetCollection> collJets;
+	iEvent.getByToken(coll.token, collJets);
+	for(PatJetCollection::const_iterator it = collJets->begin(); it != collJets->end(); ++it)
 	  {
-	    h2_bTaggingEff_Denom_c->Fill(it->pt(), it->eta());
-	    if( it->bDiscriminator(discriminatorTag.c_str()) >= discriminatorValue ) h2_bTaggingEff_Num_c->Fill(it->pt(), it->eta());
-	  }
-	else
-	  {
-	    h2_bTaggingEff_Denom_udsg->Fill(it->pt(), it->eta());
-	    if( it->bDiscriminator(discriminatorTag.c_str()) >= discriminatorValue ) h2_bTaggingEff_Num_udsg->Fill(it->pt(), it->eta());
-	  }
-      }//close loop over AK4 jets
+	    int partonFlavor = abs(it->partonFlavour());
+	    int f = partonFlavor==5 ? b : (partonFlavor==4 ? c : udsg);
+	    int bin = binning->FindFixBin(it->pt(), it->eta());
+	    counts->denom[i][f*nBins+bin] += 1.;
+	    float discr = it->bDiscriminator(coll.discriminatorTag);
+	    for(size_t w = 0; w < coll.workingPoints.size() && discr >= coll.workingPoints[w].value; ++w) counts->num[i][(w*nFlavours+f)*nBins+bin] += 1.;
+	  }//close loop over jets
+      }
   }//close Ht, nJets & nMuons
 }//close anaylze
 
@@ -211,33 +284,58 @@ bTaggingEffAnalyzer::beginJob()
 {
 }
 
-// ------------ method called once each job just after ending the event loop  ------------
-void 
-bTaggingEffAnalyzer::endJob() 
-{
-}
-
-// ------------ method called when starting to processes a run  ------------
-void 
-bTaggingEffAnalyzer::beginRun(edm::Run const&, edm::EventSetup const&)
+// ------------ method called once each stream just before starting its event loop  ------------
+std::unique_ptr<bTaggingEff::StreamCounts>
+bTaggingEffAnalyzer::beginStream(edm::StreamID) const
 {
+  std::unique_ptr<bTaggingEff::StreamCounts> counts(new bTaggingEff::StreamCounts);
+  counts->events = 0.;
+  for(size_t i = 0; i < collections.size(); ++i)
+    {
+      counts->denom.push_back(std::vector<double>(nFlavours*nBins, 0.));
+      counts->num.push_back(std::vector<double>(collections[i].workingPoints.size()*nFlavours*nBins, 0.));
+    }
+  return counts;
 }
 
-// ------------ method called when ending the processing of a run  ------------
-void 
-bTaggingEffAnalyzer::endRun(edm::Run const&, edm::EventSetup const&)
+// ------------ method called once each stream just after ending its event loop  ------------
+void
+bTaggingEffAnalyzer::endStream(edm::StreamID iStream) const
 {
+  const bTaggingEff::StreamCounts * counts = streamCache(iStream);
+  std::lock_guard<std::mutex> lock(mergeMutex);
+  double entries = h1_nEvents->GetEntries();
+  h1_nEvents->SetBinContent(1, h1_nEvents->GetBinContent(1)+counts->events);
+  h1_nEvents->SetBinError(1, sqrt(pow(h1_nEvents->GetBinError(1), 2)+counts->events));
+  h1_nEvents->SetEntries(entries+counts->events);
+  for(size_t i = 0; i < collections.size(); ++i)
+    for(size_t w = 0; w < collections[i].workingPoints.size(); ++w)
+      for(int f = 0; f < nFlavours; ++f)
+	{
+	  merge(collections[i].workingPoints[w].denom[f], &counts->denom[i][f*nBins], nBins);
+	  merge(collections[i].workingPoints[w].num[f], &counts->num[i][(w*nFlavours+f)*nBins], nBins);
+	}
 }
 
-// ------------ method called when starting to processes a luminosity block  ------------
-void 
-bTaggingEffAnalyzer::beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&)
+// unit weight fills: the entries and the sum of the squared weights are the sum of the counts
+// (AddBinContent would leave the Sumw2 array behind; SetBinContent counts one entry per call)
+void
+bTaggingEffAnalyzer::merge(TH2D * h, const double * counts, int nBins)
 {
+  double entries = h->GetEntries();
+  for(int bin = 0; bin < nBins; ++bin)
+    {
+      if(counts[bin] == 0.) continue;
+      h->SetBinContent(bin, h->GetBinContent(bin)+counts[bin]);
+      h->SetBinError(bin, sqrt(pow(h->GetBinError(bin), 2)+counts[bin]));
+      entries += counts[bin];
+    }
+  h->SetEntries(entries);
 }
 
-// ------------ method called when ending the processing of a luminosity block  ------------
+// ------------ method called once each job just after ending the event loop  ------------
 void 
-bTaggingEffAnalyzer::endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&)
+bTaggingEffAnalyzer::endJob() 
 {
 }
 
@@ -37,6 +37,7 @@
 #include <math.h>
 //#include "EventReco/interface/mt2w_bisect.h"
 #include "mt2w_bisect.h"
+#include "PolynomialRoots.h"
 
 using namespace std;
 
@@ -51,6 +52,23 @@ mt2w::mt2w(double upper_bound, double error_value, double scan_step)
    this->upper_bound = upper_bound;  // the upper bound of search for MT2W, default value is 500 GeV 
    this->error_value = error_value;  // if we couldn't find any compatible region below the upper_bound, output mt2w = error_value;
    this->scan_step = scan_step;    // if we need to scan to find the compatible region, this is the step of the scan
+   scan_relative_step = 0.;
+   user_precision = 0.;
+}
+
+void mt2w::set_precision(double precision)
+{
+   user_precision = precision;
+   solved = false;
+   if (momenta_set) this->precision = precision > 0. ? precision : (ABSOLUTE_PRECISION > 100.*RELATIVE_PRECISION ? ABSOLUTE_PRECISION : 100.*RELATIVE_PRECISION);
+}
+
+// A growing step is faster on events compatible only far above the lower bound, but can step over
+// a compatible window narrower than itself and return error_value instead
+void mt2w::set_scan_relative_step(double step)
+{
+   scan_relative_step = step;
+   solved = false;
 }
 
 double mt2w::get_mt2w()
@@ -142,14 +160,52 @@ void mt2w::set_momenta(double El,  double plx,  double ply,  double plz,
 	mv = 0.0;   //mass of neutrino
 	mw = 80.4;  //mass of W-boson
 
+//coefficients of teco that do not depend on mtop, computed once per event
+
+	ETb2sq = Eb2sq - pb2z*pb2z;  //transverse energy of b2
+	aa = (El*pb1x-Eb1*plx)/(Eb1*plz-El*pb1z);
+	bb = (El*pb1y-Eb1*ply)/(Eb1*plz-El*pb1z);
+	a1 = Eb1sq*(1.+aa*aa)-(pb1x+pb1z*aa)*(pb1x+pb1z*aa);
+	b1 = Eb1sq*aa*bb - (pb1x+pb1z*aa)*(pb1y+pb1z*bb);
+	c1 = Eb1sq*(1.+bb*bb)-(pb1y+pb1z*bb)*(pb1y+pb1z*bb);
+	a2 = 1-pb2x*pb2x/(ETb2sq);
+	b2 = -pb2x*pb2y/(ETb2sq);
+	c2 = 1-pb2y*pb2y/(ETb2sq);
+	A4 = 
+	-4*a2*b1*b2*c1 + 4*a1*b2*b2*c1 +a2*a2*c1*c1 + 
+	4*a2*b1*b1*c2 - 4*a1*b1*b2*c2 - 2*a1*a2*c1*c2 + 
+	a1*a1*c2*c2;  
+
 
 //precision?	
 
-   if (ABSOLUTE_PRECISION > 100.*RELATIVE_PRECISION) precision = ABSOLUTE_PRECISION;
+   if (user_precision > 0.) precision = user_precision;
+   else if (ABSOLUTE_PRECISION > 100.*RELATIVE_PRECISION) precision = ABSOLUTE_PRECISION;
    else precision = 100.*RELATIVE_PRECISION;
 }
 
 
+// The top decaying to b1 and to the W of the visible lepton needs m(b1 l) below its endpoint:
+// in the W frame p_b1.p_l <= Eb* El* + pb* pl*, with mtop^2 = mw^2 + mb1^2 + 2 mw Eb*.
+// Solving for Eb* gives the smallest compatible mtop on that side; the other side needs mw + mb2.
+double mt2w::get_lower_bound()
+{
+	double bound = mw + (mb1 >= mb2 ? mb1 : mb2);
+	double T = El*Eb1 - plx*pb1x - ply*pb1y - plz*pb1z;   // p_b1.p_l
+	double Els = (mw*mw + mlsq - mv*mv)/(2.*mw);           // lepton energy and momentum in the W frame
+	double pls = sqrt(Els*Els - mlsq > 0. ? Els*Els - mlsq : 0.);
+	if (T <= mb1*Els) return bound;
+	// (T - Eb* Els)^2 = (Eb*^2 - mb1^2) pls^2 with T - Eb* Els >= 0, on the increasing branch
+	double roots[2];
+	int n = polyroots::quadraticRoots(Els*Els - pls*pls, -2.*T*Els, T*T + mb1sq*pls*pls, roots);
+	double Ebs = -1.;
+	for (int i = 0; i < n; ++i) if (roots[i] >= mb1 && roots[i]*Els <= T*(1. + 1.e-12)) Ebs = roots[i];
+	if (Ebs < 0.) return bound;
+	double mtop = sqrt(mw*mw + mb1sq + 2.*mw*Ebs);
+	return mtop > bound ? mtop : bound;
+}
+
+
 void mt2w::mt2w_bisect()
 {
   
@@ -168,15 +224,22 @@ void mt2w::mt2w_bisect()
 	// between mtop_low and 500 GeV, but it doesn't extend all the way up to 500.
 	// 
 	
-	// If our starting high guess is not compatible, start the high guess from the low guess...
-    if (teco(mtop_high)==0) {mtop_high = mtop_low;}
-	
-	// .. and scan up until a compatible high bound is found.
+	// If our starting high guess is not compatible, start the high guess from the low guess,
+	// raised to the m(b1 l) endpoint bound on the grid of scan_step, so that the scan visits
+	// the same points as from m_W + m_b...
+    if (teco(mtop_high)==0) {
+        double skipped = get_lower_bound() - precision - mtop_low;
+        if (skipped > 0.) mtop_low += floor(skipped/scan_step)*scan_step;
+        mtop_high = mtop_low;
+    }
+	
+	// .. and scan up until a compatible high bound is found, in steps of scan_step (or scan_relative_step
+	// of mtop if larger, see set_scan_relative_step).
 	//We can also raise the lower bound since we scaned over a region that is not compatible
 	while (teco(mtop_high)==0 && mtop_high < upper_bound + 2.*scan_step) {
 
 		mtop_low=mtop_high;
-		mtop_high = mtop_high + scan_step;
+		mtop_high = mtop_high + (scan_step > scan_relative_step*mtop_high ? scan_step : scan_relative_step*mtop_high);
 	}
 	
 	// if we can not find a compatible region under the upper bound, output the error value
@@ -185,27 +248,73 @@ void mt2w::mt2w_bisect()
 		return;
 	}
 	
-    // Once we have an compatible mtop_high, we can find mt2w using bisection method
+    // Once we have an compatible mtop_high, we can find mt2w using bisection method down to
+    // SECANT_WIDTH, then by regula falsi on the margin of teco with the Illinois modification,
+    // the trial points kept half the precision inside the bracket and bisection as fallback
+   double margin_low = 0., margin_high = 0.;
+   int side = 0;
    while(mtop_high - mtop_low > precision)
    {
-      double mtop_mid,teco_mid;
+      double mtop_mid, margin_mid = 0.;
+      bool secant = mtop_high - mtop_low < SECANT_WIDTH && margin_low < 0. && margin_high > 0.;
       //bisect
       mtop_mid = (mtop_high+mtop_low)/2.;
-      teco_mid = teco(mtop_mid);
-      
-	   if(teco_mid == 0) {mtop_low  = mtop_mid;}
-	   else {mtop_high  = mtop_mid;}
-	   
+      if (secant) {
+         mtop_mid = mtop_low + (mtop_high - mtop_low)*margin_low/(margin_low - margin_high);
+         if (mtop_mid < mtop_low + 0.5*precision) mtop_mid = mtop_low + 0.5*precision;
+         if (mtop_mid > mtop_high - 0.5*precision) mtop_mid = mtop_high - 0.5*precision;
+      }
+      else {
+         side = 0;
+      }
+
+      if(teco(mtop_mid, mtop_high - mtop_low < 2.*SECANT_WIDTH ? &margin_mid : 0) == 0) {
+         mtop_low  = mtop_mid;
+         margin_low = margin_mid;
+         if (side == -1) margin_high *= 0.5;
+         side = -1;
+      }
+      else {
+         mtop_high  = mtop_mid;
+         margin_high = margin_mid;
+         if (side == 1) margin_low *= 0.5;
+         side = 1;
+      }
    }
    mt2w_b = mtop_high;   //output the value of mt2w
    return;
 }
 
 
+// Whether ellipse 1 and the 2nd ellipse of teco are separated by a line orthogonal to the one joining their
+// centers: the support of ellipse 1 along it is below that of the 2nd ellipse from the other side. Only
+// claimed with a relative margin and when the centers and the ellipse sizes are not lost to roundoff, so
+// that the Sturm sequence of teco is left the ill-conditioned cases.
+bool mt2w::separated()
+{
+	double det1m = a1*c1 - b1*b1, det2m = a2*c2 - b2*b2;
+	if (!(det1m > 0.0 && det2m > 0.0)) {return false;}
+	// centers and the values k at which the quadratic forms of the ellipses reach their boundaries
+	double xc1 = (b1*e1 - c1*d1)/det1m, yc1 = (b1*d1 - a1*e1)/det1m;
+	double xc2 = (b2*e2 - c2*d2)/det2m, yc2 = (b2*d2 - a2*e2)/det2m;
+	double k1 = -(f1 + d1*xc1 + e1*yc1), k2 = -(f2 + d2*xc2 + e2*yc2);
+	if (!(k1*a1 > 0.0 && k2*a2 > 0.0)) {return false;}
+	if (fabs(k1) < 1.e-6*(fabs(f1) + fabs(d1*xc1) + fabs(e1*yc1))) {return false;}
+	if (fabs(k2) < 1.e-6*(fabs(f2) + fabs(d2*xc2) + fabs(e2*yc2))) {return false;}
+	// supports along u: u.xc +- sqrt(k u^T M^-1 u)
+	double ux = xc2 - xc1, uy = yc2 - yc1;
+	double r1 = sqrt(k1*(c1*ux*ux - 2.*b1*ux*uy + a1*uy*uy)/det1m);
+	double r2 = sqrt(k2*(c2*ux*ux - 2.*b2*ux*uy + a2*uy*uy)/det2m);
+	double s1 = ux*xc1 + uy*yc1, s2 = ux*xc2 + uy*yc2;
+	return s2 - r2 - (s1 + r1) > 1.e-6*(fabs(s1) + fabs(s2) + r1 + r2);
+}
+
+
 // for a given event, teco ( mtop ) gives 1 if trial top mass mtop is compatible, 0 if mtop is not.
 	
-int mt2w::teco(  double mtop)
+int mt2w::teco(  double mtop, double *margin)
 {
+	if (margin) *margin = 0.;
 	
 //first test if mtop is larger than mb+mw	
 	
@@ -213,7 +322,6 @@ int mt2w::teco(  double mtop)
 
 //define delta for convenience, note the definition is different from the one in mathematica code by 2*E^2_{b2}
 	  	
-	double ETb2sq = Eb2sq - pb2z*pb2z;  //transverse energy of b2
 	double delta = (mtop*mtop-mw*mw-mb2sq)/(2.*ETb2sq);
 	
 	
@@ -222,10 +330,8 @@ int mt2w::teco(  double mtop)
 	double del1 = mw*mw - mv*mv - mlsq;
 	double del2 = mtop*mtop - mw*mw - mb1sq - 2*(El*Eb1-plx*pb1x-ply*pb1y-plz*pb1z);
 	
-// aa bb cc are A B C in the notes eq.15
+// cc is C in the notes eq.15 (A and B, aa and bb, are in set_momenta)
 	
-	double aa = (El*pb1x-Eb1*plx)/(Eb1*plz-El*pb1z);
-	double bb = (El*pb1y-Eb1*ply)/(Eb1*plz-El*pb1z);
 	double cc = (El*del2-Eb1*del1)/(2.*Eb1*plz-2.*El*pb1z);
 	
   
@@ -237,9 +343,6 @@ int mt2w::teco(  double mtop)
 //
 //  where x and y are px and py of the neutrino on the visible lepton chain
 
-	a1 = Eb1sq*(1.+aa*aa)-(pb1x+pb1z*aa)*(pb1x+pb1z*aa);
-	b1 = Eb1sq*aa*bb - (pb1x+pb1z*aa)*(pb1y+pb1z*bb);
-	c1 = Eb1sq*(1.+bb*bb)-(pb1y+pb1z*bb)*(pb1y+pb1z*bb);
 	d1 = Eb1sq*aa*cc - (pb1x+pb1z*aa)*(pb1z*cc+del2/2.0);
 	e1 = Eb1sq*bb*cc - (pb1y+pb1z*bb)*(pb1z*cc+del2/2.0);
 	f1 = Eb1sq*(mv*mv+cc*cc) - (pb1z*cc+del2/2.0)*(pb1z*cc+del2/2.0);
@@ -252,10 +355,6 @@ int mt2w::teco(  double mtop)
 	
 //coefficients of the ellptical region
 	
-	a2 = 1-pb2x*pb2x/(ETb2sq);
-	b2 = -pb2x*pb2y/(ETb2sq);
-	c2 = 1-pb2y*pb2y/(ETb2sq);
-	
 	// d2o e2o f2o are coefficients in the p2x p2y plane (p2 is the momentum of the missing W-boson)
 	// it is convenient to calculate them first and transfer the ellipse to the p1x p1y plane
 	d2o = -delta*pb2x;
@@ -273,18 +372,15 @@ int mt2w::teco(  double mtop)
 	if (h0 < 0.0) {return 0;}  // if h0 < 0, y0 is not real and ellipse 1 is not real, this is a redundant check.
 	y0 = (-b1*x0 -e1 + sqrt(h0))/c1;
 	r0 = a2*x0*x0 + 2*b2*x0*y0 + c2*y0*y0 + 2*d2*x0 + 2*e2*y0 + f2;
-	if (r0 < 0.0) {return 1;}  // if the point is within the 2nd ellipse, mtop is compatible
+	if (r0 < 0.0 && !margin) {return 1;}  // if the point is within the 2nd ellipse, mtop is compatible
+	if (!margin && separated()) {return 0;}  // if ellipse 1 and the 2nd ellipse are on both sides of a line, it is not
 	
 	
 //obtain the coefficients for the 4th order equation 
 //devided by Eb1^n to make the variable dimensionless
-   long double A4, A3, A2, A1, A0;
+//(A4 does not depend on mtop, see set_momenta)
+   long double A3, A2, A1, A0;
 
-	A4 = 
-	-4*a2*b1*b2*c1 + 4*a1*b2*b2*c1 +a2*a2*c1*c1 + 
-	4*a2*b1*b1*c2 - 4*a1*b1*b2*c2 - 2*a1*a2*c1*c2 + 
-	a1*a1*c2*c2;  
-	
 	A3 =
 	(-4*a2*b2*c1*d1 + 8*a2*b1*c2*d1 - 4*a1*b2*c2*d1 - 4*a2*b1*c1*d2 + 
 	 8*a1*b2*c1*d2 - 4*a1*b1*c2*d2 - 8*a2*b1*b2*e1 + 8*a1*b2*b2*e1 + 
@@ -311,50 +407,10 @@ int mt2w::teco(  double mtop)
 	 4*a2*d1*d1*f2 - 4*a1*d1*d2*f2 - 2*a1*a2*f1*f2 + 
      a1*a1*f2*f2)/(Eb1sq*Eb1sq);
 	
-   /*
-   long  double A0sq, A1sq, A2sq, A4sq;
-   A0sq = A0*A0;
-   A1sq = A1*A1;
-   A2sq = A2*A2;
-   A4sq = A4*A4;
-   */
-   
-   long double A3sq;
-   A3sq = A3*A3;
-   
-   long double B3, B2, B1, B0;
-   B3 = 4*A4;
-   B2 = 3*A3;
-   B1 = 2*A2;
-   B0 = A1;
-   
-   long double C2, C1, C0;
-   C2 = -(A2/2 - 3*A3sq/(16*A4));
-   C1 = -(3*A1/4. -A2*A3/(8*A4));
-   C0 = -A0 + A1*A3/(16*A4);
-   
-   long double D1, D0;
-   D1 = -B1 - (B3*C1*C1/C2 - B3*C0 -B2*C1)/C2;
-   D0 = -B0 - B3 *C0 *C1/(C2*C2)+ B2*C0/C2;
-   
-   long double E0;
-   E0 = -C0 - C2*D0*D0/(D1*D1) + C1*D0/D1;
-   
-   long  double t1,t2,t3,t4,t5;
-//find the coefficients for the leading term in the Sturm sequence  
-   t1 = A4;
-   t2 = A4;
-   t3 = C2;
-   t4 = D1;
-   t5 = E0;
- 
-
-//The number of solutions depends on diffence of number of sign changes for x->Inf and x->-Inf
-   int nsol;
-   nsol = signchange_n(t1,t2,t3,t4,t5) - signchange_p(t1,t2,t3,t4,t5);
-
-//Cannot have negative number of solutions, must be roundoff effect
-   if (nsol < 0) nsol = 0;
+   //Number of real solutions from the Sturm sequence of the quartic
+   if (margin) *margin = polyroots::quarticFactorDiscriminant<double>(A4, A3, A2, A1, A0);
+   if (r0 < 0.0) {return 1;}
+   int nsol = polyroots::quarticRealRootCount<long double>(A4, A3, A2, A1, A0);
 	
     int out;
 	if (nsol == 0) {out = 0;}  //output 0 if there is no solution, 1 if there is solution
@@ -364,25 +420,5 @@ int mt2w::teco(  double mtop)
   
 }  
 
-inline int mt2w::signchange_n( long double t1, long double t2, long double t3, long double t4, long double t5)
-{
-   int nsc;
-   nsc=0;
-   if(t1*t2>0) nsc++;
-   if(t2*t3>0) nsc++;
-   if(t3*t4>0) nsc++;
-   if(t4*t5>0) nsc++;
-   return nsc;
-}
-inline int mt2w::signchange_p( long double t1, long double t2, long double t3, long double t4, long double t5)
-{
-   int nsc;
-   nsc=0;
-   if(t1*t2<0) nsc++;
-   if(t2*t3<0) nsc++;
-   if(t3*t4<0) nsc++;
-   if(t4*t5<0) nsc++;
-   return nsc;
-}
 
 }//end namespace mt2w_bisect
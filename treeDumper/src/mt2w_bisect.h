@@ -23,6 +23,7 @@
 #define MIN_MASS  0.1   //if ma<MINMASS and mb<MINMASS, use massless code
 #define ZERO_MASS 0.000 //give massless particles a small mass
 #define SCANSTEP 0.1
+#define SECANT_WIDTH 1.0        //below this bracket width (GeV) the bisection switches to regula falsi
 namespace mt2w_bisect
 {
 class mt2w
@@ -46,6 +47,10 @@ class mt2w
       //    b2 is the other bottom (paired with the invisible W)
       //    pmiss is missing momentum with only x and y components.
       double get_mt2w();  // Calculates result, which is cached until set_momenta is called.
+      void   set_precision(double precision);  // Absolute precision on mt2w in GeV, <= 0 for the default below
+      double get_lower_bound();  // Analytic lower bound on mt2w from the endpoint of m(b1 l) and from m_W + m_b
+      double get_precision() { return precision; }  // Precision of the result, get_mt2w() >= get_lower_bound() - get_precision()
+      void   set_scan_relative_step(double step);  // Opt-in: the scan goes up in steps of max(scan_step, step*mtop), 0 (default) for fixed steps
       void   print();
       
    protected:
@@ -58,11 +63,13 @@ class mt2w
 	  double upper_bound;
 	  double error_value;
 	  double scan_step;
+	  double scan_relative_step;
       double mt2w_b;
 
-      int    teco(double mtop);   // test the compatibility of a given trial top mass mtop
-      inline int    signchange_n( long double t1, long double t2, long double t3, long double t4, long double t5);
-      inline int    signchange_p( long double t1, long double t2, long double t3, long double t4, long double t5);
+      int    teco(double mtop, double *margin = 0);   // test the compatibility of a given trial top mass mtop
+      // margin, if given: quarticFactorDiscriminant of the ellipse intersection quartic, > 0 where compatible
+      // and < 0 where not near the boundary, 0 if not available
+      bool   separated();   // sufficient and cheap test for the incompatibility in teco
 
       //data members
       double plx, ply, plz, ml, El;      // l is the visible lepton
@@ -78,9 +85,12 @@ class mt2w
 
       //auxiliary coefficients
       double a1, b1, c1, a2, b2, c2, d1, e1, f1, d2, e2, f2;
+	  double ETb2sq, aa, bb;   // do not depend on mtop, with a1, b1, c1, a2, b2, c2 and A4
+	  long double A4;
 	  double d2o, e2o, f2o;
 
       double precision;
+      double user_precision;
 };
 
 }//end namespace mt2w_bisect
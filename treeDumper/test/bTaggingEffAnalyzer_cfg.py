@@ -113,11 +113,33 @@ process.skimmedPatMuons = cms.EDFilter(
     cut = cms.string("pt > 10.0 && abs(eta) < 2.4 && isLooseMuon")
     )
 
+### All the working points of AK4 jets and AK8 soft drop subjets in one pass:
+### histograms in bTaggingEffAnalyzerAK4PF/<Name>_<WorkingPoint>/ with the usual h2_bTaggingEff_* names
 process.bTaggingEffAnalyzerAK4PF = cms.EDAnalyzer('bTaggingEffAnalyzer',
     JetsTag            = cms.InputTag('slimmedJets'),
     MuonsTag           = cms.InputTag("slimmedMuons"),
-    DiscriminatorTag   = cms.string('pfCombinedInclusiveSecondaryVertexV2BJetTags'),
-    DiscriminatorValue = cms.double(0.8484),
+    JetCollections     = cms.VPSet(
+        cms.PSet(
+            Name             = cms.string('AK4CHS'),
+            JetsTag          = cms.InputTag('slimmedJets'),
+            DiscriminatorTag = cms.string('pfCombinedInclusiveSecondaryVertexV2BJetTags'),
+            WorkingPoints    = cms.VPSet(
+                cms.PSet( Name = cms.string('CSVL'), DiscriminatorValue = cms.double(0.5426) ),
+                cms.PSet( Name = cms.string('CSVM'), DiscriminatorValue = cms.double(0.8484) ),
+                cms.PSet( Name = cms.string('CSVT'), DiscriminatorValue = cms.double(0.9535) ),
+                )
+            ),
+        cms.PSet(
+            Name             = cms.string('AK8Subj'),
+            JetsTag          = cms.InputTag('slimmedJetsAK8PFCHSSoftDropPacked:SubJets'),
+            DiscriminatorTag = cms.string('pfCombinedInclusiveSecondaryVertexV2BJetTags'),
+            WorkingPoints    = cms.VPSet(
+                cms.PSet( Name = cms.string('CSVL'), DiscriminatorValue = cms.double(0.5426) ),
+                cms.PSet( Name = cms.string('CSVM'), DiscriminatorValue = cms.double(0.8484) ),
+                cms.PSet( Name = cms.string('CSVT'), DiscriminatorValue = cms.double(0.9535) ),
+                )
+            ),
+        ),
     PtNBins            = cms.int32(100),
     PtMin              = cms.double(0.),
     PtMax              = cms.double(1000.),
@@ -126,8 +148,10 @@ process.bTaggingEffAnalyzerAK4PF = cms.EDAnalyzer('bTaggingEffAnalyzer',
     EtaMax             = cms.double(2.4)
 )
 
+### Single working point, histograms directly in bTaggingEffAnalyzerAK4PF/
 #process.bTaggingEffAnalyzerAK4PF = cms.EDAnalyzer('bTaggingEffAnalyzer',
-#    JetsTag            = cms.InputTag('slimmedJetsAK8PFCHSSoftDropPacked:SubJets'),
+#    JetsTag            = cms.InputTag('slimmedJets'),
+#    MuonsTag           = cms.InputTag("slimmedMuons"),
 #    DiscriminatorTag   = cms.string('pfCombinedInclusiveSecondaryVertexV2BJetTags'),
 #    DiscriminatorValue = cms.double(0.8484),
 #    PtNBins            = cms.int32(100),